@@ -0,0 +1,322 @@
+#include "AssetLoader.h"
+
+#include <chrono>
+
+#include "AssetPack.h"
+#include "ModelImporter.h"
+#include "TextureCooker.h"
+
+UploadQueue::UploadQueue()
+{
+	stub.next.store(NULL);
+	head.store(&stub);
+	tail = &stub;
+}
+
+void UploadQueue::Push(UploadNode* node)
+{
+	node->next.store(NULL, std::memory_order_relaxed);
+	UploadNode* previous = head.exchange(node, std::memory_order_acq_rel);
+	previous->next.store(node, std::memory_order_release);
+}
+
+UploadNode* UploadQueue::Pop()
+{
+	UploadNode* first = tail;
+	UploadNode* next = first->next.load(std::memory_order_acquire);
+
+	if (first == &stub)
+	{
+		if (next == NULL)
+		{
+			return NULL;
+		}
+		tail = next;
+		first = next;
+		next = next->next.load(std::memory_order_acquire);
+	}
+
+	if (next != NULL)
+	{
+		tail = next;
+		return first;
+	}
+
+	// A producer has swapped head but not linked its node yet, try again later
+	if (first != head.load(std::memory_order_acquire))
+	{
+		return NULL;
+	}
+
+	// first is the last real node, put the stub behind it so it can be handed out
+	Push(&stub);
+	next = first->next.load(std::memory_order_acquire);
+	if (next != NULL)
+	{
+		tail = next;
+		return first;
+	}
+
+	return NULL;
+}
+
+AssetLoader::AssetLoader(unsigned int workerCount)
+{
+	shuttingDown = false;
+	pendingCount.store(0);
+
+	if (workerCount == 0)
+	{
+		workerCount = 1;
+	}
+
+	for (unsigned int i = 0; i < workerCount; i++)
+	{
+		workers.push_back(std::thread(&AssetLoader::WorkerMain, this));
+	}
+}
+
+void AssetLoader::QueueModel(const std::string& filePath, std::vector<Mesh*>* meshList)
+{
+	AssetJob job;
+	job.filePath = filePath;
+	job.meshTarget = meshList;
+	job.textureTarget = NULL;
+	job.arrayTarget = NULL;
+	PushJob(job);
+}
+
+void AssetLoader::QueueTexture(Texture* texture)
+{
+	AssetJob job;
+	job.filePath = texture->GetFileLocation();
+	job.meshTarget = NULL;
+	job.textureTarget = texture;
+	job.arrayTarget = NULL;
+	PushJob(job);
+}
+
+void AssetLoader::QueueTextureArray(TextureArray* textureArray)
+{
+	AssetJob job;
+	job.filePath = textureArray->GetCookedLocation();
+	job.meshTarget = NULL;
+	job.textureTarget = NULL;
+	job.arrayTarget = textureArray;
+	PushJob(job);
+}
+
+void AssetLoader::PushJob(const AssetJob& job)
+{
+	pendingCount++;
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobs.push_back(job);
+	}
+	jobSignal.notify_one();
+}
+
+void AssetLoader::WorkerMain()
+{
+	ModelImporter importer;
+
+	while (true)
+	{
+		AssetJob job;
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobSignal.wait(lock, [this] { return shuttingDown || !jobs.empty(); });
+			if (jobs.empty())
+			{
+				return;
+			}
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		// Failures still produce an upload so the GL thread can count the asset as done
+		AssetUpload* upload = new AssetUpload();
+		upload->filePath = job.filePath;
+		upload->meshTarget = job.meshTarget;
+		upload->cache = NULL;
+		upload->textureTarget = job.textureTarget;
+		upload->ktx = NULL;
+		upload->pixels = NULL;
+		upload->width = 0;
+		upload->height = 0;
+		upload->bitDepth = 0;
+		upload->arrayTarget = job.arrayTarget;
+
+		if (job.arrayTarget != NULL)
+		{
+			KTXFile* ktx = new KTXFile();
+			if (job.arrayTarget->OpenCookedTextureArray(*ktx))
+			{
+				upload->ktx = ktx;
+			}
+			else
+			{
+				delete ktx;
+				bool hasAlpha = false;
+				if (!TextureCooker::LoadLayers(job.arrayTarget->GetFileLocations(), upload->layers, upload->width, upload->height, hasAlpha))
+				{
+					upload->layers.clear();
+				}
+			}
+		}
+		else if (job.meshTarget != NULL)
+		{
+			uint64_t sourceHash = ModelImporter::HashSource(job.filePath);
+			MeshCache* cache = new MeshCache();
+			if (cache->Open(MeshCache::GetCacheLocation(job.filePath), sourceHash))
+			{
+				upload->cache = cache;
+			}
+			else
+			{
+				delete cache;
+				importer.Cook(job.filePath, sourceHash, upload->meshDataList);
+			}
+		}
+		else
+		{
+			KTXFile* ktx = new KTXFile();
+			if (Texture::OpenCookedTexture(job.filePath, *ktx))
+			{
+				upload->ktx = ktx;
+				uploads.Push(upload);
+				continue;
+			}
+			delete ktx;
+
+			upload->pixels = AssetPack::DecodeImage(job.filePath, &upload->width, &upload->height, &upload->bitDepth, 0);
+			if (!upload->pixels)
+			{
+				printf("Failed to find: %s\n", job.filePath.c_str());
+			}
+		}
+
+		uploads.Push(upload);
+	}
+}
+
+void AssetLoader::Upload(AssetUpload* upload)
+{
+	if (upload->meshTarget != NULL)
+	{
+		if (upload->cache != NULL)
+		{
+			MeshCache* cache = upload->cache;
+			for (size_t i = 0; i < cache->GetMeshCount(); i++)
+			{
+				Mesh* newMesh = new Mesh();
+				newMesh->CreateMesh(cache->GetVertices(i), cache->GetIndices(i), cache->GetVertexFloatCount(i), cache->GetIndexCount(i), cache->GetVertexFormat(i));
+
+				MeshLod lods[MeshLod::MAX_LODS];
+				for (unsigned int j = 0; j < cache->GetLodCount(i); j++)
+				{
+					lods[j] = cache->GetLod(i, j);
+				}
+				newMesh->SetLods(lods, cache->GetLodCount(i));
+				upload->meshTarget->push_back(newMesh);
+			}
+			delete cache;
+		}
+
+		for (size_t i = 0; i < upload->meshDataList.size(); i++)
+		{
+			MeshData& meshData = upload->meshDataList[i];
+			Mesh* newMesh = new Mesh();
+			newMesh->CreateMesh(&meshData.vertices[0], &meshData.indices[0], meshData.vertices.size(), meshData.indices.size(), meshData.format);
+			if (!meshData.lods.empty())
+			{
+				newMesh->SetLods(&meshData.lods[0], (unsigned int)meshData.lods.size());
+			}
+			upload->meshTarget->push_back(newMesh);
+		}
+	}
+
+	if (upload->arrayTarget != NULL)
+	{
+		if (upload->ktx != NULL)
+		{
+			upload->arrayTarget->LoadCompressedTextureArray(*upload->ktx);
+			delete upload->ktx;
+		}
+		else if (!upload->layers.empty())
+		{
+			upload->arrayTarget->LoadTextureArrayFromData(upload->layers, upload->width, upload->height);
+		}
+	}
+
+	if (upload->textureTarget != NULL && upload->ktx != NULL)
+	{
+		upload->textureTarget->LoadCompressedTexture(*upload->ktx);
+		delete upload->ktx;
+	}
+
+	// The streamer owns the pixels from here and frees them once the last row is uploaded
+	if (upload->textureTarget != NULL && upload->pixels != NULL)
+	{
+		textureStreamer.Queue(upload->textureTarget, upload->pixels, upload->width, upload->height, upload->bitDepth);
+	}
+
+	delete upload;
+	pendingCount--;
+}
+
+unsigned int AssetLoader::PumpUploads()
+{
+	unsigned int uploaded = 0;
+
+	UploadNode* node = uploads.Pop();
+	while (node != NULL)
+	{
+		Upload(static_cast<AssetUpload*>(node));
+		uploaded++;
+		node = uploads.Pop();
+	}
+
+	uploaded += textureStreamer.Update();
+	return uploaded;
+}
+
+void AssetLoader::Finish()
+{
+	while (pendingCount.load() > 0 || textureStreamer.IsBusy())
+	{
+		if (PumpUploads() == 0)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(jobMutex);
+		shuttingDown = true;
+	}
+	jobSignal.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+
+	// Drop anything that was decoded but never uploaded
+	UploadNode* node = uploads.Pop();
+	while (node != NULL)
+	{
+		AssetUpload* upload = static_cast<AssetUpload*>(node);
+		delete upload->cache;
+		delete upload->ktx;
+		if (upload->pixels != NULL)
+		{
+			stbi_image_free(upload->pixels);
+		}
+		delete upload;
+		node = uploads.Pop();
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshData.h"
+#include "Texture.h"
+#include "TextureArray.h"
+#include "TextureStreamer.h"
+
+struct UploadNode
+{
+	std::atomic<UploadNode*> next;
+};
+
+// Decoded asset waiting for the GL thread
+struct AssetUpload : public UploadNode
+{
+	std::string filePath;
+
+	std::vector<Mesh*>* meshTarget;
+	MeshCache* cache;                 // Mapped .tmesh, uploaded without a copy
+	std::vector<MeshData> meshDataList; // Freshly imported when there was no valid cache
+
+	Texture* textureTarget;
+	KTXFile* ktx;                     // Cooked, compressed with its mip chain
+	unsigned char* pixels;            // Decoded source image when there is no usable .ktx
+	int width, height, bitDepth;
+
+	TextureArray* arrayTarget;        // Uses ktx when the cooked array is current, otherwise layers
+	std::vector<std::vector<unsigned char> > layers;
+};
+
+// Intrusive multi-producer single-consumer queue (Vyukov). Workers push without taking a lock,
+// the GL thread pops.
+class UploadQueue
+{
+public:
+	UploadQueue();
+
+	void Push(UploadNode* node);
+	UploadNode* Pop();
+
+private:
+	std::atomic<UploadNode*> head;
+	UploadNode* tail;
+	UploadNode stub;
+};
+
+// Decodes models and textures on a pool of worker threads, each with its own Assimp importer.
+// The GL thread calls PumpUploads to turn the decoded data into Mesh and Texture objects,
+// decoded images are streamed in over several calls under TextureStreamer's budget.
+class AssetLoader
+{
+public:
+	AssetLoader(unsigned int workerCount);
+
+	void QueueModel(const std::string& filePath, std::vector<Mesh*>* meshList);
+	void QueueTexture(Texture* texture);
+	// The layers are decoded on a worker, the array is uploaded in one go since every layer is needed for the first draw
+	void QueueTextureArray(TextureArray* textureArray);
+
+	// GL thread only
+	unsigned int PumpUploads();
+	void Finish();
+
+	unsigned int GetPendingCount() { return pendingCount.load(); }
+	bool IsStreaming() { return textureStreamer.IsBusy(); }
+
+	~AssetLoader();
+
+private:
+	struct AssetJob
+	{
+		std::string filePath;
+		std::vector<Mesh*>* meshTarget;
+		Texture* textureTarget;
+		TextureArray* arrayTarget;
+	};
+
+	void PushJob(const AssetJob& job);
+
+	std::vector<std::thread> workers;
+	std::deque<AssetJob> jobs;
+	std::mutex jobMutex;
+	std::condition_variable jobSignal;
+	bool shuttingDown;
+
+	UploadQueue uploads;
+	std::atomic<unsigned int> pendingCount;
+	TextureStreamer textureStreamer;
+
+	void WorkerMain();
+	void Upload(AssetUpload* upload);
+};
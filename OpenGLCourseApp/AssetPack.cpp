@@ -0,0 +1,405 @@
+#include "AssetPack.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+
+#include "stb_image.h"
+
+#include "Lz4.h"
+#include "MeshCache.h"
+
+static const char PACK_MAGIC[4] = { 'T', 'P', 'A', 'K' };
+
+AssetPack* AssetPack::mounted = NULL;
+
+AssetPack::AssetPack()
+{
+	files = NULL;
+	chunks = NULL;
+	names = NULL;
+	fileCount = 0;
+}
+
+uint32_t AssetPack::GetChunkCount(uint64_t fileSize)
+{
+	return (uint32_t)((fileSize + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
+bool AssetPack::Open(const std::string& packLocation)
+{
+	Close();
+
+	// The pack itself must never be looked up in the mounted pack
+	if (!file.OpenOnDisk(packLocation))
+	{
+		return false;
+	}
+
+	const unsigned char* data = file.GetData();
+	size_t size = file.GetSize();
+	if (size < sizeof(Header))
+	{
+		printf("Asset pack %s is truncated\n", packLocation.c_str());
+		Close();
+		return false;
+	}
+
+	const Header* header = (const Header*)data;
+	if (memcmp(header->magic, PACK_MAGIC, 4) != 0 || header->version != VERSION || header->chunkSize != CHUNK_SIZE)
+	{
+		printf("Asset pack %s has an unsupported format\n", packLocation.c_str());
+		Close();
+		return false;
+	}
+
+	uint64_t tablesEnd = sizeof(Header) + (uint64_t)sizeof(FileEntry) * header->fileCount
+		+ (uint64_t)sizeof(Chunk) * header->chunkCount + header->nameBytes;
+	if (tablesEnd > size)
+	{
+		printf("Asset pack %s is truncated\n", packLocation.c_str());
+		Close();
+		return false;
+	}
+
+	files = (const FileEntry*)(data + sizeof(Header));
+	chunks = (const Chunk*)(files + header->fileCount);
+	names = (const char*)(chunks + header->chunkCount);
+	fileCount = header->fileCount;
+
+	// Check every table entry once here, so lookups and reads can trust them
+	for (size_t i = 0; i < fileCount; i++)
+	{
+		const FileEntry& entry = files[i];
+		uint32_t entryChunks = GetChunkCount(entry.size);
+		bool valid = (uint64_t)entry.nameOffset + entry.nameLength <= header->nameBytes
+			&& (uint64_t)entry.firstChunk + entryChunks <= header->chunkCount;
+
+		for (uint32_t j = 0; valid && j < entryChunks; j++)
+		{
+			const Chunk& chunk = chunks[entry.firstChunk + j];
+			uint64_t expectedSize = std::min((uint64_t)CHUNK_SIZE, entry.size - (uint64_t)j * CHUNK_SIZE);
+			valid = chunk.size == expectedSize && chunk.offset <= size && chunk.packedSize <= size - chunk.offset;
+			if (valid && entry.stored)
+			{
+				valid = chunk.packedSize == chunk.size && chunk.offset == chunks[entry.firstChunk].offset + (uint64_t)j * CHUNK_SIZE;
+			}
+		}
+
+		if (!valid)
+		{
+			printf("Asset pack %s has a damaged table\n", packLocation.c_str());
+			Close();
+			return false;
+		}
+	}
+
+	file.Prefetch();
+	return true;
+}
+
+void AssetPack::Close()
+{
+	file.Close();
+	files = NULL;
+	chunks = NULL;
+	names = NULL;
+	fileCount = 0;
+}
+
+const AssetPack::FileEntry* AssetPack::Find(const std::string& fileLocation)
+{
+	std::string name = NormalizeName(fileLocation);
+
+	size_t first = 0;
+	size_t last = fileCount;
+	while (first < last)
+	{
+		size_t middle = (first + last) / 2;
+		int order = name.compare(0, std::string::npos, names + files[middle].nameOffset, files[middle].nameLength);
+		if (order == 0)
+		{
+			return &files[middle];
+		}
+		if (order < 0)
+		{
+			last = middle;
+		}
+		else
+		{
+			first = middle + 1;
+		}
+	}
+
+	return NULL;
+}
+
+bool AssetPack::Contains(const std::string& fileLocation)
+{
+	return Find(fileLocation) != NULL;
+}
+
+uint64_t AssetPack::GetFileHash(const std::string& fileLocation)
+{
+	const FileEntry* entry = Find(fileLocation);
+	return entry != NULL ? entry->hash : 0;
+}
+
+bool AssetPack::GetStoredData(const std::string& fileLocation, const unsigned char*& data, size_t& size)
+{
+	const FileEntry* entry = Find(fileLocation);
+	if (entry == NULL || !entry->stored)
+	{
+		return false;
+	}
+
+	size = (size_t)entry->size;
+	data = size > 0 ? file.GetData() + chunks[entry->firstChunk].offset : file.GetData();
+	return true;
+}
+
+bool AssetPack::Read(const std::string& fileLocation, std::vector<unsigned char>& data)
+{
+	const FileEntry* entry = Find(fileLocation);
+	if (entry == NULL)
+	{
+		return false;
+	}
+
+	data.resize((size_t)entry->size);
+	uint32_t entryChunks = GetChunkCount(entry->size);
+	for (uint32_t i = 0; i < entryChunks; i++)
+	{
+		const Chunk& chunk = chunks[entry->firstChunk + i];
+		const unsigned char* packed = file.GetData() + chunk.offset;
+		unsigned char* output = &data[(size_t)i * CHUNK_SIZE];
+
+		if (chunk.packedSize == chunk.size)
+		{
+			memcpy(output, packed, chunk.size);
+		}
+		else if (!Lz4::Decompress(packed, chunk.packedSize, output, chunk.size))
+		{
+			printf("Asset pack chunk %u of %s is damaged\n", i, fileLocation.c_str());
+			data.clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool AssetPack::Write(const std::string& packLocation, const std::vector<Source>& sources)
+{
+	std::vector<Source> sorted = sources;
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		sorted[i].fileLocation = NormalizeName(sorted[i].fileLocation);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const Source& a, const Source& b) { return a.fileLocation < b.fileLocation; });
+
+	Header header;
+	memcpy(header.magic, PACK_MAGIC, 4);
+	header.version = VERSION;
+	header.fileCount = 0;
+	header.chunkCount = 0;
+	header.chunkSize = CHUNK_SIZE;
+	header.nameBytes = 0;
+
+	// Files are read one at a time into the data block, the tables come first in the pack
+	// but can only be finished once every file has been compressed
+	std::vector<FileEntry> table;
+	std::vector<Chunk> chunkTable;
+	std::string nameBlock;
+	std::vector<unsigned char> dataBlock;
+	std::vector<unsigned char> contents;
+	std::vector<unsigned char> packed(Lz4::GetMaxCompressedSize(CHUNK_SIZE));
+	uint64_t storedBytes = 0;
+
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		const std::string& name = sorted[i].fileLocation;
+		if (i > 0 && name == sorted[i - 1].fileLocation)
+		{
+			continue;
+		}
+
+		std::ifstream sourceStream(name.c_str(), std::ios::in | std::ios::binary);
+		if (!sourceStream.is_open())
+		{
+			printf("Failed to pack %s! File doesn't exist.\n", name.c_str());
+			return false;
+		}
+		sourceStream.seekg(0, std::ios::end);
+		contents.resize((size_t)sourceStream.tellg());
+		sourceStream.seekg(0, std::ios::beg);
+		if (!contents.empty())
+		{
+			sourceStream.read((char*)&contents[0], contents.size());
+		}
+
+		FileEntry entry;
+		entry.hash = MeshCache::HashData(contents.empty() ? NULL : &contents[0], contents.size());
+		entry.size = contents.size();
+		entry.nameOffset = (uint32_t)nameBlock.size();
+		entry.nameLength = (uint32_t)name.size();
+		entry.firstChunk = (uint32_t)chunkTable.size();
+		entry.stored = 1;
+		nameBlock += name;
+
+		dataBlock.resize((dataBlock.size() + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT);
+
+		for (size_t offset = 0; offset < contents.size(); offset += CHUNK_SIZE)
+		{
+			Chunk chunk;
+			chunk.offset = dataBlock.size();
+			chunk.size = (uint32_t)std::min((size_t)CHUNK_SIZE, contents.size() - offset);
+			chunk.packedSize = chunk.size;
+
+			const unsigned char* chunkData = &contents[offset];
+			if (sorted[i].compress)
+			{
+				// A chunk has to shrink by an eighth to be worth decompressing
+				size_t packedSize = Lz4::Compress(chunkData, chunk.size, &packed[0], packed.size());
+				if (packedSize > 0 && packedSize < chunk.size - chunk.size / 8)
+				{
+					chunk.packedSize = (uint32_t)packedSize;
+					chunkData = &packed[0];
+					entry.stored = 0;
+				}
+			}
+
+			dataBlock.insert(dataBlock.end(), chunkData, chunkData + chunk.packedSize);
+			chunkTable.push_back(chunk);
+		}
+
+		storedBytes += contents.size();
+		table.push_back(entry);
+	}
+
+	header.fileCount = (uint32_t)table.size();
+	header.chunkCount = (uint32_t)chunkTable.size();
+	header.nameBytes = (uint32_t)nameBlock.size();
+
+	// Chunk offsets so far are relative to the data block, which starts after the tables
+	uint64_t tablesSize = sizeof(Header) + sizeof(FileEntry) * table.size() + sizeof(Chunk) * chunkTable.size() + nameBlock.size();
+	uint64_t dataStart = (tablesSize + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+	for (size_t i = 0; i < chunkTable.size(); i++)
+	{
+		chunkTable[i].offset += dataStart;
+	}
+
+	std::ofstream fileStream(packLocation.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fileStream.is_open())
+	{
+		printf("Failed to write asset pack %s\n", packLocation.c_str());
+		return false;
+	}
+
+	fileStream.write((const char*)&header, sizeof(header));
+	if (!table.empty())
+	{
+		fileStream.write((const char*)&table[0], sizeof(FileEntry) * table.size());
+	}
+	if (!chunkTable.empty())
+	{
+		fileStream.write((const char*)&chunkTable[0], sizeof(Chunk) * chunkTable.size());
+	}
+	fileStream.write(nameBlock.data(), nameBlock.size());
+
+	char padding[DATA_ALIGNMENT] = {};
+	fileStream.write(padding, (std::streamsize)(dataStart - tablesSize));
+	if (!dataBlock.empty())
+	{
+		fileStream.write((const char*)&dataBlock[0], dataBlock.size());
+	}
+
+	printf("Packed %u files, %llu bytes into %llu\n", header.fileCount, (unsigned long long)storedBytes,
+		(unsigned long long)(dataStart + dataBlock.size()));
+	return fileStream.good();
+}
+
+std::string AssetPack::NormalizeName(const std::string& fileLocation)
+{
+	std::vector<std::string> parts;
+	size_t start = 0;
+	while (start <= fileLocation.size())
+	{
+		size_t end = fileLocation.find_first_of("/\\", start);
+		if (end == std::string::npos)
+		{
+			end = fileLocation.size();
+		}
+
+		std::string part = fileLocation.substr(start, end - start);
+		if (part == ".." && !parts.empty() && parts.back() != "..")
+		{
+			parts.pop_back();
+		}
+		else if (!part.empty() && part != ".")
+		{
+			parts.push_back(part);
+		}
+		start = end + 1;
+	}
+
+	std::string name;
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		if (i > 0)
+		{
+			name += '/';
+		}
+		name += parts[i];
+	}
+	return name;
+}
+
+bool AssetPack::Mount(const std::string& packLocation)
+{
+	Unmount();
+
+	AssetPack* pack = new AssetPack();
+	if (!pack->Open(packLocation))
+	{
+		delete pack;
+		return false;
+	}
+
+	mounted = pack;
+	return true;
+}
+
+void AssetPack::Unmount()
+{
+	delete mounted;
+	mounted = NULL;
+}
+
+unsigned char* AssetPack::DecodeImage(const std::string& fileLocation, int* width, int* height, int* bitDepth, int desiredChannels)
+{
+	if (mounted != NULL)
+	{
+		// Images are stored, so this normally decodes straight out of the pack's mapping
+		const unsigned char* data;
+		size_t size;
+		if (mounted->GetStoredData(fileLocation, data, size))
+		{
+			return stbi_load_from_memory(data, (int)size, width, height, bitDepth, desiredChannels);
+		}
+
+		std::vector<unsigned char> contents;
+		if (mounted->Read(fileLocation, contents) && !contents.empty())
+		{
+			return stbi_load_from_memory(&contents[0], (int)contents.size(), width, height, bitDepth, desiredChannels);
+		}
+	}
+
+	return stbi_load(fileLocation.c_str(), width, height, bitDepth, desiredChannels);
+}
+
+AssetPack::~AssetPack()
+{
+	Close();
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "MappedFile.h"
+
+// Every asset in one file: a name sorted table of files, a table of chunks and the chunk data.
+// Files are cut into CHUNK_SIZE chunks, each LZ4 compressed or stored as it is when compressing
+// doesn't pay. The pack is mapped once and read in front to back, so startup is one sequential read.
+// Once a pack is mounted MappedFile, MappedIOSystem, Shader::ReadFile, DecodeImage and
+// PackFileFactory look in it before the disk, the pack wins when a file is in both.
+class AssetPack
+{
+public:
+	static const uint32_t VERSION = 1;
+	static const uint32_t CHUNK_SIZE = 64 * 1024;
+	// Every file starts on this boundary so stored ones can be used in place
+	static const uint32_t DATA_ALIGNMENT = 16;
+
+	struct Source
+	{
+		std::string fileLocation;
+		// Already compressed formats and files that are mapped in place (.tmesh, .ktx) should be stored
+		bool compress;
+	};
+
+	AssetPack();
+
+	bool Open(const std::string& packLocation);
+	void Close();
+
+	size_t GetFileCount() { return fileCount; }
+	size_t GetPackSize() { return file.GetSize(); }
+	bool Contains(const std::string& fileLocation);
+	// Same hash as MeshCache::HashFile, 0 when the file isn't in the pack
+	uint64_t GetFileHash(const std::string& fileLocation);
+	// Only for files stored uncompressed, data points into the pack's mapping
+	bool GetStoredData(const std::string& fileLocation, const unsigned char*& data, size_t& size);
+	// Copies stored files and decompresses the others
+	bool Read(const std::string& fileLocation, std::vector<unsigned char>& data);
+
+	static bool Write(const std::string& packLocation, const std::vector<Source>& sources);
+	// Names are stored with '/' separators and without "." or ".." parts
+	static std::string NormalizeName(const std::string& fileLocation);
+
+	// The process wide pack. Mount before any loader thread starts, unmount after they have all stopped
+	static bool Mount(const std::string& packLocation);
+	static void Unmount();
+	static AssetPack* GetMounted() { return mounted; }
+
+	// stbi_load that reads from the mounted pack when the image is in it
+	static unsigned char* DecodeImage(const std::string& fileLocation, int* width, int* height, int* bitDepth, int desiredChannels);
+
+	~AssetPack();
+
+private:
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t fileCount;
+		uint32_t chunkCount;
+		uint32_t chunkSize;
+		uint32_t nameBytes;
+	};
+
+	struct FileEntry
+	{
+		uint64_t hash;
+		uint64_t size;
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		uint32_t firstChunk;
+		// Every chunk is stored, so the file is contiguous in the pack
+		uint32_t stored;
+	};
+
+	// packedSize equal to size means the chunk is stored
+	struct Chunk
+	{
+		uint64_t offset;
+		uint32_t packedSize;
+		uint32_t size;
+	};
+
+	MappedFile file;
+	const FileEntry* files;
+	const Chunk* chunks;
+	const char* names;
+	size_t fileCount;
+
+	static AssetPack* mounted;
+
+	const FileEntry* Find(const std::string& fileLocation);
+
+	static uint32_t GetChunkCount(uint64_t fileSize);
+};
@@ -0,0 +1,153 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdio.h>
+
+#include <GL\glew.h>
+
+const float Benchmark::TIMESTEP = 1.0f / 60.0f;
+
+static const char* SCENE_NAMES[Benchmark::SCENE_COUNT] = { "turn", "straight", "up" };
+
+Benchmark::Benchmark()
+{
+	running = false;
+	scene = 0;
+	frame = 0;
+	framesPerScene = 0;
+}
+
+void Benchmark::Start(unsigned int framesPerScene, const std::string& outputLocation)
+{
+	this->framesPerScene = framesPerScene > 0 ? framesPerScene : 1;
+	this->outputLocation = outputLocation;
+
+	for (int i = 0; i < SCENE_COUNT; i++)
+	{
+		results[i].frameMilliseconds.clear();
+		results[i].passes.clear();
+	}
+
+	running = true;
+	scene = 0;
+	frame = 0;
+}
+
+void Benchmark::BeginFrame()
+{
+	frameStart = std::chrono::steady_clock::now();
+}
+
+void Benchmark::EndFrame(Profiler& profiler)
+{
+	if (!running)
+	{
+		return;
+	}
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+
+	// The first frames of a scene compile shaders and touch fresh buffers, keep them out of the numbers
+	frame++;
+	if (frame == WARMUP_FRAMES)
+	{
+		profiler.ResetTotals();
+	}
+	else if (frame > WARMUP_FRAMES)
+	{
+		results[scene].frameMilliseconds.push_back(milliseconds);
+	}
+
+	if (frame < WARMUP_FRAMES + framesPerScene)
+	{
+		return;
+	}
+
+	SceneResult& result = results[scene];
+	for (unsigned int i = 0; i < profiler.GetZoneCount(); i++)
+	{
+		PassResult pass;
+		pass.name = profiler.GetZoneName(i);
+		pass.cpuMilliseconds = profiler.GetMeanCpuMilliseconds(i);
+		pass.gpuMilliseconds = profiler.GetMeanGpuMilliseconds(i);
+		result.passes.push_back(pass);
+	}
+
+	printf("Benchmark scene %s done\n", SCENE_NAMES[scene]);
+
+	frame = 0;
+	scene++;
+	if (scene == SCENE_COUNT)
+	{
+		WriteResults();
+		running = false;
+	}
+}
+
+double Benchmark::GetPercentile(const std::vector<double>& sorted, double percentile)
+{
+	if (sorted.empty())
+	{
+		return 0.0;
+	}
+
+	// Nearest rank
+	size_t rank = (size_t)(percentile / 100.0 * sorted.size() + 0.5);
+	rank = rank > 0 ? rank - 1 : 0;
+	return sorted[rank < sorted.size() ? rank : sorted.size() - 1];
+}
+
+void Benchmark::WriteResults()
+{
+	std::ofstream fileStream(outputLocation.c_str(), std::ios::out | std::ios::trunc);
+	if (!fileStream.is_open())
+	{
+		printf("Failed to write benchmark results %s!\n", outputLocation.c_str());
+		return;
+	}
+
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	char line[512];
+
+	fileStream << "{\n";
+	snprintf(line, sizeof(line), "  \"renderer\": \"%s\",\n  \"timestep\": %.6f,\n  \"framesPerScene\": %u,\n  \"scenes\": [\n",
+		renderer ? renderer : "unknown", TIMESTEP, framesPerScene);
+	fileStream << line;
+
+	for (int i = 0; i < SCENE_COUNT; i++)
+	{
+		std::vector<double> sorted = results[i].frameMilliseconds;
+		std::sort(sorted.begin(), sorted.end());
+
+		double mean = 0.0;
+		for (size_t j = 0; j < sorted.size(); j++)
+		{
+			mean += sorted[j];
+		}
+		mean = sorted.empty() ? 0.0 : mean / sorted.size();
+
+		snprintf(line, sizeof(line), "    {\n      \"name\": \"%s\",\n      \"frames\": %u,\n"
+			"      \"frameMs\": { \"min\": %.4f, \"median\": %.4f, \"p99\": %.4f, \"mean\": %.4f },\n      \"passes\": {",
+			SCENE_NAMES[i], (unsigned int)sorted.size(), sorted.empty() ? 0.0 : sorted.front(),
+			GetPercentile(sorted, 50.0), GetPercentile(sorted, 99.0), mean);
+		fileStream << line;
+
+		const std::vector<PassResult>& passes = results[i].passes;
+		for (size_t j = 0; j < passes.size(); j++)
+		{
+			snprintf(line, sizeof(line), "%s\n        \"%s\": { \"cpuMs\": %.4f, \"gpuMs\": %.4f }",
+				j > 0 ? "," : "", passes[j].name.c_str(), passes[j].cpuMilliseconds, passes[j].gpuMilliseconds);
+			fileStream << line;
+		}
+
+		fileStream << (passes.empty() ? "}\n    }" : "\n      }\n    }") << (i + 1 < SCENE_COUNT ? ",\n" : "\n");
+	}
+
+	fileStream << "  ]\n}\n";
+	printf("Wrote benchmark results to %s\n", outputLocation.c_str());
+}
+
+Benchmark::~Benchmark()
+{
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Profiler.h"
+
+// Plays every animation scene for a fixed number of frames at a fixed timestep and writes the
+// frame time distribution and per-pass means of each scene as JSON.
+class Benchmark
+{
+public:
+	static const int SCENE_COUNT = 3;
+	static const unsigned int WARMUP_FRAMES = 10;
+	static const float TIMESTEP;
+
+	Benchmark();
+
+	void Start(unsigned int framesPerScene, const std::string& outputLocation);
+	bool IsRunning() { return running; }
+
+	// True on the first frame of a scene, the caller resets the animation to GetScene() then
+	bool IsSceneStart() { return running && frame == 0; }
+	int GetScene() { return scene; }
+
+	void BeginFrame();
+	void EndFrame(Profiler& profiler);
+
+	~Benchmark();
+
+private:
+	struct PassResult
+	{
+		std::string name;
+		double cpuMilliseconds, gpuMilliseconds;
+	};
+
+	struct SceneResult
+	{
+		std::vector<double> frameMilliseconds;
+		std::vector<PassResult> passes;
+	};
+
+	bool running;
+	int scene;
+	unsigned int frame;
+	unsigned int framesPerScene;
+	std::string outputLocation;
+
+	std::chrono::steady_clock::time_point frameStart;
+	SceneResult results[SCENE_COUNT];
+
+	void WriteResults();
+
+	static double GetPercentile(const std::vector<double>& sorted, double percentile);
+};
@@ -21,6 +21,7 @@ public:
 	void Rotate(float newYaw,float newPitch);
 	void Move(float x,float y,float z);
 	glm::mat4 calculateViewMatrix();
+	glm::vec3 getCameraPosition() { return position; }
 
 	~Camera();
 
@@ -0,0 +1,206 @@
+#include "FrameGraph.h"
+
+#include <stdio.h>
+
+FrameGraph::FrameGraph()
+{
+	compiled = false;
+	culledPassCount = 0;
+	skippedClearCount = 0;
+}
+
+int FrameGraph::AddTarget(const char* name, GLuint fbo, GLsizei width, GLsizei height)
+{
+	Target target;
+	target.name = name;
+	target.fbo = fbo;
+	target.width = width;
+	target.height = height;
+	target.output = false;
+	targets.push_back(target);
+	compiled = false;
+	return (int)targets.size() - 1;
+}
+
+void FrameGraph::SetOutput(int target)
+{
+	targets[target].output = true;
+	compiled = false;
+}
+
+void FrameGraph::AddPass(const PassDesc& desc, const std::function<void()>& execute)
+{
+	Pass pass;
+	pass.desc = desc;
+	pass.execute = execute;
+	pass.culled = false;
+	pass.clearMask = 0;
+	passes.push_back(pass);
+	compiled = false;
+}
+
+void FrameGraph::AddPass(const char* name, int target, LoadOp load, const std::function<void()>& execute)
+{
+	PassDesc desc;
+	desc.name = name;
+	desc.target = target;
+	desc.colourLoad = load;
+	desc.depthLoad = load;
+	desc.clearColour = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	desc.writesColour = true;
+	desc.writesDepth = true;
+	AddPass(desc, execute);
+}
+
+void FrameGraph::Compile()
+{
+	culledPassCount = 0;
+	skippedClearCount = 0;
+	report.clear();
+
+	// Walk back from the outputs. A pass is live if something later needs what it writes. What a live
+	// pass writes is needed from the passes before it only if it loads it, blending and depth testing read it
+	std::vector<bool> colourNeeded(targets.size()), depthNeeded(targets.size(), false);
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		colourNeeded[i] = targets[i].output;
+	}
+
+	for (size_t i = passes.size(); i-- > 0;)
+	{
+		Pass& pass = passes[i];
+		const PassDesc& desc = pass.desc;
+		// A clear writes the attachment even if the pass draws nothing into it
+		bool colourWritten = desc.writesColour || desc.colourLoad == CLEAR;
+		bool depthWritten = desc.writesDepth || desc.depthLoad == CLEAR;
+		pass.culled = !((colourWritten && colourNeeded[desc.target]) || (depthWritten && depthNeeded[desc.target]));
+		if (pass.culled)
+		{
+			culledPassCount++;
+			report += std::string("culled pass ") + desc.name + "\n";
+			continue;
+		}
+
+		if (colourWritten)
+		{
+			colourNeeded[desc.target] = desc.colourLoad == LOAD;
+		}
+		if (depthWritten)
+		{
+			depthNeeded[desc.target] = desc.depthLoad == LOAD;
+		}
+
+		for (size_t j = 0; j < desc.reads.size(); j++)
+		{
+			colourNeeded[desc.reads[j]] = true;
+		}
+	}
+
+	// Walk forward over the live passes, a clear is only needed if the target was drawn into since
+	// its last clear or that clear used another colour
+	std::vector<bool> colourClean(targets.size(), false), depthClean(targets.size(), false);
+	std::vector<glm::vec4> cleanColour(targets.size());
+	for (size_t i = 0; i < passes.size(); i++)
+	{
+		Pass& pass = passes[i];
+		const PassDesc& desc = pass.desc;
+		pass.clearMask = 0;
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		int target = desc.target;
+		if (desc.colourLoad == CLEAR)
+		{
+			if (colourClean[target] && cleanColour[target] == desc.clearColour)
+			{
+				skippedClearCount++;
+				report += std::string("skipped colour clear in ") + desc.name + "\n";
+			}
+			else
+			{
+				pass.clearMask |= GL_COLOR_BUFFER_BIT;
+			}
+		}
+		if (desc.depthLoad == CLEAR)
+		{
+			if (depthClean[target])
+			{
+				skippedClearCount++;
+				report += std::string("skipped depth clear in ") + desc.name + "\n";
+			}
+			else
+			{
+				pass.clearMask |= GL_DEPTH_BUFFER_BIT;
+			}
+		}
+
+		// The pass may have drawn nothing, but nothing says so, assume it dirtied what it writes
+		colourClean[target] = desc.colourLoad == CLEAR && !desc.writesColour;
+		depthClean[target] = desc.depthLoad == CLEAR && !desc.writesDepth;
+		cleanColour[target] = desc.clearColour;
+	}
+
+	if (report != lastReport)
+	{
+		if (!report.empty())
+		{
+			printf("Frame graph:\n%s", report.c_str());
+		}
+		lastReport = report;
+	}
+
+	compiled = true;
+}
+
+void FrameGraph::Execute(Profiler& profiler)
+{
+	if (!compiled)
+	{
+		Compile();
+	}
+
+	int boundTarget = -1;
+	for (size_t i = 0; i < passes.size(); i++)
+	{
+		Pass& pass = passes[i];
+		if (pass.culled)
+		{
+			continue;
+		}
+
+		ProfileZone zone(profiler, pass.desc.name);
+
+		const Target& target = targets[pass.desc.target];
+		if (boundTarget != pass.desc.target)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+			glViewport(0, 0, target.width, target.height);
+			boundTarget = pass.desc.target;
+		}
+
+		if (pass.clearMask != 0)
+		{
+			if (pass.clearMask & GL_COLOR_BUFFER_BIT)
+			{
+				glClearColor(pass.desc.clearColour.r, pass.desc.clearColour.g, pass.desc.clearColour.b, pass.desc.clearColour.a);
+			}
+			glClear(pass.clearMask);
+		}
+
+		pass.execute();
+	}
+}
+
+void FrameGraph::Reset()
+{
+	targets.clear();
+	passes.clear();
+	compiled = false;
+}
+
+FrameGraph::~FrameGraph()
+{
+	Reset();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+
+#include "Profiler.h"
+
+// Orders a frame's render passes from what they declare instead of from hand placed glClear calls.
+// Each pass names the target it draws into and what happens to the target's colour and depth when it
+// starts. Compile drops passes whose output is never read or is thrown away by a later clear, and
+// clears of a target nothing has drawn into since its last clear. Built fresh every frame, it is a
+// handful of passes.
+class FrameGraph
+{
+public:
+	enum LoadOp
+	{
+		// Keep what the previous pass left
+		LOAD,
+		// Clear to the pass's clear value
+		CLEAR,
+		// The pass overwrites everything, the old contents can be dropped without a clear
+		DONT_CARE
+	};
+
+	struct PassDesc
+	{
+		// Also the profiler zone, so it has to outlive the frame, a string literal
+		const char* name;
+		int target;
+		LoadOp colourLoad, depthLoad;
+		glm::vec4 clearColour;
+		bool writesColour, writesDepth;
+		// Other targets the pass samples, keeps the passes that drew them alive
+		std::vector<int> reads;
+	};
+
+	FrameGraph();
+
+	// fbo 0 is the window
+	int AddTarget(const char* name, GLuint fbo, GLsizei width, GLsizei height);
+	// Frame outputs, every pass that doesn't contribute to one is culled
+	void SetOutput(int target);
+	void AddPass(const PassDesc& desc, const std::function<void()>& execute);
+	// Shorthand for a pass drawing colour and depth into target
+	void AddPass(const char* name, int target, LoadOp load, const std::function<void()>& execute);
+
+	void Compile();
+	// Runs the live passes in order, each in its own profiler zone
+	void Execute(Profiler& profiler);
+	void Reset();
+
+	unsigned int GetPassCount() { return (unsigned int)passes.size(); }
+	unsigned int GetCulledPassCount() { return culledPassCount; }
+	unsigned int GetSkippedClearCount() { return skippedClearCount; }
+
+	~FrameGraph();
+
+private:
+	struct Target
+	{
+		const char* name;
+		GLuint fbo;
+		GLsizei width, height;
+		bool output;
+	};
+
+	struct Pass
+	{
+		PassDesc desc;
+		std::function<void()> execute;
+		bool culled;
+		GLbitfield clearMask;
+	};
+
+	std::vector<Target> targets;
+	std::vector<Pass> passes;
+	bool compiled;
+
+	unsigned int culledPassCount;
+	unsigned int skippedClearCount;
+	// What was culled or skipped last time, printed when it changes rather than every frame
+	std::string report, lastReport;
+};
@@ -0,0 +1,112 @@
+#include "FrameUniformBuffer.h"
+
+#include <string.h>
+
+FrameUniformBuffer::FrameUniformBuffer()
+{
+	UBO = 0;
+	slotSize = 0;
+	slot = 0;
+	slotWritten = false;
+
+	for (unsigned int i = 0; i < RING_SIZE; i++)
+	{
+		fences[i] = 0;
+	}
+}
+
+void FrameUniformBuffer::Create()
+{
+	// glBindBufferRange offsets have to be a multiple of the driver's alignment
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment < 1)
+	{
+		alignment = 256;
+	}
+
+	slotSize = ((sizeof(FrameData) + alignment - 1) / alignment) * alignment;
+
+	glGenBuffers(1, &UBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferData(GL_UNIFORM_BUFFER, slotSize * RING_SIZE, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void FrameUniformBuffer::Update(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& cameraPosition, DirectionalLight& light)
+{
+	if (UBO == 0)
+	{
+		return;
+	}
+
+	// Everything drawn from the previous slot has been submitted by now
+	if (slotWritten)
+	{
+		fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	slot = (slot + 1) % RING_SIZE;
+
+	if (fences[slot] != 0)
+	{
+		glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(fences[slot]);
+		fences[slot] = 0;
+	}
+
+	FrameData data;
+	data.projection = projection;
+	data.view = view;
+	data.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+	data.lightColour = glm::vec4(light.getColour() * 1.5f, *light.getAmbientIntensity());
+	data.lightDirection = glm::vec4(light.localDirection, light.getDiffuseIntensity());
+	data.lightSpecular = glm::vec4(light.getSpecularIntensity(), 0.0f, 0.0f, 0.0f);
+
+	GLintptr offset = slotSize * slot;
+
+	// The fence above guarantees the GPU is done with this slot, so the driver doesn't need to sync either
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	void* mapped = glMapBufferRange(GL_UNIFORM_BUFFER, offset, sizeof(FrameData),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (mapped)
+	{
+		memcpy(mapped, &data, sizeof(FrameData));
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+	else
+	{
+		glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(FrameData), &data);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, UBO, offset, sizeof(FrameData));
+	slotWritten = true;
+}
+
+void FrameUniformBuffer::Clear()
+{
+	for (unsigned int i = 0; i < RING_SIZE; i++)
+	{
+		if (fences[i] != 0)
+		{
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+
+	if (UBO != 0)
+	{
+		glDeleteBuffers(1, &UBO);
+		UBO = 0;
+	}
+
+	slotSize = 0;
+	slot = 0;
+	slotWritten = false;
+}
+
+FrameUniformBuffer::~FrameUniformBuffer()
+{
+	Clear();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+
+#include "Light.h"
+
+// Camera and light data shared by every program through the std140 "FrameData" block.
+// The buffer holds RING_SIZE copies so writing the next frame never stalls on a frame the GPU is still reading.
+class FrameUniformBuffer
+{
+public:
+	static const GLuint BINDING = 0;
+	static const unsigned int RING_SIZE = 3;
+
+	FrameUniformBuffer();
+
+	void Create();
+	void Update(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& cameraPosition, DirectionalLight& light);
+
+	void Clear();
+
+	~FrameUniformBuffer();
+
+private:
+	// Must match the FrameData block in the shaders, vec3s are padded to vec4 as std140 lays them out
+	struct FrameData
+	{
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::vec4 cameraPosition;
+		glm::vec4 lightColour; // rgb, ambient intensity
+		glm::vec4 lightDirection; // xyz, diffuse intensity
+		glm::vec4 lightSpecular; // specular intensity, unused
+	};
+
+	GLuint UBO;
+	GLsizeiptr slotSize;
+	unsigned int slot;
+	bool slotWritten;
+	GLsync fences[RING_SIZE];
+};
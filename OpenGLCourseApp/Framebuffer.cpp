@@ -0,0 +1,86 @@
+#include "Framebuffer.h"
+
+#include <stdio.h>
+
+Framebuffer::Framebuffer()
+{
+	FBO = 0;
+	colourBuffer = 0;
+	depthBuffer = 0;
+	width = 0;
+	height = 0;
+}
+
+bool Framebuffer::Create(GLint width, GLint height)
+{
+	ClearFramebuffer();
+
+	this->width = width;
+	this->height = height;
+
+	glGenRenderbuffers(1, &colourBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colourBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &FBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		printf("Framebuffer incomplete: 0x%x\n", status);
+		ClearFramebuffer();
+		return false;
+	}
+
+	return true;
+}
+
+void Framebuffer::Bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+	glViewport(0, 0, width, height);
+}
+
+void Framebuffer::Unbind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Framebuffer::ClearFramebuffer()
+{
+	if (FBO != 0)
+	{
+		glDeleteFramebuffers(1, &FBO);
+		FBO = 0;
+	}
+
+	if (colourBuffer != 0)
+	{
+		glDeleteRenderbuffers(1, &colourBuffer);
+		colourBuffer = 0;
+	}
+
+	if (depthBuffer != 0)
+	{
+		glDeleteRenderbuffers(1, &depthBuffer);
+		depthBuffer = 0;
+	}
+
+	width = 0;
+	height = 0;
+}
+
+Framebuffer::~Framebuffer()
+{
+	ClearFramebuffer();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <GL\glew.h>
+
+// Offscreen colour + depth target, used when there is no window to present to
+class Framebuffer
+{
+public:
+	Framebuffer();
+
+	bool Create(GLint width, GLint height);
+
+	void Bind();
+	void Unbind();
+
+	GLuint GetFBO() { return FBO; }
+	GLint GetWidth() { return width; }
+	GLint GetHeight() { return height; }
+
+	void ClearFramebuffer();
+
+	~Framebuffer();
+
+private:
+	GLuint FBO, colourBuffer, depthBuffer;
+	GLint width, height;
+};
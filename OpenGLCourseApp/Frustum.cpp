@@ -0,0 +1,151 @@
+#include "Frustum.h"
+
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_USE_SSE
+#endif
+
+void BoundingBoxList::Clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+}
+
+void BoundingBoxList::Add(const glm::vec3& center, const glm::vec3& extent)
+{
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	extentX.push_back(extent.x);
+	extentY.push_back(extent.y);
+	extentZ.push_back(extent.z);
+}
+
+Frustum::Frustum()
+{
+	for (int i = 0; i < 6; i++)
+	{
+		planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+void Frustum::Update(const glm::mat4& viewProjection)
+{
+	// glm is column major, row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 rows[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+
+	for (int i = 0; i < 6; i++)
+	{
+		float length = glm::length(glm::vec3(planes[i]));
+		if (length > 0.0f)
+		{
+			planes[i] /= length;
+		}
+	}
+}
+
+bool Frustum::IsBoxVisible(const glm::vec3& center, const glm::vec3& extent) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		glm::vec3 normal(planes[i]);
+		float distance = glm::dot(normal, center) + glm::dot(glm::abs(normal), extent) + planes[i].w;
+		if (distance < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+unsigned int Frustum::CullBoxes(const BoundingBoxList& boxes, std::vector<unsigned char>& visible) const
+{
+	size_t count = boxes.Size();
+	visible.resize(count);
+
+	unsigned int culled = 0;
+	size_t i = 0;
+
+#ifdef FRUSTUM_USE_SSE
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 centerX = _mm_loadu_ps(&boxes.centerX[i]);
+		__m128 centerY = _mm_loadu_ps(&boxes.centerY[i]);
+		__m128 centerZ = _mm_loadu_ps(&boxes.centerZ[i]);
+		__m128 extentX = _mm_loadu_ps(&boxes.extentX[i]);
+		__m128 extentY = _mm_loadu_ps(&boxes.extentY[i]);
+		__m128 extentZ = _mm_loadu_ps(&boxes.extentZ[i]);
+
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 normalX = _mm_set1_ps(planes[p].x);
+			__m128 normalY = _mm_set1_ps(planes[p].y);
+			__m128 normalZ = _mm_set1_ps(planes[p].z);
+
+			// Distance of the box center plus the box's projected radius onto the normal
+			__m128 distance = _mm_add_ps(_mm_mul_ps(centerX, normalX), _mm_set1_ps(planes[p].w));
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerY, normalY));
+			distance = _mm_add_ps(distance, _mm_mul_ps(centerZ, normalZ));
+			distance = _mm_add_ps(distance, _mm_mul_ps(extentX, _mm_andnot_ps(signMask, normalX)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(extentY, _mm_andnot_ps(signMask, normalY)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(extentZ, _mm_andnot_ps(signMask, normalZ)));
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int k = 0; k < 4; k++)
+		{
+			visible[i + k] = (mask >> k) & 1;
+			culled += 1 - visible[i + k];
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		glm::vec3 center(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]);
+		glm::vec3 extent(boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+		visible[i] = IsBoxVisible(center, extent) ? 1 : 0;
+		culled += 1 - visible[i];
+	}
+
+	return culled;
+}
+
+void Frustum::TransformBox(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax, glm::vec3& center, glm::vec3& extent)
+{
+	glm::vec3 localCenter = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 localExtent = (boundsMax - boundsMin) * 0.5f;
+
+	center = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+	extent = glm::abs(glm::vec3(model[0])) * localExtent.x +
+		glm::abs(glm::vec3(model[1])) * localExtent.y +
+		glm::abs(glm::vec3(model[2])) * localExtent.z;
+}
+
+Frustum::~Frustum()
+{
+}
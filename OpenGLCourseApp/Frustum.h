@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include <glm\glm.hpp>
+
+// World space boxes in structure-of-arrays form, so four of them can be tested per SSE iteration
+struct BoundingBoxList
+{
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+	void Clear();
+	void Add(const glm::vec3& center, const glm::vec3& extent);
+	size_t Size() const { return centerX.size(); }
+};
+
+class Frustum
+{
+public:
+	Frustum();
+
+	// Planes are taken straight from the projection * view matrix (Gribb/Hartmann)
+	void Update(const glm::mat4& viewProjection);
+
+	// Writes 1 for every box that touches the frustum and 0 for the rest, returns the number culled
+	unsigned int CullBoxes(const BoundingBoxList& boxes, std::vector<unsigned char>& visible) const;
+	bool IsBoxVisible(const glm::vec3& center, const glm::vec3& extent) const;
+
+	// Object space AABB to a world space center/extent pair enclosing it (Arvo)
+	static void TransformBox(const glm::mat4& model, const glm::vec3& boundsMin, const glm::vec3& boundsMax, glm::vec3& center, glm::vec3& extent);
+
+	~Frustum();
+
+private:
+	// left, right, bottom, top, near, far, as xyz normal and w distance
+	glm::vec4 planes[6];
+};
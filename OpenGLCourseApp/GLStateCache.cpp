@@ -0,0 +1,87 @@
+#include "GLStateCache.h"
+
+GLStateCache::GLStateCache()
+{
+	Invalidate();
+	ResetStats();
+}
+
+void GLStateCache::Invalidate()
+{
+	currentProgram = -1;
+	currentVertexArray = -1;
+	activeUnit = -1;
+
+	for (GLuint i = 0; i < MAX_TEXTURE_UNITS; i++)
+	{
+		currentTextures[i] = -1;
+	}
+}
+
+void GLStateCache::ResetStats()
+{
+	stats.programBinds = 0;
+	stats.programBindsAvoided = 0;
+	stats.textureBinds = 0;
+	stats.textureBindsAvoided = 0;
+	stats.vertexArrayBinds = 0;
+	stats.vertexArrayBindsAvoided = 0;
+	stats.drawCalls = 0;
+}
+
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (currentProgram == (GLint)program)
+	{
+		stats.programBindsAvoided++;
+		return;
+	}
+
+	glUseProgram(program);
+	currentProgram = program;
+	stats.programBinds++;
+}
+
+void GLStateCache::BindTexture(GLuint unit, GLuint texture)
+{
+	BindTexture(unit, GL_TEXTURE_2D, texture);
+}
+
+void GLStateCache::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if (unit < MAX_TEXTURE_UNITS && currentTextures[unit] == (GLint)texture)
+	{
+		stats.textureBindsAvoided++;
+		return;
+	}
+
+	if (activeUnit != (GLint)unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+
+	glBindTexture(target, texture);
+	if (unit < MAX_TEXTURE_UNITS)
+	{
+		currentTextures[unit] = texture;
+	}
+	stats.textureBinds++;
+}
+
+void GLStateCache::BindVertexArray(GLuint vertexArray)
+{
+	if (currentVertexArray == (GLint)vertexArray)
+	{
+		stats.vertexArrayBindsAvoided++;
+		return;
+	}
+
+	glBindVertexArray(vertexArray);
+	currentVertexArray = vertexArray;
+	stats.vertexArrayBinds++;
+}
+
+GLStateCache::~GLStateCache()
+{
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <GL\glew.h>
+
+struct GLStateStats
+{
+	unsigned int programBinds, programBindsAvoided;
+	unsigned int textureBinds, textureBindsAvoided;
+	unsigned int vertexArrayBinds, vertexArrayBindsAvoided;
+	unsigned int drawCalls;
+};
+
+// Shadows the GL binding state so repeated binds of the same object are skipped.
+// Anything that changes GL state behind its back (ImGui, raw gl calls) must be followed by Invalidate().
+class GLStateCache
+{
+public:
+	static const GLuint MAX_TEXTURE_UNITS = 16;
+
+	GLStateCache();
+
+	void Invalidate();
+	void ResetStats();
+
+	void UseProgram(GLuint program);
+	void BindTexture(GLuint unit, GLuint texture);
+	// Texture names are unique across targets, so the cache tracks one name per unit whatever the target
+	void BindTexture(GLuint unit, GLenum target, GLuint texture);
+	void BindVertexArray(GLuint vertexArray);
+	void CountDraw() { stats.drawCalls++; }
+
+	const GLStateStats& GetStats() { return stats; }
+
+	~GLStateCache();
+
+private:
+	// Bound names are tracked as GLint so -1 can mean "unknown"
+	GLint currentProgram;
+	GLint currentVertexArray;
+	GLint currentTextures[MAX_TEXTURE_UNITS];
+	GLint activeUnit;
+
+	GLStateStats stats;
+};
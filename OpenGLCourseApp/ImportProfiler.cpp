@@ -0,0 +1,207 @@
+#include "ImportProfiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <map>
+
+#include <assimp/DefaultLogger.hpp>
+#include <assimp/LogStream.hpp>
+
+bool ImportProfiler::enabled = false;
+
+// The logger is shared by every thread, but writes to its streams on the thread that logged
+static thread_local ImportProfiler::Record* currentRecord = NULL;
+// Name of the post-process step that started last, most steps log "<Name> begin" when they start
+static thread_local std::string pendingStep;
+
+static void HandleLogMessage(const char* message)
+{
+	if (currentRecord == NULL)
+	{
+		return;
+	}
+
+	// "Debug, T0: END   `postprocess`, dt= 0.0012 s"
+	std::string text(message);
+	size_t prefixEnd = text.find(": ");
+	if (prefixEnd != std::string::npos)
+	{
+		text = text.substr(prefixEnd + 2);
+	}
+	while (!text.empty() && (text[text.size() - 1] == '\n' || text[text.size() - 1] == '\r' || text[text.size() - 1] == ' '))
+	{
+		text.erase(text.size() - 1);
+	}
+
+	static const char END_PREFIX[] = "END   `";
+	static const char BEGIN_SUFFIX[] = " begin";
+	const size_t endPrefixLength = sizeof(END_PREFIX) - 1;
+	const size_t beginSuffixLength = sizeof(BEGIN_SUFFIX) - 1;
+
+	if (text.compare(0, endPrefixLength, END_PREFIX) == 0)
+	{
+		size_t nameEnd = text.find('`', endPrefixLength);
+		size_t elapsed = text.find("dt= ");
+		if (nameEnd == std::string::npos || elapsed == std::string::npos)
+		{
+			return;
+		}
+
+		std::string region = text.substr(endPrefixLength, nameEnd - endPrefixLength);
+		// The whole import is timed by ModelImporter
+		if (region == "total")
+		{
+			return;
+		}
+		if (region == "postprocess")
+		{
+			region = pendingStep.empty() ? "unnamed step" : pendingStep;
+		}
+		else if (region == "import")
+		{
+			region = "parse";
+		}
+		pendingStep.clear();
+
+		ImportProfiler::Step step;
+		step.name = region;
+		step.milliseconds = atof(text.c_str() + elapsed + 4) * 1000.0;
+		currentRecord->steps.push_back(step);
+	}
+	else if (text.size() > beginSuffixLength && text.compare(text.size() - beginSuffixLength, beginSuffixLength, BEGIN_SUFFIX) == 0)
+	{
+		pendingStep = text.substr(0, text.size() - beginSuffixLength);
+	}
+}
+
+class ProfileLogStream : public Assimp::LogStream
+{
+public:
+	void write(const char* message) override
+	{
+		HandleLogMessage(message);
+	}
+};
+
+ImportProfiler::Record::Record()
+{
+	succeeded = false;
+	totalMilliseconds = 0.0;
+	readMilliseconds = 0.0;
+	convertMilliseconds = 0.0;
+	finishMilliseconds = 0.0;
+	meshCount = 0;
+	vertexCount = 0;
+	indexCount = 0;
+}
+
+void ImportProfiler::Enable()
+{
+	if (enabled)
+	{
+		return;
+	}
+
+	// Debug messages only, the timings are all logged at that level. No file or debugger output
+	Assimp::DefaultLogger::create("", Assimp::Logger::DEBUGGING, 0);
+	Assimp::DefaultLogger::get()->attachStream(new ProfileLogStream(), Assimp::Logger::Debugging);
+	enabled = true;
+}
+
+void ImportProfiler::Disable()
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	// Deletes the attached stream
+	Assimp::DefaultLogger::kill();
+	enabled = false;
+}
+
+void ImportProfiler::Begin(Record* record)
+{
+	currentRecord = record;
+	pendingStep.clear();
+}
+
+void ImportProfiler::End()
+{
+	currentRecord = NULL;
+	pendingStep.clear();
+}
+
+bool ImportProfiler::WriteReport(const std::vector<Record>& records, const std::string& outputLocation)
+{
+	std::ofstream fileStream(outputLocation.c_str(), std::ios::out | std::ios::trunc);
+	if (!fileStream.is_open())
+	{
+		printf("Failed to write import report %s!\n", outputLocation.c_str());
+		return false;
+	}
+
+	char line[512];
+	fileStream << "{\n  \"imports\": [\n";
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const Record& record = records[i];
+		snprintf(line, sizeof(line), "    {\n      \"file\": \"%s\",\n      \"preset\": \"%s\",\n      \"succeeded\": %s,\n"
+			"      \"ms\": { \"total\": %.4f, \"read\": %.4f, \"convert\": %.4f, \"finish\": %.4f },\n"
+			"      \"meshes\": %zu,\n      \"vertices\": %zu,\n      \"indices\": %zu,\n      \"steps\": [",
+			record.filePath.c_str(), record.preset.c_str(), record.succeeded ? "true" : "false",
+			record.totalMilliseconds, record.readMilliseconds, record.convertMilliseconds, record.finishMilliseconds,
+			record.meshCount, record.vertexCount, record.indexCount);
+		fileStream << line;
+
+		for (size_t j = 0; j < record.steps.size(); j++)
+		{
+			snprintf(line, sizeof(line), "%s\n        { \"name\": \"%s\", \"ms\": %.4f }",
+				j > 0 ? "," : "", record.steps[j].name.c_str(), record.steps[j].milliseconds);
+			fileStream << line;
+		}
+		fileStream << (record.steps.empty() ? "]\n    }" : "\n      ]\n    }") << (i + 1 < records.size() ? ",\n" : "\n");
+	}
+	fileStream << "  ]\n}\n";
+
+	// Same numbers for the console, then the fastest preset of each model. The presets can build
+	// different meshes, compare the vertex counts before adopting a suggestion
+	std::map<std::string, const Record*> fastest;
+	std::vector<std::string> order;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const Record& record = records[i];
+		printf("%-28s %-16s %9.2f ms  read %8.2f  convert %7.2f  finish %8.2f  %7zu verts%s\n",
+			record.filePath.c_str(), record.preset.c_str(), record.totalMilliseconds, record.readMilliseconds,
+			record.convertMilliseconds, record.finishMilliseconds, record.vertexCount, record.succeeded ? "" : "  FAILED");
+		for (size_t j = 0; j < record.steps.size(); j++)
+		{
+			printf("    %-40s %9.3f ms\n", record.steps[j].name.c_str(), record.steps[j].milliseconds);
+		}
+
+		if (!record.succeeded)
+		{
+			continue;
+		}
+		std::map<std::string, const Record*>::iterator best = fastest.find(record.filePath);
+		if (best == fastest.end())
+		{
+			fastest[record.filePath] = &record;
+			order.push_back(record.filePath);
+		}
+		else if (record.totalMilliseconds < best->second->totalMilliseconds)
+		{
+			best->second = &record;
+		}
+	}
+
+	printf("\nFastest preset per model, as import preset lines:\n");
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		printf("%s %s\n", order[i].c_str(), fastest[order[i]]->preset.c_str());
+	}
+
+	return fileStream.good();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Where model imports spend their time, see "--import-report". Assimp times its parse and each
+// post-process step when AI_CONFIG_GLOB_MEASURE_TIME is set, but only tells its logger. Enable
+// installs a DefaultLogger with a stream that picks those timings out of the messages and files
+// them under the Record the logging thread is importing into.
+class ImportProfiler
+{
+public:
+	struct Step
+	{
+		std::string name;
+		double milliseconds;
+	};
+
+	struct Record
+	{
+		std::string filePath;
+		std::string preset;
+		bool succeeded;
+
+		// read is OBJLoader::LoadOBJ or Assimp's ReadFile with all its steps, convert is building
+		// MeshData, finish is MeshOptimizer, MeshSimplifier and the vertex format choice
+		double totalMilliseconds;
+		double readMilliseconds;
+		double convertMilliseconds;
+		double finishMilliseconds;
+
+		size_t meshCount;
+		size_t vertexCount;
+		size_t indexCount;
+
+		// Assimp's regions in the order they ended: parse, preprocess and one per post-process step
+		std::vector<Step> steps;
+
+		Record();
+	};
+
+	static void Enable();
+	static void Disable();
+	static bool IsEnabled() { return enabled; }
+
+	// Brackets the imports the calling thread makes for record
+	static void Begin(Record* record);
+	static void End();
+
+	// Every record as JSON, with a summary and the fastest preset of each model on stdout
+	static bool WriteReport(const std::vector<Record>& records, const std::string& outputLocation);
+
+private:
+	static bool enabled;
+};
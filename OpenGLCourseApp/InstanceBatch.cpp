@@ -0,0 +1,151 @@
+#include "InstanceBatch.h"
+
+InstanceBatch::InstanceBatch()
+{
+	instanceCount = 0;
+	drawCount = 0;
+	culledCount = 0;
+	triangleCount = 0;
+}
+
+void InstanceBatch::Begin()
+{
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		batches[i].models.clear();
+		batches[i].layers.clear();
+	}
+
+	instanceCount = 0;
+	drawCount = 0;
+	culledCount = 0;
+	triangleCount = 0;
+}
+
+void InstanceBatch::Add(Mesh* mesh, Texture* texture, const glm::mat4& model)
+{
+	const void* textureKey = texture->GetArray() != NULL ? (const void*)texture->GetArray() : (const void*)texture;
+	std::pair<Mesh*, const void*> key(mesh, textureKey);
+	std::map<std::pair<Mesh*, const void*>, size_t>::iterator it = batchIndex.find(key);
+
+	if (it == batchIndex.end())
+	{
+		Batch batch;
+		batch.mesh = mesh;
+		batch.texture = texture;
+		it = batchIndex.insert(std::make_pair(key, batches.size())).first;
+		batches.push_back(batch);
+	}
+
+	batches[it->second].models.push_back(model);
+	batches[it->second].layers.push_back(texture->GetArrayLayer());
+	instanceCount++;
+}
+
+void InstanceBatch::Add(const std::vector<Mesh*>& meshList, Texture* texture, const glm::mat4& model)
+{
+	for (size_t i = 0; i < meshList.size(); i++)
+	{
+		Add(meshList[i], texture, model);
+	}
+}
+
+void InstanceBatch::Submit(RenderQueue& queue, ShaderVariants* shaders, const Frustum* frustum, const LodSelector* lodSelector)
+{
+	for (std::map<Mesh*, std::vector<InstanceTransform> >::iterator it = meshInstances.begin(); it != meshInstances.end(); ++it)
+	{
+		it->second.clear();
+	}
+
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		Batch& batch = batches[i];
+		if (batch.models.empty())
+		{
+			continue;
+		}
+
+		boxVisible.assign(batch.models.size(), 1);
+		if (frustum != NULL)
+		{
+			boxes.Clear();
+			for (size_t j = 0; j < batch.models.size(); j++)
+			{
+				glm::vec3 center, extent;
+				Frustum::TransformBox(batch.models[j], batch.mesh->GetBoundsMin(), batch.mesh->GetBoundsMax(), center, extent);
+				boxes.Add(center, extent);
+			}
+			culledCount += frustum->CullBoxes(boxes, boxVisible);
+		}
+
+		// Count the visible instances of every level, so each level gets one contiguous range of the instance buffer
+		GLsizei lodInstances[MeshLod::MAX_LODS] = { 0 };
+		batch.lods.resize(batch.models.size(), 0);
+		for (size_t j = 0; j < batch.models.size(); j++)
+		{
+			if (!boxVisible[j])
+			{
+				continue;
+			}
+
+			unsigned int lod = lodSelector != NULL ? lodSelector->Select(batch.mesh, batch.models[j], batch.lods[j]) : 0;
+			batch.lods[j] = (unsigned char)lod;
+			lodInstances[lod]++;
+		}
+
+		// Ranges start after the instances of earlier batches of the same mesh
+		std::vector<InstanceTransform>& instances = meshInstances[batch.mesh];
+		GLsizei firstInstance = (GLsizei)instances.size();
+		GLsizei lodOffsets[MeshLod::MAX_LODS];
+		GLsizei count = 0;
+		for (unsigned int lod = 0; lod < MeshLod::MAX_LODS; lod++)
+		{
+			lodOffsets[lod] = firstInstance + count;
+			count += lodInstances[lod];
+		}
+
+		if (count == 0)
+		{
+			continue;
+		}
+
+		// Quantized meshes need their dequantize transform folded into every instance matrix
+		const glm::mat4& dequantize = batch.mesh->GetDequantizeTransform();
+		bool quantized = batch.mesh->IsQuantized();
+		instances.resize(firstInstance + count);
+		for (size_t j = 0; j < batch.models.size(); j++)
+		{
+			if (boxVisible[j])
+			{
+				instances[lodOffsets[batch.lods[j]]++] = InstanceTransform::Make(quantized ? batch.models[j] * dequantize : batch.models[j],
+					batch.layers[j]);
+			}
+		}
+
+		Shader* shader = shaders->Get(ShaderVariants::GetFeatures(batch.mesh, batch.texture) | ShaderVariants::INSTANCED);
+		for (unsigned int lod = 0; lod < MeshLod::MAX_LODS; lod++)
+		{
+			if (lodInstances[lod] == 0)
+			{
+				continue;
+			}
+
+			// lodOffsets now point at the end of each range
+			queue.SubmitInstanced(shader, batch.texture, batch.mesh, lodInstances[lod], lod, lodOffsets[lod] - lodInstances[lod]);
+			triangleCount += lodInstances[lod] * (batch.mesh->GetLod(lod).indexCount / 3);
+			drawCount++;
+		}
+	}
+
+	for (std::map<Mesh*, std::vector<InstanceTransform> >::iterator it = meshInstances.begin(); it != meshInstances.end(); ++it)
+	{
+		if (!it->second.empty())
+		{
+			it->first->SetInstanceTransforms(&it->second[0], (GLsizei)it->second.size());
+		}
+	}
+}
+
+InstanceBatch::~InstanceBatch()
+{
+}
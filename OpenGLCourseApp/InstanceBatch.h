@@ -0,0 +1,66 @@
+#pragma once
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+
+#include "Frustum.h"
+#include "LodSelector.h"
+#include "Mesh.h"
+#include "RenderQueue.h"
+#include "ShaderVariants.h"
+#include "Texture.h"
+
+// Collects the model matrices of every object sharing a mesh and texture during a frame,
+// then submits each group to the render queue as a single instanced draw. Textures that are
+// layers of the same TextureArray count as one texture, the layer goes with each instance.
+class InstanceBatch
+{
+public:
+	InstanceBatch();
+
+	void Begin();
+	void Add(Mesh* mesh, Texture* texture, const glm::mat4& model);
+	void Add(const std::vector<Mesh*>& meshList, Texture* texture, const glm::mat4& model);
+	// Instances outside the frustum are dropped before upload, pass NULL to keep them all.
+	// Each level of detail in use becomes its own draw, pass a NULL lodSelector to draw level 0 only
+	void Submit(RenderQueue& queue, ShaderVariants* shaders, const Frustum* frustum, const LodSelector* lodSelector);
+
+	unsigned int GetInstanceCount() { return instanceCount; }
+	unsigned int GetDrawCount() { return drawCount; }
+	unsigned int GetCulledCount() { return culledCount; }
+	unsigned int GetTriangleCount() { return triangleCount; }
+
+	~InstanceBatch();
+
+private:
+	struct Batch
+	{
+		Mesh* mesh;
+		Texture* texture;
+		std::vector<glm::mat4> models;
+		std::vector<GLint> layers;
+		// Level each instance was drawn with last frame, instances are matched up by the order they're added in
+		std::vector<unsigned char> lods;
+	};
+
+	// Batches are kept between frames so their matrix storage is reused
+	std::vector<Batch> batches;
+	// Keyed by the texture, or by its TextureArray for an array layer
+	std::map<std::pair<Mesh*, const void*>, size_t> batchIndex;
+
+	unsigned int instanceCount;
+	unsigned int drawCount;
+	unsigned int culledCount;
+	unsigned int triangleCount;
+
+	BoundingBoxList boxes;
+	std::vector<unsigned char> boxVisible;
+	// Batches that share a mesh share its instance buffer, each takes its own range of it. A mesh's
+	// buffer is uploaded once after every batch is gathered, the draws only happen at RenderQueue::Flush
+	std::map<Mesh*, std::vector<InstanceTransform> > meshInstances;
+};
@@ -0,0 +1,132 @@
+#include "KTXFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const unsigned char KTXFile::IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+const char KTXFile::SOURCE_HASH_KEY[] = "TrolleySourceHash";
+
+KTXFile::KTXFile()
+{
+	internalFormat = 0;
+	width = 0;
+	height = 0;
+	layerCount = 0;
+	sourceHash = 0;
+}
+
+bool KTXFile::Open(const std::string& fileLocation)
+{
+	Close();
+
+	if (!file.Open(fileLocation))
+	{
+		return false;
+	}
+
+	const unsigned char* data = file.GetData();
+	size_t size = file.GetSize();
+
+	if (size < sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+
+	const Header* header = (const Header*)data;
+	// Only what the cooker writes: compressed, little endian, one 2D face or an array of them
+	if (memcmp(header->identifier, IDENTIFIER, 12) != 0 || header->endianness != 0x04030201 ||
+		header->glType != 0 || header->pixelDepth != 0 || header->numberOfFaces != 1)
+	{
+		printf("Unsupported KTX file: %s\n", fileLocation.c_str());
+		Close();
+		return false;
+	}
+
+	size_t offset = sizeof(Header);
+	size_t keyValueEnd = offset + header->bytesOfKeyValueData;
+	if (keyValueEnd > size)
+	{
+		Close();
+		return false;
+	}
+
+	while (offset + 4 <= keyValueEnd)
+	{
+		uint32_t keyAndValueSize = *(const uint32_t*)(data + offset);
+		const char* keyAndValue = (const char*)(data + offset + 4);
+		if (offset + 4 + keyAndValueSize > keyValueEnd)
+		{
+			break;
+		}
+
+		if (keyAndValueSize > sizeof(SOURCE_HASH_KEY) && memcmp(keyAndValue, SOURCE_HASH_KEY, sizeof(SOURCE_HASH_KEY)) == 0)
+		{
+			std::string value(keyAndValue + sizeof(SOURCE_HASH_KEY), keyAndValueSize - sizeof(SOURCE_HASH_KEY));
+			sourceHash = strtoull(value.c_str(), NULL, 16);
+		}
+
+		offset += 4 + ((keyAndValueSize + 3) & ~3u);
+	}
+	offset = keyValueEnd;
+
+	uint32_t levelCount = header->numberOfMipmapLevels > 0 ? header->numberOfMipmapLevels : 1;
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		if (offset + 4 > size)
+		{
+			Close();
+			return false;
+		}
+
+		Level level;
+		level.width = (GLsizei)(header->pixelWidth >> i) > 0 ? (GLsizei)(header->pixelWidth >> i) : 1;
+		level.height = (GLsizei)(header->pixelHeight >> i) > 0 ? (GLsizei)(header->pixelHeight >> i) : 1;
+		level.imageSize = *(const uint32_t*)(data + offset);
+		level.data = data + offset + 4;
+
+		if (offset + 4 + level.imageSize > size)
+		{
+			Close();
+			return false;
+		}
+
+		levels.push_back(level);
+		offset += 4 + ((level.imageSize + 3) & ~3u);
+	}
+
+	internalFormat = header->glInternalFormat;
+	width = header->pixelWidth;
+	height = header->pixelHeight;
+	layerCount = header->numberOfArrayElements;
+	return true;
+}
+
+void KTXFile::Close()
+{
+	file.Close();
+	levels.clear();
+	internalFormat = 0;
+	width = 0;
+	height = 0;
+	layerCount = 0;
+	sourceHash = 0;
+}
+
+std::string KTXFile::GetCookedLocation(const std::string& sourceLocation)
+{
+	size_t dot = sourceLocation.find_last_of('.');
+	size_t slash = sourceLocation.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+	{
+		return sourceLocation + ".ktx";
+	}
+
+	return sourceLocation.substr(0, dot) + ".ktx";
+}
+
+KTXFile::~KTXFile()
+{
+	Close();
+}
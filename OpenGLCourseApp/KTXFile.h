@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <GL\glew.h>
+
+#include "MappedFile.h"
+
+// Memory mapped KTX 1.1 file holding a single 2D texture or 2D texture array with its full
+// mip chain, as written by TextureCooker.
+class KTXFile
+{
+public:
+	struct Header
+	{
+		unsigned char identifier[12];
+		uint32_t endianness;
+		uint32_t glType;
+		uint32_t glTypeSize;
+		uint32_t glFormat;
+		uint32_t glInternalFormat;
+		uint32_t glBaseInternalFormat;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t numberOfArrayElements;
+		uint32_t numberOfFaces;
+		uint32_t numberOfMipmapLevels;
+		uint32_t bytesOfKeyValueData;
+	};
+
+	static const unsigned char IDENTIFIER[12];
+	static const char SOURCE_HASH_KEY[];
+
+	struct Level
+	{
+		GLsizei width, height;
+		// Covers every layer of an array, the layers follow each other
+		GLsizei imageSize;
+		const unsigned char* data;
+	};
+
+	KTXFile();
+
+	bool Open(const std::string& fileLocation);
+	void Close();
+
+	GLenum GetInternalFormat() { return internalFormat; }
+	GLsizei GetWidth() { return width; }
+	GLsizei GetHeight() { return height; }
+	// 0 for a plain 2D texture
+	GLsizei GetLayerCount() { return layerCount; }
+	size_t GetLevelCount() { return levels.size(); }
+	const Level& GetLevel(size_t level) { return levels[level]; }
+
+	// Hash of the image the file was cooked from, 0 if it wasn't recorded
+	uint64_t GetSourceHash() { return sourceHash; }
+
+	static std::string GetCookedLocation(const std::string& sourceLocation);
+
+	~KTXFile();
+
+private:
+	MappedFile file;
+	GLenum internalFormat;
+	GLsizei width, height;
+	GLsizei layerCount;
+	uint64_t sourceHash;
+	std::vector<Level> levels;
+};
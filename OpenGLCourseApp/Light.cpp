@@ -12,12 +12,6 @@ Light::Light(GLfloat red, GLfloat green, GLfloat blue, GLfloat aIntensity)
 	ambientIntensity = aIntensity;
 }
 
-void Light::UseLight(GLfloat ambientIntensityLocation, GLfloat ambientColourLocation)
-{
-	glUniform3f(ambientColourLocation, colour.x * 1.0f, colour.y * 1.0f, colour.z * 1.0f);
-	glUniform1f(ambientIntensityLocation, ambientIntensity * 1.0f);
-}
-
 Light::~Light()
 {
 
@@ -41,11 +35,44 @@ DirectionalLight::DirectionalLight(GLfloat red, GLfloat green, GLfloat blue, GLf
 	localDirection = glm::vec3(0.0, 1.0f, 0.0f);
 }
 
-void DirectionalLight::UseDirLight(GLfloat ambientIntensityLocation, GLfloat ambientColourLocation, GLfloat diffuseIntensityLocation, GLfloat specularIntensityLocation, GLfloat lightDirectionLocation)
+PointLight::PointLight()
+{
+	colour = glm::vec3(1.0f, 1.0f, 1.0f);
+	ambientIntensity = 0.0f;
+	diffuseIntensity = 1.0f;
+	specularIntensity = 1.0f;
+	position = glm::vec3(0.0f, 0.0f, 0.0f);
+	constant = 1.0f;
+	linear = 0.0f;
+	exponent = 1.0f;
+}
+
+PointLight::PointLight(GLfloat red, GLfloat green, GLfloat blue, GLfloat aIntensity, GLfloat dIntensity, GLfloat sIntensity,
+	GLfloat xPos, GLfloat yPos, GLfloat zPos, GLfloat con, GLfloat lin, GLfloat exp)
 {
-	glUniform3f(ambientColourLocation, colour.x * 1.5f, colour.y * 1.5f, colour.z * 1.5f);
-	glUniform1f(ambientIntensityLocation, ambientIntensity * 1.0f);
-	glUniform1f(diffuseIntensityLocation, diffuseIntensity);
-	glUniform1f(specularIntensityLocation, specularIntensity);
-	glUniform3f(lightDirectionLocation, localDirection.x, localDirection.y, localDirection.y);
-}
\ No newline at end of file
+	colour = glm::vec3(red, green, blue);
+	ambientIntensity = aIntensity;
+	diffuseIntensity = dIntensity;
+	specularIntensity = sIntensity;
+	position = glm::vec3(xPos, yPos, zPos);
+	constant = con;
+	linear = lin;
+	exponent = exp;
+}
+
+GLfloat PointLight::getRange()
+{
+	// Solve exponent * d^2 + linear * d + constant = 256 * brightest for d
+	GLfloat brightest = glm::max(colour.r, glm::max(colour.g, colour.b)) * glm::max(diffuseIntensity, specularIntensity);
+	GLfloat c = constant - 256.0f * brightest;
+	if (c >= 0.0f)
+	{
+		return 0.0f;
+	}
+	if (exponent <= 0.0f)
+	{
+		return linear > 0.0f ? -c / linear : 1e30f;
+	}
+
+	return (-linear + sqrtf(linear * linear - 4.0f * exponent * c)) / (2.0f * exponent);
+}
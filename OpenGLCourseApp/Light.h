@@ -14,8 +14,10 @@ public:
 	Light();
 	Light(GLfloat red, GLfloat green, GLfloat blue, GLfloat aIntensity);
 
-	void UseLight(GLfloat ambientIntensityLocation, GLfloat ambientColourLocation);
+	glm::vec3 getColour() { return colour; }
 	float* getAmbientIntensity() { return &ambientIntensity; };
+	GLfloat getDiffuseIntensity() { return diffuseIntensity; }
+	GLfloat getSpecularIntensity() { return specularIntensity; }
 	~Light();
 
 protected:
@@ -33,6 +35,24 @@ public:
 	DirectionalLight(GLfloat red, GLfloat green, GLfloat blue, GLfloat aIntensity, GLfloat dIntensity, GLfloat sIntensity);
 
 	glm::vec3 localDirection;
-	void UseDirLight(GLfloat ambientIntensityLocation, GLfloat ambientColourLocation, GLfloat diffuseIntensityLocation, GLfloat specularIntensityLocation, GLfloat lightDirectionLocation);
 	void print();
+};
+
+class PointLight : public Light
+{
+
+public:
+	PointLight();
+	PointLight(GLfloat red, GLfloat green, GLfloat blue, GLfloat aIntensity, GLfloat dIntensity, GLfloat sIntensity,
+		GLfloat xPos, GLfloat yPos, GLfloat zPos, GLfloat con, GLfloat lin, GLfloat exp);
+
+	glm::vec3 position;
+	GLfloat getConstant() { return constant; }
+	GLfloat getLinear() { return linear; }
+	GLfloat getExponent() { return exponent; }
+	// Distance where the light's brightest channel drops below 1/256, it lights nothing past it
+	GLfloat getRange();
+
+protected:
+	GLfloat constant, linear, exponent;
 };
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include "LightClusters.h"
+
+#include <math.h>
+
+LightClusters::LightClusters()
+{
+	UBO = 0;
+	lightBuffer = 0;
+	clusterBuffer = 0;
+	indexBuffer = 0;
+	lightTexture = 0;
+	clusterTexture = 0;
+	indexTexture = 0;
+	projectionParams = glm::vec4(0.0f);
+	gridWidth = 0;
+	gridHeight = 0;
+	visibleLightCount = 0;
+	maxClusterLights = 0;
+}
+
+GLuint LightClusters::CreateBufferTexture(GLuint buffer, GLenum internalFormat)
+{
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	return texture;
+}
+
+void LightClusters::Create()
+{
+	glGenBuffers(1, &UBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterData), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// Sized on every Update, a buffer texture keeps pointing at its buffer through glBufferData
+	GLuint buffers[3];
+	glGenBuffers(3, buffers);
+	lightBuffer = buffers[0];
+	clusterBuffer = buffers[1];
+	indexBuffer = buffers[2];
+	for (int i = 0; i < 3; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(LightData), NULL, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	lightTexture = CreateBufferTexture(lightBuffer, GL_RGBA32F);
+	clusterTexture = CreateBufferTexture(clusterBuffer, GL_RG32UI);
+	indexTexture = CreateBufferTexture(indexBuffer, GL_R16UI);
+
+	clusterRanges.resize(CLUSTER_COUNT);
+}
+
+void LightClusters::BuildClusters(const glm::vec4& params, GLsizei viewportWidth, GLsizei viewportHeight)
+{
+	projectionParams = params;
+	gridWidth = viewportWidth;
+	gridHeight = viewportHeight;
+
+	float nearPlane = params.z, farPlane = params.w;
+	clusterMin.resize(CLUSTER_COUNT);
+	clusterMax.resize(CLUSTER_COUNT);
+
+	for (unsigned int z = 0; z < GRID_Z; z++)
+	{
+		float depth0 = nearPlane * powf(farPlane / nearPlane, (float)z / GRID_Z);
+		float depth1 = nearPlane * powf(farPlane / nearPlane, (float)(z + 1) / GRID_Z);
+		for (unsigned int y = 0; y < GRID_Y; y++)
+		{
+			float ndcY0 = -1.0f + 2.0f * y / GRID_Y, ndcY1 = -1.0f + 2.0f * (y + 1) / GRID_Y;
+			for (unsigned int x = 0; x < GRID_X; x++)
+			{
+				float ndcX0 = -1.0f + 2.0f * x / GRID_X, ndcX1 = -1.0f + 2.0f * (x + 1) / GRID_X;
+
+				// The tile's sides are planes through the eye, so the box spans both ends of the slice
+				size_t cluster = (z * GRID_Y + y) * GRID_X + x;
+				clusterMin[cluster] = glm::vec3(glm::min(ndcX0 * depth0, ndcX0 * depth1) / params.x,
+					glm::min(ndcY0 * depth0, ndcY0 * depth1) / params.y, depth0);
+				clusterMax[cluster] = glm::vec3(glm::max(ndcX1 * depth0, ndcX1 * depth1) / params.x,
+					glm::max(ndcY1 * depth0, ndcY1 * depth1) / params.y, depth1);
+			}
+		}
+	}
+
+	// The shader finds its cluster from gl_FragCoord and the log of its view depth
+	float logDepthRange = logf(farPlane / nearPlane);
+	ClusterData data;
+	data.clusterScale = glm::vec4((float)GRID_X / viewportWidth, (float)GRID_Y / viewportHeight,
+		GRID_Z / logDepthRange, -(float)GRID_Z * logf(nearPlane) / logDepthRange);
+	data.clusterGrid = glm::vec4((float)GRID_X, (float)GRID_Y, (float)GRID_Z, 0.0f);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ClusterData), &data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void LightClusters::Update(const glm::mat4& projection, const glm::mat4& view, GLsizei viewportWidth, GLsizei viewportHeight, std::vector<PointLight>& lights)
+{
+	if (UBO == 0 || viewportWidth <= 0 || viewportHeight <= 0)
+	{
+		return;
+	}
+
+	// Near and far back out of a glm::perspective matrix
+	glm::vec4 params(projection[0][0], projection[1][1],
+		projection[3][2] / (projection[2][2] - 1.0f), projection[3][2] / (projection[2][2] + 1.0f));
+	if (params != projectionParams || viewportWidth != gridWidth || viewportHeight != gridHeight)
+	{
+		BuildClusters(params, viewportWidth, viewportHeight);
+	}
+
+	float nearPlane = params.z, farPlane = params.w;
+	float sliceScale = GRID_Z / logf(farPlane / nearPlane);
+
+	lightData.clear();
+	lightClusterPairs.clear();
+	for (size_t i = 0; i < lights.size() && lightData.size() < MAX_LIGHTS; i++)
+	{
+		float range = lights[i].getRange();
+		glm::vec3 viewPosition = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+		glm::vec3 center(viewPosition.x, viewPosition.y, -viewPosition.z);
+		if (range <= 0.0f || center.z + range < nearPlane || center.z - range > farPlane)
+		{
+			continue;
+		}
+
+		// Slices and tiles covered by the light's bounding box. The projected box is widest at its
+		// nearest depth, checking both depths covers lights on either side of the view axis
+		float depth0 = glm::max(center.z - range, nearPlane), depth1 = glm::min(center.z + range, farPlane);
+		int slice0 = glm::clamp((int)floorf(logf(depth0 / nearPlane) * sliceScale), 0, (int)GRID_Z - 1);
+		int slice1 = glm::clamp((int)floorf(logf(depth1 / nearPlane) * sliceScale), 0, (int)GRID_Z - 1);
+
+		float ndcX[4] = { (center.x - range) / depth0, (center.x - range) / depth1, (center.x + range) / depth0, (center.x + range) / depth1 };
+		float ndcY[4] = { (center.y - range) / depth0, (center.y - range) / depth1, (center.y + range) / depth0, (center.y + range) / depth1 };
+		float minX = ndcX[0], maxX = ndcX[0], minY = ndcY[0], maxY = ndcY[0];
+		for (int j = 1; j < 4; j++)
+		{
+			minX = glm::min(minX, ndcX[j]);
+			maxX = glm::max(maxX, ndcX[j]);
+			minY = glm::min(minY, ndcY[j]);
+			maxY = glm::max(maxY, ndcY[j]);
+		}
+		int tileX0 = glm::clamp((int)floorf((minX * params.x + 1.0f) * 0.5f * GRID_X), 0, (int)GRID_X - 1);
+		int tileX1 = glm::clamp((int)floorf((maxX * params.x + 1.0f) * 0.5f * GRID_X), 0, (int)GRID_X - 1);
+		int tileY0 = glm::clamp((int)floorf((minY * params.y + 1.0f) * 0.5f * GRID_Y), 0, (int)GRID_Y - 1);
+		int tileY1 = glm::clamp((int)floorf((maxY * params.y + 1.0f) * 0.5f * GRID_Y), 0, (int)GRID_Y - 1);
+
+		uint32_t lightIndex = (uint32_t)lightData.size();
+		bool touched = false;
+		for (int z = slice0; z <= slice1; z++)
+		{
+			for (int y = tileY0; y <= tileY1; y++)
+			{
+				for (int x = tileX0; x <= tileX1; x++)
+				{
+					// Sphere against the cluster's box drops the corners the tile ranges over-cover
+					uint32_t cluster = (z * GRID_Y + y) * GRID_X + x;
+					glm::vec3 closest = glm::clamp(center, clusterMin[cluster], clusterMax[cluster]);
+					glm::vec3 offset = closest - center;
+					if (glm::dot(offset, offset) <= range * range)
+					{
+						lightClusterPairs.push_back(cluster << 16 | lightIndex);
+						touched = true;
+					}
+				}
+			}
+		}
+
+		if (!touched)
+		{
+			continue;
+		}
+
+		LightData data;
+		data.positionRange = glm::vec4(lights[i].position, range);
+		data.colourSpecular = glm::vec4(lights[i].getColour() * lights[i].getDiffuseIntensity(), lights[i].getSpecularIntensity());
+		data.attenuation = glm::vec4(lights[i].getConstant(), lights[i].getLinear(), lights[i].getExponent(), 0.0f);
+		lightData.push_back(data);
+	}
+	visibleLightCount = (unsigned int)lightData.size();
+
+	// Counting sort of the pairs by cluster, each cluster's lights end up contiguous and in light order
+	clusterCounts.assign(CLUSTER_COUNT, 0);
+	for (size_t i = 0; i < lightClusterPairs.size(); i++)
+	{
+		clusterCounts[lightClusterPairs[i] >> 16]++;
+	}
+
+	GLuint offset = 0;
+	maxClusterLights = 0;
+	for (size_t i = 0; i < CLUSTER_COUNT; i++)
+	{
+		// Clusters that don't fit in the index texture lose their lights rather than read past its end
+		GLuint count = offset + clusterCounts[i] <= MAX_LIGHT_INDICES ? clusterCounts[i] : 0;
+		clusterRanges[i].offset = offset;
+		clusterRanges[i].count = count;
+		offset += count;
+		maxClusterLights = glm::max(maxClusterLights, (unsigned int)count);
+
+		// Reused below as the number written so far
+		clusterCounts[i] = 0;
+	}
+
+	lightIndices.resize(offset);
+	for (size_t i = 0; i < lightClusterPairs.size(); i++)
+	{
+		uint32_t cluster = lightClusterPairs[i] >> 16;
+		if (clusterCounts[cluster] < clusterRanges[cluster].count)
+		{
+			lightIndices[clusterRanges[cluster].offset + clusterCounts[cluster]++] = (GLushort)(lightClusterPairs[i] & 0xFFFF);
+		}
+	}
+
+	// Orphan and refill, last frame's lists may still be in use
+	glBindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(LightData) * glm::max(lightData.size(), (size_t)1), NULL, GL_STREAM_DRAW);
+	if (!lightData.empty())
+	{
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(LightData) * lightData.size(), &lightData[0]);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, clusterBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(ClusterRange) * clusterRanges.size(), &clusterRanges[0], GL_STREAM_DRAW);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(GLushort) * glm::max(lightIndices.size(), (size_t)1), NULL, GL_STREAM_DRAW);
+	if (!lightIndices.empty())
+	{
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeof(GLushort) * lightIndices.size(), &lightIndices[0]);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::Bind(GLStateCache& stateCache)
+{
+	if (UBO == 0)
+	{
+		return;
+	}
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, UBO);
+	stateCache.BindTexture(LIGHT_DATA_UNIT, GL_TEXTURE_BUFFER, lightTexture);
+	stateCache.BindTexture(CLUSTER_UNIT, GL_TEXTURE_BUFFER, clusterTexture);
+	stateCache.BindTexture(LIGHT_INDEX_UNIT, GL_TEXTURE_BUFFER, indexTexture);
+}
+
+void LightClusters::Clear()
+{
+	GLuint textures[] = { lightTexture, clusterTexture, indexTexture };
+	GLuint buffers[] = { UBO, lightBuffer, clusterBuffer, indexBuffer };
+	for (size_t i = 0; i < 3; i++)
+	{
+		if (textures[i] != 0)
+		{
+			glDeleteTextures(1, &textures[i]);
+		}
+	}
+	for (size_t i = 0; i < 4; i++)
+	{
+		if (buffers[i] != 0)
+		{
+			glDeleteBuffers(1, &buffers[i]);
+		}
+	}
+
+	UBO = 0;
+	lightBuffer = 0;
+	clusterBuffer = 0;
+	indexBuffer = 0;
+	lightTexture = 0;
+	clusterTexture = 0;
+	indexTexture = 0;
+	projectionParams = glm::vec4(0.0f);
+	gridWidth = 0;
+	gridHeight = 0;
+
+	clusterMin.clear();
+	clusterMax.clear();
+	lightData.clear();
+	lightClusterPairs.clear();
+	clusterCounts.clear();
+	clusterRanges.clear();
+	lightIndices.clear();
+	visibleLightCount = 0;
+	maxClusterLights = 0;
+}
+
+LightClusters::~LightClusters()
+{
+	Clear();
+}
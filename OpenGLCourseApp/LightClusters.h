@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+
+#include "GLStateCache.h"
+#include "Light.h"
+
+// Clustered forward shading for point lights. The view frustum is cut into a grid of screen tiles
+// and exponential depth slices, each light is assigned on the CPU to the clusters its range touches,
+// and the fragment shader only loops over the lights of the cluster it falls in.
+// Lists go to the GPU as buffer textures so a GL 3.3 context can read them, there are no SSBOs before 4.3.
+class LightClusters
+{
+public:
+	static const unsigned int GRID_X = 16;
+	static const unsigned int GRID_Y = 9;
+	static const unsigned int GRID_Z = 24;
+	static const unsigned int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+	static const unsigned int MAX_LIGHTS = 256;
+	// GL 3.3 only promises 65536 texels in a buffer texture
+	static const unsigned int MAX_LIGHT_INDICES = 65536;
+
+	static const GLuint BINDING = 1;
+	// After theTexture and TextureArray::TEXTURE_UNIT
+	static const GLuint LIGHT_DATA_UNIT = 2;
+	static const GLuint CLUSTER_UNIT = 3;
+	static const GLuint LIGHT_INDEX_UNIT = 4;
+
+	LightClusters();
+
+	void Create();
+	// Assigns the lights to clusters and uploads the light data and per-cluster lists
+	void Update(const glm::mat4& projection, const glm::mat4& view, GLsizei viewportWidth, GLsizei viewportHeight, std::vector<PointLight>& lights);
+	// Binds the buffer textures and the ClusterData block for the scene shaders
+	void Bind(GLStateCache& stateCache);
+	void Clear();
+
+	unsigned int GetLightCount() { return visibleLightCount; }
+	unsigned int GetIndexCount() { return (unsigned int)lightIndices.size(); }
+	unsigned int GetMaxClusterLights() { return maxClusterLights; }
+
+	~LightClusters();
+
+private:
+	// Must match the ClusterData block in shader.frag
+	struct ClusterData
+	{
+		glm::vec4 clusterScale; // clusters per pixel in x and y, depth slice scale and bias
+		glm::vec4 clusterGrid; // cluster counts in x, y and z
+	};
+
+	// Three RGBA32F texels per light
+	struct LightData
+	{
+		glm::vec4 positionRange;
+		glm::vec4 colourSpecular; // colour times diffuse intensity, specular intensity
+		glm::vec4 attenuation; // constant, linear, exponent
+	};
+
+	struct ClusterRange
+	{
+		GLuint offset;
+		GLuint count;
+	};
+
+	GLuint UBO;
+	GLuint lightBuffer, clusterBuffer, indexBuffer;
+	GLuint lightTexture, clusterTexture, indexTexture;
+
+	// View space bounds of every cluster, x and y as in view space, z as positive depth.
+	// Rebuilt only when the projection or viewport changes
+	std::vector<glm::vec3> clusterMin, clusterMax;
+	glm::vec4 projectionParams; // x scale, y scale, near, far
+	GLsizei gridWidth, gridHeight;
+
+	std::vector<LightData> lightData;
+	// cluster << 16 | light for every cluster a light touches
+	std::vector<uint32_t> lightClusterPairs;
+	std::vector<GLuint> clusterCounts;
+	std::vector<ClusterRange> clusterRanges;
+	std::vector<GLushort> lightIndices;
+	unsigned int visibleLightCount;
+	unsigned int maxClusterLights;
+
+	void BuildClusters(const glm::vec4& params, GLsizei viewportWidth, GLsizei viewportHeight);
+	static GLuint CreateBufferTexture(GLuint buffer, GLenum internalFormat);
+};
@@ -0,0 +1,61 @@
+#include "LodSelector.h"
+
+#include <float.h>
+
+const float LodSelector::MAX_PIXEL_ERROR = 1.0f;
+const float LodSelector::HYSTERESIS = 0.25f;
+
+LodSelector::LodSelector()
+{
+	cameraPosition = glm::vec3(0.0f);
+	pixelsPerUnit = 0.0f;
+}
+
+void LodSelector::Update(const glm::mat4& projection, const glm::vec3& cameraPosition, GLint viewportHeight)
+{
+	this->cameraPosition = cameraPosition;
+	// projection[1][1] is cot(fovy / 2), half the viewport covers one unit of it
+	pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+}
+
+float LodSelector::GetScreenRadius(Mesh* mesh, const glm::mat4& model) const
+{
+	glm::vec3 center = glm::vec3(model * glm::vec4((mesh->GetBoundsMin() + mesh->GetBoundsMax()) * 0.5f, 1.0f));
+	float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	float radius = glm::length(mesh->GetBoundsMax() - mesh->GetBoundsMin()) * 0.5f * scale;
+
+	// Inside the sphere it covers the whole screen
+	float distance = glm::length(center - cameraPosition);
+	if (distance <= radius)
+	{
+		return FLT_MAX;
+	}
+
+	return radius * pixelsPerUnit / distance;
+}
+
+unsigned int LodSelector::Select(Mesh* mesh, const glm::mat4& model, unsigned int currentLod) const
+{
+	unsigned int lodCount = mesh->GetLodCount();
+	if (lodCount <= 1)
+	{
+		return 0;
+	}
+
+	// Coarsest level first. Staying or refining is allowed up to the full budget, coarsening only with the margin
+	float screenRadius = GetScreenRadius(mesh, model);
+	for (unsigned int i = lodCount - 1; i > 0; i--)
+	{
+		float limit = i > currentLod ? MAX_PIXEL_ERROR * (1.0f - HYSTERESIS) : MAX_PIXEL_ERROR;
+		if (mesh->GetLod(i).error * screenRadius <= limit)
+		{
+			return i;
+		}
+	}
+
+	return 0;
+}
+
+LodSelector::~LodSelector()
+{
+}
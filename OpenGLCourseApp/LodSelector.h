@@ -0,0 +1,35 @@
+#pragma once
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+
+#include "Mesh.h"
+
+// Picks a mesh's level of detail from how large its bounding sphere is on screen. Each level's
+// error is relative to that sphere, so the projected radius turns it straight into pixels.
+class LodSelector
+{
+public:
+	// Largest simplification error allowed on screen, in pixels
+	static const float MAX_PIXEL_ERROR;
+	// A coarser level has to stay this far under MAX_PIXEL_ERROR before it is picked, so an
+	// object sitting on a threshold doesn't pop between two levels every frame
+	static const float HYSTERESIS;
+
+	LodSelector();
+
+	void Update(const glm::mat4& projection, const glm::vec3& cameraPosition, GLint viewportHeight);
+
+	// Radius in pixels of mesh's bounding sphere placed with model
+	float GetScreenRadius(Mesh* mesh, const glm::mat4& model) const;
+	// currentLod is the level the object was drawn with last frame
+	unsigned int Select(Mesh* mesh, const glm::mat4& model, unsigned int currentLod) const;
+
+	~LodSelector();
+
+private:
+	glm::vec3 cameraPosition;
+	// Projected size of one unit at distance one
+	float pixelsPerUnit;
+};
@@ -0,0 +1,191 @@
+#include "Lz4.h"
+
+#include <string.h>
+#include <stdint.h>
+
+static uint32_t Read32(const unsigned char* data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+size_t Lz4::GetMaxCompressedSize(size_t sourceSize)
+{
+	return sourceSize + sourceSize / 255 + 16;
+}
+
+unsigned char* Lz4::WriteLength(unsigned char* output, size_t length)
+{
+	// Lengths that don't fit a token nibble continue in bytes of 255
+	while (length >= 255)
+	{
+		*output++ = 255;
+		length -= 255;
+	}
+	*output++ = (unsigned char)length;
+	return output;
+}
+
+unsigned char* Lz4::WriteSequence(unsigned char* output, const unsigned char* literals, size_t literalLength,
+	size_t offset, size_t matchLength)
+{
+	unsigned char* token = output++;
+	*token = (unsigned char)((literalLength < 15 ? literalLength : 15) << 4);
+	if (literalLength >= 15)
+	{
+		output = WriteLength(output, literalLength - 15);
+	}
+	memcpy(output, literals, literalLength);
+	output += literalLength;
+
+	// The last sequence of a block is literals only
+	if (matchLength == 0)
+	{
+		return output;
+	}
+
+	*output++ = (unsigned char)(offset & 0xFF);
+	*output++ = (unsigned char)(offset >> 8);
+
+	size_t extra = matchLength - MIN_MATCH;
+	*token |= (unsigned char)(extra < 15 ? extra : 15);
+	if (extra >= 15)
+	{
+		output = WriteLength(output, extra - 15);
+	}
+	return output;
+}
+
+size_t Lz4::Compress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t destinationCapacity)
+{
+	if (destinationCapacity < GetMaxCompressedSize(sourceSize))
+	{
+		return 0;
+	}
+
+	// Last position each 4 byte sequence was seen at, plus one so zero means never
+	size_t table[1 << HASH_BITS];
+	memset(table, 0, sizeof(table));
+
+	unsigned char* output = destination;
+	size_t anchor = 0;
+	size_t position = 0;
+
+	if (sourceSize > MATCH_SAFE_DISTANCE)
+	{
+		size_t matchStartLimit = sourceSize - MATCH_SAFE_DISTANCE;
+		size_t matchEndLimit = sourceSize - LAST_LITERALS;
+
+		while (position < matchStartLimit)
+		{
+			uint32_t sequence = Read32(source + position);
+			uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+			size_t candidate = table[hash];
+			table[hash] = position + 1;
+
+			if (candidate == 0 || position - (candidate - 1) > MAX_OFFSET || Read32(source + candidate - 1) != sequence)
+			{
+				position++;
+				continue;
+			}
+			candidate--;
+
+			size_t matchLength = MIN_MATCH;
+			while (position + matchLength < matchEndLimit && source[candidate + matchLength] == source[position + matchLength])
+			{
+				matchLength++;
+			}
+
+			output = WriteSequence(output, source + anchor, position - anchor, position - candidate, matchLength);
+			position += matchLength;
+			anchor = position;
+		}
+	}
+
+	output = WriteSequence(output, source + anchor, sourceSize - anchor, 0, 0);
+	return (size_t)(output - destination);
+}
+
+bool Lz4::Decompress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t destinationSize)
+{
+	const unsigned char* input = source;
+	const unsigned char* inputEnd = source + sourceSize;
+	unsigned char* output = destination;
+	unsigned char* outputEnd = destination + destinationSize;
+
+	while (input < inputEnd)
+	{
+		unsigned char token = *input++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15)
+		{
+			unsigned char extra;
+			do
+			{
+				if (input >= inputEnd)
+				{
+					return false;
+				}
+				extra = *input++;
+				literalLength += extra;
+			} while (extra == 255);
+		}
+
+		if (literalLength > (size_t)(inputEnd - input) || literalLength > (size_t)(outputEnd - output))
+		{
+			return false;
+		}
+		memcpy(output, input, literalLength);
+		input += literalLength;
+		output += literalLength;
+
+		if (input == inputEnd)
+		{
+			break;
+		}
+
+		if (inputEnd - input < 2)
+		{
+			return false;
+		}
+		size_t offset = input[0] | (input[1] << 8);
+		input += 2;
+		if (offset == 0 || offset > (size_t)(output - destination))
+		{
+			return false;
+		}
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15)
+		{
+			unsigned char extra;
+			do
+			{
+				if (input >= inputEnd)
+				{
+					return false;
+				}
+				extra = *input++;
+				matchLength += extra;
+			} while (extra == 255);
+		}
+		matchLength += MIN_MATCH;
+
+		if (matchLength > (size_t)(outputEnd - output))
+		{
+			return false;
+		}
+
+		// Matches may overlap their own output, so copy forwards a byte at a time
+		const unsigned char* match = output - offset;
+		for (size_t i = 0; i < matchLength; i++)
+		{
+			output[i] = match[i];
+		}
+		output += matchLength;
+	}
+
+	return output == outputEnd;
+}
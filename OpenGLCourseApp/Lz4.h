@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+
+// Encoder and decoder for the LZ4 block format, as used by the chunks of an AssetPack.
+// The encoder is a single pass greedy matcher, fast rather than tight. The decoder checks
+// every length and offset against both buffers, so a damaged block fails instead of overrunning.
+class Lz4
+{
+public:
+	// Largest block Compress can produce from sourceSize bytes
+	static size_t GetMaxCompressedSize(size_t sourceSize);
+
+	// Returns the compressed size, or 0 when destination is too small
+	static size_t Compress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t destinationCapacity);
+	// Returns false unless the block decodes to exactly destinationSize bytes
+	static bool Decompress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t destinationSize);
+
+private:
+	static const unsigned int HASH_BITS = 12;
+	static const size_t MIN_MATCH = 4;
+	static const size_t MAX_OFFSET = 65535;
+	// The format requires the last match to start this far from the end of the block
+	static const size_t MATCH_SAFE_DISTANCE = 12;
+	// and the last bytes to be literals
+	static const size_t LAST_LITERALS = 5;
+
+	static unsigned char* WriteLength(unsigned char* output, size_t length);
+	static unsigned char* WriteSequence(unsigned char* output, const unsigned char* literals, size_t literalLength,
+		size_t offset, size_t matchLength);
+};
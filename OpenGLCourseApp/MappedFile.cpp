@@ -0,0 +1,166 @@
+#include "MappedFile.h"
+
+#include "AssetPack.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	data = NULL;
+	size = 0;
+	borrowed = false;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#else
+	fileDescriptor = -1;
+#endif
+}
+
+bool MappedFile::Open(const std::string& fileLocation)
+{
+	Close();
+
+	AssetPack* pack = AssetPack::GetMounted();
+	if (pack != NULL && pack->GetStoredData(fileLocation, data, size) && size > 0)
+	{
+		borrowed = true;
+		return true;
+	}
+	data = NULL;
+	size = 0;
+
+	return OpenOnDisk(fileLocation);
+}
+
+bool MappedFile::OpenOnDisk(const std::string& fileLocation)
+{
+	Close();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(fileLocation.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data == NULL)
+	{
+		Close();
+		return false;
+	}
+#else
+	fileDescriptor = open(fileLocation.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	size = (size_t)fileStat.st_size;
+
+	void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (mapping == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	data = (const unsigned char*)mapping;
+#endif
+
+	return true;
+}
+
+void MappedFile::Prefetch()
+{
+	if (data == NULL || borrowed)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = (PVOID)data;
+	range.NumberOfBytes = size;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+	madvise((void*)data, size, MADV_SEQUENTIAL);
+	madvise((void*)data, size, MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::Close()
+{
+	if (borrowed)
+	{
+		data = NULL;
+		size = 0;
+		borrowed = false;
+		return;
+	}
+
+#ifdef _WIN32
+	if (data != NULL)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle != NULL)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = NULL;
+	}
+	if (fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (data != NULL)
+	{
+		munmap((void*)data, size);
+	}
+	if (fileDescriptor >= 0)
+	{
+		close(fileDescriptor);
+		fileDescriptor = -1;
+	}
+#endif
+
+	data = NULL;
+	size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
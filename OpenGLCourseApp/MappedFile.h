@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+// Read-only memory mapping of a whole file. Files stored uncompressed in the mounted AssetPack
+// are served from the pack's mapping instead of being mapped on their own.
+class MappedFile
+{
+public:
+	MappedFile();
+
+	bool Open(const std::string& fileLocation);
+	// Skips the mounted AssetPack
+	bool OpenOnDisk(const std::string& fileLocation);
+	void Close();
+
+	// Asks the OS to start reading the whole mapping in, front to back
+	void Prefetch();
+
+	bool IsOpen() { return data != NULL; }
+	const unsigned char* GetData() { return data; }
+	size_t GetSize() { return size; }
+
+	~MappedFile();
+
+private:
+	const unsigned char* data;
+	size_t size;
+	// Points into the mounted AssetPack, nothing to unmap
+	bool borrowed;
+
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+
+	// The mapping is owned, copying would unmap it twice
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
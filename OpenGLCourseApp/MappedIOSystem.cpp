@@ -0,0 +1,104 @@
+#include "MappedIOSystem.h"
+
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+MappedIOSystem::MappedIOSystem()
+{
+	mappedBytes = 0;
+}
+
+bool MappedIOSystem::Exists(const char* pFile) const
+{
+	AssetPack* pack = AssetPack::GetMounted();
+	if (files.find(pFile) != files.end() || (pack != NULL && pack->Contains(pFile)))
+	{
+		return true;
+	}
+
+	struct stat fileStat;
+	return stat(pFile, &fileStat) == 0;
+}
+
+char MappedIOSystem::getOsSeparator() const
+{
+	// Accepted by every platform we build on
+	return '/';
+}
+
+Assimp::IOStream* MappedIOSystem::Open(const char* pFile, const char* pMode)
+{
+	// Importers only ever read
+	if (strchr(pMode, 'w') != NULL || strchr(pMode, 'a') != NULL || strchr(pMode, '+') != NULL)
+	{
+		return NULL;
+	}
+
+	// Stored pack files come back from MappedFile as a view of the pack, compressed ones are unpacked here
+	AssetPack* pack = AssetPack::GetMounted();
+	const unsigned char* storedData;
+	size_t storedSize;
+	if (pack != NULL && pack->Contains(pFile) && !pack->GetStoredData(pFile, storedData, storedSize))
+	{
+		std::map<std::string, std::vector<unsigned char> >::iterator unpacked = unpackedFiles.find(pFile);
+		if (unpacked == unpackedFiles.end())
+		{
+			std::vector<unsigned char> contents;
+			if (!pack->Read(pFile, contents))
+			{
+				return NULL;
+			}
+			mappedBytes += contents.size();
+			unpacked = unpackedFiles.insert(std::make_pair(std::string(pFile), std::vector<unsigned char>())).first;
+			unpacked->second.swap(contents);
+		}
+
+		std::vector<unsigned char>& contents = unpacked->second;
+		return new Assimp::MemoryIOStream(contents.empty() ? NULL : &contents[0], contents.size());
+	}
+
+	std::map<std::string, MappedFile*>::iterator it = files.find(pFile);
+	if (it == files.end())
+	{
+		MappedFile* file = new MappedFile();
+		if (!file->Open(pFile))
+		{
+			delete file;
+
+			// Empty files can't be mapped, but an empty .mtl is still a valid one
+			if (!Exists(pFile))
+			{
+				return NULL;
+			}
+			return new Assimp::MemoryIOStream(NULL, 0);
+		}
+
+		mappedBytes += file->GetSize();
+		it = files.insert(std::make_pair(std::string(pFile), file)).first;
+	}
+
+	// The stream doesn't own the mapping, ReleaseFiles does
+	return new Assimp::MemoryIOStream(it->second->GetData(), it->second->GetSize());
+}
+
+void MappedIOSystem::Close(Assimp::IOStream* pFile)
+{
+	delete pFile;
+}
+
+void MappedIOSystem::ReleaseFiles()
+{
+	for (std::map<std::string, MappedFile*>::iterator it = files.begin(); it != files.end(); ++it)
+	{
+		delete it->second;
+	}
+	files.clear();
+	unpackedFiles.clear();
+	mappedBytes = 0;
+}
+
+MappedIOSystem::~MappedIOSystem()
+{
+	ReleaseFiles();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <assimp/IOSystem.hpp>
+#include <assimp/MemoryIOWrapper.h>
+
+#include "AssetPack.h"
+#include "MappedFile.h"
+
+// Assimp file access through read-only memory mappings instead of its stdio based DefaultIOSystem.
+// Every file an import opens, the model and the .mtl files it names, is mapped once and served to
+// Assimp as a MemoryIOStream over the mapping, so repeated opens of the same file share it.
+// Files compressed in the mounted AssetPack are decompressed once per import instead.
+// Mappings are kept until ReleaseFiles, call it once the import's scene is done with.
+class MappedIOSystem : public Assimp::IOSystem
+{
+public:
+	MappedIOSystem();
+
+	bool Exists(const char* pFile) const override;
+	char getOsSeparator() const override;
+	Assimp::IOStream* Open(const char* pFile, const char* pMode = "rb") override;
+	void Close(Assimp::IOStream* pFile) override;
+
+	void ReleaseFiles();
+	size_t GetMappedBytes() { return mappedBytes; }
+
+	~MappedIOSystem();
+
+private:
+	std::map<std::string, MappedFile*> files;
+	std::map<std::string, std::vector<unsigned char> > unpackedFiles;
+	size_t mappedBytes;
+};
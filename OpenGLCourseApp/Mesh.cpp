@@ -1,35 +1,169 @@
 
 #include "Mesh.h"
 
+#include <stddef.h>
+#include <stdio.h>
+
+#include <glm\gtc\matrix_inverse.hpp>
+
+InstanceTransform InstanceTransform::Make(const glm::mat4& model)
+{
+	return Make(model, 0);
+}
+
+InstanceTransform InstanceTransform::Make(const glm::mat4& model, GLint layer)
+{
+	InstanceTransform instance;
+	instance.model = model;
+
+	glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(model));
+	for (int i = 0; i < 3; i++)
+	{
+		instance.normalMatrix[i] = glm::vec4(normalMatrix[i], 0.0f);
+	}
+	instance.normalMatrix[0].w = (float)layer;
+
+	return instance;
+}
+
+void InstanceTransform::SetAttributes(GLsizei firstInstance)
+{
+	size_t offset = sizeof(InstanceTransform) * firstInstance;
+
+	// A mat4 attribute takes four consecutive locations, one vec4 column each, the mat3 takes three
+	for (GLuint i = 0; i < 4; i++)
+	{
+		glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform), (void*)(offset + sizeof(glm::vec4) * i));
+	}
+	for (GLuint i = 0; i < 3; i++)
+	{
+		glVertexAttribPointer(7 + i, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+			(void*)(offset + offsetof(InstanceTransform, normalMatrix) + sizeof(glm::vec4) * i));
+	}
+	glVertexAttribPointer(10, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+		(void*)(offset + offsetof(InstanceTransform, normalMatrix) + sizeof(glm::vec3)));
+}
+
+void InstanceTransform::EnableAttributes()
+{
+	for (GLuint i = FIRST_ATTRIBUTE; i < FIRST_ATTRIBUTE + ATTRIBUTE_COUNT; i++)
+	{
+		glEnableVertexAttribArray(i);
+		glVertexAttribDivisor(i, 1);
+	}
+}
+
 Mesh::Mesh()
 {
 	VAO = 0;
 	VBO = 0;
 	IBO = 0;
+	instanceVBO = 0;
 	indexCount = 0;
+	indexType = GL_UNSIGNED_INT;
+	vertexCount = 0;
+	instanceCapacity = 0;
+	boundsMin = glm::vec3(0.0f);
+	boundsMax = glm::vec3(0.0f);
+	format = VertexFormat::FLOAT32;
+	dequantize = glm::mat4(1.0f);
+	hasNormals = false;
+
+	MeshLod full = { 0, 0, 0.0f };
+	lods.push_back(full);
 }
 
-void Mesh::CreateMesh(GLfloat *vertices, unsigned int *indices, unsigned int numOfVertices, unsigned int numOfIndices)
+// Creates the bound buffer's storage and has fill write its contents straight into a mapping of it,
+// converted data then needs no staging copy on the heap. Falls back to one when mapping fails
+template<typename Fill>
+static void FillBuffer(GLenum target, GLsizeiptr size, Fill fill)
+{
+	glBufferData(target, size, NULL, GL_STATIC_DRAW);
+	if (size == 0)
+	{
+		return;
+	}
+
+	void* mapped = glMapBufferRange(target, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped)
+	{
+		fill((unsigned char*)mapped);
+		// GL_FALSE means the contents were lost while mapped and have to be written again
+		if (glUnmapBuffer(target) == GL_TRUE)
+		{
+			return;
+		}
+	}
+
+	std::vector<unsigned char> staging((size_t)size);
+	fill(&staging[0]);
+	glBufferSubData(target, 0, size, &staging[0]);
+}
+
+void Mesh::CreateMesh(const GLfloat *vertices, const unsigned int *indices, unsigned int numOfVertices, unsigned int numOfIndices)
+{
+	CreateMesh(vertices, indices, numOfVertices, numOfIndices, VertexFormat::FLOAT32);
+}
+
+void Mesh::CreateMesh(const GLfloat* vertices, const unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices, VertexFormat::Type format)
 {
 	indexCount = numOfIndices;
+	vertexCount = numOfVertices / 8;
+	this->format = format;
+	dequantize = glm::mat4(1.0f);
+
+	MeshLod full = { 0, numOfIndices, 0.0f };
+	lods.assign(1, full);
+
+	boundsMin = glm::vec3(0.0f);
+	boundsMax = glm::vec3(0.0f);
+	hasNormals = false;
+	for (GLsizei i = 0; i < vertexCount; i++)
+	{
+		glm::vec3 position(vertices[i * 8], vertices[i * 8 + 1], vertices[i * 8 + 2]);
+		boundsMin = i == 0 ? position : glm::min(boundsMin, position);
+		boundsMax = i == 0 ? position : glm::max(boundsMax, position);
+		hasNormals = hasNormals || vertices[i * 8 + 5] != 0.0f || vertices[i * 8 + 6] != 0.0f || vertices[i * 8 + 7] != 0.0f;
+	}
 
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
 
 	glGenBuffers(1, &IBO);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * numOfIndices, indices, GL_STATIC_DRAW);
+	// Half the index bandwidth whenever every vertex is reachable with 16 bits
+	if (vertexCount <= 65536)
+	{
+		indexType = GL_UNSIGNED_SHORT;
+		FillBuffer(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort) * numOfIndices, [indices, numOfIndices](unsigned char* output) {
+			GLushort* shortIndices = (GLushort*)output;
+			for (unsigned int i = 0; i < numOfIndices; i++)
+			{
+				shortIndices[i] = (GLushort)indices[i];
+			}
+		});
+	}
+	else
+	{
+		// Already in their final form, the driver's copy is the only one
+		indexType = GL_UNSIGNED_INT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * numOfIndices, indices, GL_STATIC_DRAW);
+	}
 
 	glGenBuffers(1, &VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * numOfVertices, vertices, GL_STATIC_DRAW);
+	if (format == VertexFormat::QUANTIZED)
+	{
+		FillBuffer(GL_ARRAY_BUFFER, VertexFormat::GetStride(format) * vertexCount, [&](unsigned char* output) {
+			VertexFormat::Quantize(vertices, vertexCount, boundsMin, boundsMax, output, dequantize);
+		});
+	}
+	else
+	{
+		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * numOfVertices, vertices, GL_STATIC_DRAW);
+	}
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, 0);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, (void*)(sizeof(vertices[0]) * 3));
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]) * 8, (void*)(sizeof(vertices[0]) * 5));
-	glEnableVertexAttribArray(2);
+	VertexFormat::SetAttributes(format);
 
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -39,15 +173,152 @@ void Mesh::CreateMesh(GLfloat *vertices, unsigned int *indices, unsigned int num
 
 void Mesh::RenderMesh()
 {
+	// The VAO captured the IBO binding in CreateMesh, no need to rebind it here
 	glBindVertexArray(VAO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	Draw();
+	glBindVertexArray(0);
+}
+
+void Mesh::SetLods(const MeshLod* lods, unsigned int count)
+{
+	if (count == 0 || count > MeshLod::MAX_LODS)
+	{
+		printf("Mesh has %u levels of detail, keeping the full mesh only\n", count);
+		return;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (lods[i].indexCount == 0 || lods[i].indexCount % 3 != 0 || (GLsizei)(lods[i].firstIndex + lods[i].indexCount) > indexCount)
+		{
+			printf("Mesh level of detail %u is outside the index buffer, keeping the full mesh only\n", i);
+			return;
+		}
+	}
+
+	this->lods.assign(lods, lods + count);
+}
+
+void Mesh::Draw()
+{
+	Draw(0);
+}
+
+void Mesh::Draw(unsigned int lod)
+{
+	const MeshLod& level = GetLod(lod);
+	glDrawElements(GL_TRIANGLES, level.indexCount, indexType, (void*)((size_t)GetIndexSize() * level.firstIndex));
+}
+
+void Mesh::DrawInstanced(GLsizei count)
+{
+	DrawInstanced(count, 0, 0);
+}
+
+void Mesh::DrawInstanced(GLsizei count, unsigned int lod, GLsizei firstInstance)
+{
+	if (count <= 0 || firstInstance < 0 || firstInstance + count > instanceCapacity)
+	{
+		return;
+	}
+
+	// No baseInstance before GL 4.2, point the instance attributes at the first matrix instead
+	if (firstInstance > 0)
+	{
+		SetInstanceOffset(firstInstance);
+	}
+
+	const MeshLod& level = GetLod(lod);
+	glDrawElementsInstanced(GL_TRIANGLES, level.indexCount, indexType, (void*)((size_t)GetIndexSize() * level.firstIndex), count);
+
+	if (firstInstance > 0)
+	{
+		SetInstanceOffset(0);
+	}
+}
+
+void Mesh::SetInstanceOffset(GLsizei firstInstance)
+{
+	// Expects this mesh's VAO bound, the pointers are recorded in it
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	InstanceTransform::SetAttributes(firstInstance);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Mesh::CreateInstanceBuffer(GLsizei capacity)
+{
+	glBindVertexArray(VAO);
+
+	if (instanceVBO == 0)
+	{
+		glGenBuffers(1, &instanceVBO);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceTransform) * capacity, NULL, GL_STREAM_DRAW);
+
+	SetInstanceOffset(0);
+	InstanceTransform::EnableAttributes();
+
+	glBindVertexArray(0);
+
+	instanceCapacity = capacity;
+}
+
+void Mesh::SetInstanceTransforms(const InstanceTransform* instances, GLsizei count)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+
+	if (count > instanceCapacity)
+	{
+		// Grow geometrically so a slowly growing crowd doesn't reallocate every frame
+		GLsizei capacity = instanceCapacity > 0 ? instanceCapacity : 16;
+		while (capacity < count)
+		{
+			capacity *= 2;
+		}
+		CreateInstanceBuffer(capacity);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	// Orphan the previous contents so we don't wait on draws still reading them
+	glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceTransform) * instanceCapacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(InstanceTransform) * count, instances);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Mesh::RenderMeshInstanced(GLsizei count)
+{
+	glBindVertexArray(VAO);
+	DrawInstanced(count);
 	glBindVertexArray(0);
 }
 
 void Mesh::ClearMesh()
 {
+	ReleaseBuffers();
+
+	indexCount = 0;
+	indexType = GL_UNSIGNED_INT;
+	vertexCount = 0;
+	format = VertexFormat::FLOAT32;
+	dequantize = glm::mat4(1.0f);
+	hasNormals = false;
+
+	MeshLod full = { 0, 0, 0.0f };
+	lods.assign(1, full);
+}
+
+void Mesh::ReleaseBuffers()
+{
+	if (instanceVBO != 0)
+	{
+		glDeleteBuffers(1, &instanceVBO);
+		instanceVBO = 0;
+	}
+
 	if (IBO != 0)
 	{
 		glDeleteBuffers(1, &IBO);
@@ -66,7 +337,7 @@ void Mesh::ClearMesh()
 		VAO = 0;
 	}
 
-	indexCount = 0;
+	instanceCapacity = 0;
 }
 
 
@@ -2,19 +2,99 @@
 
 #include <GL\glew.h>
 
+#include <vector>
+
+#include <glm\glm.hpp>
+
+#include "MeshData.h"
+#include "VertexFormat.h"
+
+// Per-instance data read by the instanced shader variants: the model matrix at attributes 3-6
+// and its normal matrix at 7-9, worked out once per instance on the CPU instead of per vertex.
+// The spare w of the first normal matrix column is the TextureArray layer, attribute 10
+struct InstanceTransform
+{
+	glm::mat4 model;
+	glm::vec4 normalMatrix[3];
+
+	static const GLuint FIRST_ATTRIBUTE = 3;
+	static const GLuint ATTRIBUTE_COUNT = 8;
+
+	static InstanceTransform Make(const glm::mat4& model);
+	static InstanceTransform Make(const glm::mat4& model, GLint layer);
+	// Pointers for attributes 3-10 into the buffer bound to GL_ARRAY_BUFFER, starting at firstInstance
+	static void SetAttributes(GLsizei firstInstance);
+	// Enables attributes 3-10 with a divisor of 1 on the bound VAO
+	static void EnableAttributes();
+};
+
 class Mesh
 {
 public:
 	Mesh();
 
-	void CreateMesh(GLfloat* vertices, unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices);
+	void CreateMesh(const GLfloat* vertices, const unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices);
+	// vertices are always in the FLOAT32 layout, they are converted to format before the upload
+	void CreateMesh(const GLfloat* vertices, const unsigned int* indices, unsigned int numOfVertices, unsigned int numOfIndices, VertexFormat::Type format);
 	void RenderMesh();
 	void ClearMesh();
+	// Frees the GL objects but keeps the counts, levels and bounds, for meshes only drawn from
+	// a StaticGeometry arena that already holds a copy. The mesh can't be drawn on its own after this
+	void ReleaseBuffers();
+
+	// Draw with this mesh's VAO already bound, see GLStateCache
+	void Draw();
+	void Draw(unsigned int lod);
+	void DrawInstanced(GLsizei count);
+	// Draws count instances starting at firstInstance in the instance buffer
+	void DrawInstanced(GLsizei count, unsigned int lod, GLsizei firstInstance);
+	GLuint GetVAO() { return VAO; }
+
+	// Raw buffers, used by StaticGeometry to copy the mesh into its shared arena
+	GLuint GetVBO() { return VBO; }
+	GLuint GetIBO() { return IBO; }
+	GLsizei GetVertexCount() { return vertexCount; }
+	// Every level of detail, the levels are ranges of the one index buffer
+	GLsizei GetIndexCount() { return indexCount; }
+	// GL_UNSIGNED_SHORT when the mesh has at most 65536 vertices, GL_UNSIGNED_INT otherwise
+	GLenum GetIndexType() { return indexType; }
+	GLsizei GetIndexSize() { return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint); }
+
+	// Level 0 covers all indices until SetLods replaces it with the chain cooked by MeshSimplifier
+	void SetLods(const MeshLod* lods, unsigned int count);
+	unsigned int GetLodCount() { return (unsigned int)lods.size(); }
+	const MeshLod& GetLod(unsigned int lod) { return lods[lod < lods.size() ? lod : lods.size() - 1]; }
+
+	// Object space bounding box, computed from the positions in CreateMesh
+	const glm::vec3& GetBoundsMin() { return boundsMin; }
+	const glm::vec3& GetBoundsMax() { return boundsMax; }
+
+	// Quantized positions are stored relative to the bounds, every model matrix used
+	// with this mesh has to be multiplied by the dequantize transform first
+	VertexFormat::Type GetVertexFormat() { return format; }
+	bool IsQuantized() { return format == VertexFormat::QUANTIZED; }
+	const glm::mat4& GetDequantizeTransform() { return dequantize; }
+
+	// False when every normal is zero, such meshes use the shader variants without lighting
+	bool HasNormals() { return hasNormals; }
+
+	void SetInstanceTransforms(const InstanceTransform* instances, GLsizei count);
+	void RenderMeshInstanced(GLsizei count);
 
 	~Mesh();
 
 private:
-	GLuint VAO, VBO, IBO;
+	GLuint VAO, VBO, IBO, instanceVBO;
 	GLsizei indexCount;
-};
+	GLenum indexType;
+	GLsizei vertexCount;
+	GLsizei instanceCapacity;
+	glm::vec3 boundsMin, boundsMax;
+	VertexFormat::Type format;
+	glm::mat4 dequantize;
+	std::vector<MeshLod> lods;
+	bool hasNormals;
 
+	void CreateInstanceBuffer(GLsizei capacity);
+	void SetInstanceOffset(GLsizei firstInstance);
+};
@@ -0,0 +1,241 @@
+#include "MeshCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+
+#include "AssetPack.h"
+
+static const char TMESH_MAGIC[4] = { 'T', 'M', 'S', 'H' };
+static const uint32_t FLOATS_PER_VERTEX = 8;
+
+MeshCache::MeshCache()
+{
+	entries = NULL;
+	meshCount = 0;
+}
+
+bool MeshCache::Open(const std::string& cacheLocation, uint64_t sourceHash)
+{
+	Close();
+
+	if (!file.Open(cacheLocation))
+	{
+		return false;
+	}
+
+	const unsigned char* data = file.GetData();
+	size_t size = file.GetSize();
+
+	if (size < sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+
+	const Header* header = (const Header*)data;
+	// A zero hash means the source isn't around to check against, trust the cooked file
+	if (memcmp(header->magic, TMESH_MAGIC, 4) != 0 || header->version != VERSION ||
+		header->floatsPerVertex != FLOATS_PER_VERTEX || (sourceHash != 0 && header->sourceHash != sourceHash))
+	{
+		Close();
+		return false;
+	}
+
+	if (sizeof(Header) + sizeof(Entry) * (size_t)header->meshCount > size)
+	{
+		Close();
+		return false;
+	}
+
+	entries = (const Entry*)(data + sizeof(Header));
+	for (uint32_t i = 0; i < header->meshCount; i++)
+	{
+		uint64_t vertexEnd = entries[i].vertexOffset + sizeof(GLfloat) * FLOATS_PER_VERTEX * (uint64_t)entries[i].vertexCount;
+		uint64_t indexEnd = entries[i].indexOffset + sizeof(unsigned int) * (uint64_t)entries[i].indexCount;
+		if (vertexEnd > size || indexEnd > size || entries[i].vertexFormat > VertexFormat::QUANTIZED)
+		{
+			printf("Mesh cache %s is truncated, recooking\n", cacheLocation.c_str());
+			Close();
+			return false;
+		}
+
+		if (entries[i].lodCount == 0 || entries[i].lodCount > MeshLod::MAX_LODS)
+		{
+			printf("Mesh cache %s has a broken LOD table, recooking\n", cacheLocation.c_str());
+			Close();
+			return false;
+		}
+		for (uint32_t j = 0; j < entries[i].lodCount; j++)
+		{
+			if ((uint64_t)entries[i].lodFirstIndex[j] + entries[i].lodIndexCount[j] > entries[i].indexCount)
+			{
+				printf("Mesh cache %s has a broken LOD table, recooking\n", cacheLocation.c_str());
+				Close();
+				return false;
+			}
+		}
+	}
+
+	meshCount = header->meshCount;
+	return true;
+}
+
+void MeshCache::Close()
+{
+	file.Close();
+	entries = NULL;
+	meshCount = 0;
+}
+
+const GLfloat* MeshCache::GetVertices(size_t mesh)
+{
+	return (const GLfloat*)(file.GetData() + entries[mesh].vertexOffset);
+}
+
+const unsigned int* MeshCache::GetIndices(size_t mesh)
+{
+	return (const unsigned int*)(file.GetData() + entries[mesh].indexOffset);
+}
+
+unsigned int MeshCache::GetVertexFloatCount(size_t mesh)
+{
+	return entries[mesh].vertexCount * FLOATS_PER_VERTEX;
+}
+
+unsigned int MeshCache::GetIndexCount(size_t mesh)
+{
+	return entries[mesh].indexCount;
+}
+
+VertexFormat::Type MeshCache::GetVertexFormat(size_t mesh)
+{
+	return (VertexFormat::Type)entries[mesh].vertexFormat;
+}
+
+unsigned int MeshCache::GetLodCount(size_t mesh)
+{
+	return entries[mesh].lodCount;
+}
+
+MeshLod MeshCache::GetLod(size_t mesh, unsigned int lod)
+{
+	MeshLod level;
+	level.firstIndex = entries[mesh].lodFirstIndex[lod];
+	level.indexCount = entries[mesh].lodIndexCount[lod];
+	level.error = entries[mesh].lodError[lod];
+	return level;
+}
+
+bool MeshCache::Write(const std::string& cacheLocation, uint64_t sourceHash, const std::vector<MeshData>& meshes)
+{
+	std::ofstream fileStream(cacheLocation.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fileStream.is_open())
+	{
+		printf("Failed to write mesh cache %s\n", cacheLocation.c_str());
+		return false;
+	}
+
+	Header header;
+	memcpy(header.magic, TMESH_MAGIC, 4);
+	header.version = VERSION;
+	header.sourceHash = sourceHash;
+	header.meshCount = (uint32_t)meshes.size();
+	header.floatsPerVertex = FLOATS_PER_VERTEX;
+
+	// Data follows the entry table, every array is a multiple of 4 bytes so everything stays aligned
+	std::vector<Entry> table(meshes.size());
+	uint64_t offset = sizeof(Header) + sizeof(Entry) * meshes.size();
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		table[i].vertexCount = (uint32_t)(meshes[i].vertices.size() / FLOATS_PER_VERTEX);
+		table[i].indexCount = (uint32_t)meshes[i].indices.size();
+		table[i].vertexOffset = offset;
+		offset += sizeof(GLfloat) * meshes[i].vertices.size();
+		table[i].indexOffset = offset;
+		offset += sizeof(unsigned int) * meshes[i].indices.size();
+		table[i].vertexFormat = (uint32_t)meshes[i].format;
+
+		// Meshes that never went through MeshSimplifier are a single level
+		const std::vector<MeshLod>& lods = meshes[i].lods;
+		table[i].lodCount = lods.empty() ? 1 : (uint32_t)std::min(lods.size(), (size_t)MeshLod::MAX_LODS);
+		for (uint32_t j = 0; j < MeshLod::MAX_LODS; j++)
+		{
+			bool used = j < table[i].lodCount;
+			table[i].lodFirstIndex[j] = used && !lods.empty() ? lods[j].firstIndex : 0;
+			table[i].lodIndexCount[j] = used ? (lods.empty() ? table[i].indexCount : lods[j].indexCount) : 0;
+			table[i].lodError[j] = used && !lods.empty() ? lods[j].error : 0.0f;
+		}
+	}
+
+	fileStream.write((const char*)&header, sizeof(header));
+	if (!table.empty())
+	{
+		fileStream.write((const char*)&table[0], sizeof(Entry) * table.size());
+	}
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (!meshes[i].vertices.empty())
+		{
+			fileStream.write((const char*)&meshes[i].vertices[0], sizeof(GLfloat) * meshes[i].vertices.size());
+		}
+		if (!meshes[i].indices.empty())
+		{
+			fileStream.write((const char*)&meshes[i].indices[0], sizeof(unsigned int) * meshes[i].indices.size());
+		}
+	}
+
+	return fileStream.good();
+}
+
+uint64_t MeshCache::HashFile(const std::string& fileLocation)
+{
+	AssetPack* pack = AssetPack::GetMounted();
+	if (pack != NULL)
+	{
+		uint64_t packedHash = pack->GetFileHash(fileLocation);
+		if (packedHash != 0)
+		{
+			return packedHash;
+		}
+	}
+
+	MappedFile source;
+	if (!source.Open(fileLocation))
+	{
+		return 0;
+	}
+
+	return HashData(source.GetData(), source.GetSize());
+}
+
+uint64_t MeshCache::HashData(const unsigned char* data, size_t size)
+{
+	// 64-bit FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash != 0 ? hash : 1;
+}
+
+std::string MeshCache::GetCacheLocation(const std::string& sourceLocation)
+{
+	size_t dot = sourceLocation.find_last_of('.');
+	size_t slash = sourceLocation.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+	{
+		return sourceLocation + ".tmesh";
+	}
+
+	return sourceLocation.substr(0, dot) + ".tmesh";
+}
+
+MeshCache::~MeshCache()
+{
+	Close();
+}
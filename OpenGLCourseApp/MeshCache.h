@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <GL\glew.h>
+
+#include "MappedFile.h"
+#include "MeshData.h"
+
+// Cooked .tmesh files hold the final interleaved vertex and index data of every mesh in a model,
+// tagged with a hash of the source file. Loading one is a memory mapping, the mapped
+// arrays go straight to glBufferData.
+class MeshCache
+{
+public:
+	static const uint32_t VERSION = 4;
+
+	MeshCache();
+
+	bool Open(const std::string& cacheLocation, uint64_t sourceHash);
+	void Close();
+
+	size_t GetMeshCount() { return meshCount; }
+	const GLfloat* GetVertices(size_t mesh);
+	const unsigned int* GetIndices(size_t mesh);
+	unsigned int GetVertexFloatCount(size_t mesh);
+	unsigned int GetIndexCount(size_t mesh);
+	VertexFormat::Type GetVertexFormat(size_t mesh);
+	unsigned int GetLodCount(size_t mesh);
+	MeshLod GetLod(size_t mesh, unsigned int lod);
+
+	static bool Write(const std::string& cacheLocation, uint64_t sourceHash, const std::vector<MeshData>& meshes);
+	// 64-bit FNV-1a, never 0. Files in the mounted AssetPack use the hash recorded when it was packed
+	static uint64_t HashFile(const std::string& fileLocation);
+	static uint64_t HashData(const unsigned char* data, size_t size);
+	static std::string GetCacheLocation(const std::string& sourceLocation);
+
+	~MeshCache();
+
+private:
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t meshCount;
+		uint32_t floatsPerVertex;
+	};
+
+	struct Entry
+	{
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint32_t vertexFormat;
+		uint32_t lodCount;
+		uint32_t lodFirstIndex[MeshLod::MAX_LODS];
+		uint32_t lodIndexCount[MeshLod::MAX_LODS];
+		float lodError[MeshLod::MAX_LODS];
+	};
+
+	MappedFile file;
+	const Entry* entries;
+	size_t meshCount;
+};
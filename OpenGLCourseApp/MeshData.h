@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include <GL\glew.h>
+
+#include "VertexFormat.h"
+
+// One level of detail of a mesh: a range of its indices drawn over the shared vertices.
+// error is how far the level deviates from the full mesh, relative to the bounding radius.
+struct MeshLod
+{
+	static const unsigned int MAX_LODS = 4;
+
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	float error;
+};
+
+// CPU side copy of one mesh in the interleaved layout Mesh::CreateMesh expects:
+// x y z, u v, nx ny nz per vertex. format is the layout the mesh is stored in on the GPU.
+struct MeshData
+{
+	std::vector<GLfloat> vertices;
+	std::vector<unsigned int> indices;
+	VertexFormat::Type format;
+	// Level 0 first, each level's indices follow the previous one's. Empty means a single level
+	std::vector<MeshLod> lods;
+
+	MeshData() { format = VertexFormat::FLOAT32; }
+};
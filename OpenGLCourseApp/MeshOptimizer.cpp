@@ -0,0 +1,362 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+#include <glm\glm.hpp>
+
+const float MeshOptimizer::OVERDRAW_THRESHOLD = 1.05f;
+
+static const float CACHE_DECAY_POWER = 1.5f;
+static const float LAST_TRIANGLE_SCORE = 0.75f;
+static const float VALENCE_BOOST_SCALE = 2.0f;
+static const float VALENCE_BOOST_POWER = 0.5f;
+
+static float GetVertexScore(int cachePosition, unsigned int remainingValence)
+{
+	// Nothing left to draw with this vertex, it should leave the cache
+	if (remainingValence == 0)
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		// The last triangle's vertices get a fixed score so the next pick doesn't just reuse them
+		if (cachePosition < 3)
+		{
+			score = LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			float scale = 1.0f / (MeshOptimizer::CACHE_SIZE - 3);
+			score = powf(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+		}
+	}
+
+	// Vertices with few triangles left are finished off first
+	score += VALENCE_BOOST_SCALE * powf((float)remainingValence, -VALENCE_BOOST_POWER);
+	return score;
+}
+
+void MeshOptimizer::Optimize(MeshData& mesh, const char* name)
+{
+	unsigned int vertexCount = (unsigned int)(mesh.vertices.size() / VertexFormat::FLOATS_PER_VERTEX);
+	if (mesh.indices.size() < 3 || vertexCount == 0)
+	{
+		return;
+	}
+
+	float before = CalculateACMR(mesh.indices, vertexCount, ACMR_CACHE_SIZE);
+
+	OptimizeVertexCache(mesh.indices, vertexCount);
+	OptimizeOverdraw(mesh.indices, mesh.vertices, OVERDRAW_THRESHOLD);
+	OptimizeVertexFetch(mesh.vertices, mesh.indices);
+
+	vertexCount = (unsigned int)(mesh.vertices.size() / VertexFormat::FLOATS_PER_VERTEX);
+	float after = CalculateACMR(mesh.indices, vertexCount, ACMR_CACHE_SIZE);
+
+	printf("%s: %u triangles, %u vertices, ACMR %.3f -> %.3f\n", name, (unsigned int)(mesh.indices.size() / 3), vertexCount, before, after);
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangles using each vertex, the first remainingValence entries of a vertex's range are the undrawn ones
+	std::vector<unsigned int> remainingValence(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		remainingValence[indices[i]]++;
+	}
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remainingValence[v];
+	}
+
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+		}
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		vertexScores[v] = GetVertexScore(-1, remainingValence[v]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+	}
+
+	std::vector<unsigned char> emitted(triangleCount, 0);
+	std::vector<unsigned int> output;
+	output.reserve(triangleCount * 3);
+
+	// Three extra slots hold the vertices pushed out by the newest triangle until their scores are updated
+	unsigned int cache[CACHE_SIZE + 3];
+	unsigned int cacheCount = 0;
+
+	size_t scanPosition = 0;
+	int best = -1;
+	float bestScore = -1.0f;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		if (triangleScores[t] > bestScore)
+		{
+			bestScore = triangleScores[t];
+			best = (int)t;
+		}
+	}
+
+	while (output.size() < triangleCount * 3)
+	{
+		// Nothing adjacent to the cache left, continue with the next undrawn triangle in input order
+		if (best < 0)
+		{
+			while (emitted[scanPosition])
+			{
+				scanPosition++;
+			}
+			best = (int)scanPosition;
+		}
+
+		emitted[best] = 1;
+
+		unsigned int newCache[CACHE_SIZE + 3];
+		unsigned int newCount = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[best * 3 + k];
+			output.push_back(v);
+			newCache[newCount++] = v;
+
+			// Swap the triangle out of the vertex's undrawn range
+			unsigned int* begin = &adjacency[adjacencyOffsets[v]];
+			unsigned int* last = begin + remainingValence[v] - 1;
+			for (unsigned int* it = begin; it <= last; it++)
+			{
+				if (*it == (unsigned int)best)
+				{
+					std::swap(*it, *last);
+					break;
+				}
+			}
+			remainingValence[v]--;
+		}
+
+		for (unsigned int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+			{
+				newCache[newCount++] = v;
+			}
+		}
+
+		// Rescore everything that moved in, through or out of the cache
+		best = -1;
+		bestScore = -1.0f;
+		for (unsigned int i = 0; i < newCount; i++)
+		{
+			unsigned int v = newCache[i];
+			cachePosition[v] = i < CACHE_SIZE ? (int)i : -1;
+
+			float score = GetVertexScore(cachePosition[v], remainingValence[v]);
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			for (unsigned int j = 0; j < remainingValence[v]; j++)
+			{
+				unsigned int t = adjacency[adjacencyOffsets[v] + j];
+				triangleScores[t] += delta;
+			}
+		}
+
+		for (unsigned int i = 0; i < newCount && i < CACHE_SIZE; i++)
+		{
+			unsigned int v = newCache[i];
+			for (unsigned int j = 0; j < remainingValence[v]; j++)
+			{
+				unsigned int t = adjacency[adjacencyOffsets[v] + j];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					best = (int)t;
+				}
+			}
+		}
+
+		cacheCount = newCount < CACHE_SIZE ? newCount : CACHE_SIZE;
+		for (unsigned int i = 0; i < cacheCount; i++)
+		{
+			cache[i] = newCache[i];
+		}
+	}
+
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<GLfloat>& vertices, float threshold)
+{
+	size_t triangleCount = indices.size() / 3;
+	unsigned int vertexCount = (unsigned int)(vertices.size() / VertexFormat::FLOATS_PER_VERTEX);
+	if (triangleCount < 2)
+	{
+		return;
+	}
+
+	// A cluster starts wherever a triangle misses the cache on all three vertices,
+	// reordering at those points doesn't cost any extra vertex shading
+	std::vector<size_t> clusterStarts;
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = ACMR_CACHE_SIZE + 1;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		int misses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = indices[t * 3 + k];
+			if (time - timestamps[v] > ACMR_CACHE_SIZE)
+			{
+				timestamps[v] = time++;
+				misses++;
+			}
+		}
+
+		if (t == 0 || misses == 3)
+		{
+			clusterStarts.push_back(t);
+		}
+	}
+
+	if (clusterStarts.size() < 2)
+	{
+		return;
+	}
+	clusterStarts.push_back(triangleCount);
+
+	// Area weighted centroid and normal of every cluster and of the whole mesh
+	size_t clusterCount = clusterStarts.size() - 1;
+	std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float clusterArea = 0.0f;
+		for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+		{
+			const GLfloat* a = &vertices[indices[t * 3] * VertexFormat::FLOATS_PER_VERTEX];
+			const GLfloat* b = &vertices[indices[t * 3 + 1] * VertexFormat::FLOATS_PER_VERTEX];
+			const GLfloat* d = &vertices[indices[t * 3 + 2] * VertexFormat::FLOATS_PER_VERTEX];
+			glm::vec3 p0(a[0], a[1], a[2]), p1(b[0], b[1], b[2]), p2(d[0], d[1], d[2]);
+
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+
+			clusterCentroids[c] += centroid * area;
+			clusterNormals[c] += normal;
+			clusterArea += area;
+		}
+
+		meshCentroid += clusterCentroids[c];
+		meshArea += clusterArea;
+		clusterCentroids[c] = clusterArea > 0.0f ? clusterCentroids[c] / clusterArea : clusterCentroids[c];
+	}
+	meshCentroid = meshArea > 0.0f ? meshCentroid / meshArea : meshCentroid;
+
+	// Clusters facing away from the middle of the mesh are likely in front of the others, draw them first
+	std::vector<std::pair<float, size_t> > order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		float length = glm::length(clusterNormals[c]);
+		glm::vec3 normal = length > 0.0f ? clusterNormals[c] / length : glm::vec3(0.0f);
+		order[c] = std::make_pair(-glm::dot(clusterCentroids[c] - meshCentroid, normal), c);
+	}
+	std::stable_sort(order.begin(), order.end());
+
+	std::vector<unsigned int> sorted;
+	sorted.reserve(indices.size());
+	for (size_t i = 0; i < clusterCount; i++)
+	{
+		size_t c = order[i].second;
+		sorted.insert(sorted.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+	}
+
+	// Only keep the new order if the cache doesn't suffer for it
+	float before = CalculateACMR(indices, vertexCount, ACMR_CACHE_SIZE);
+	float after = CalculateACMR(sorted, vertexCount, ACMR_CACHE_SIZE);
+	if (after <= before * threshold)
+	{
+		indices.swap(sorted);
+	}
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<GLfloat>& vertices, std::vector<unsigned int>& indices)
+{
+	const unsigned int stride = VertexFormat::FLOATS_PER_VERTEX;
+	unsigned int vertexCount = (unsigned int)(vertices.size() / stride);
+
+	const unsigned int UNUSED = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(vertexCount, UNUSED);
+	std::vector<GLfloat> reordered;
+	reordered.reserve(vertices.size());
+
+	unsigned int nextVertex = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned int v = indices[i];
+		if (remap[v] == UNUSED)
+		{
+			remap[v] = nextVertex++;
+			reordered.insert(reordered.end(), vertices.begin() + v * stride, vertices.begin() + (v + 1) * stride);
+		}
+		indices[i] = remap[v];
+	}
+
+	vertices.swap(reordered);
+}
+
+float MeshOptimizer::CalculateACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return 0.0f;
+	}
+
+	// A vertex is in the FIFO if fewer than cacheSize misses happened since it was loaded
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	unsigned int misses = 0;
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		unsigned int v = indices[i];
+		if (time - timestamps[v] > cacheSize)
+		{
+			timestamps[v] = time++;
+			misses++;
+		}
+	}
+
+	return (float)misses / triangleCount;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include <GL\glew.h>
+
+#include "MeshData.h"
+
+// Import-time reordering of triangles and vertices. Works on MeshData before it is cooked,
+// so the result is paid for once and every later load gets the optimized order.
+class MeshOptimizer
+{
+public:
+	// Post-transform cache size the Forsyth scores are tuned for
+	static const unsigned int CACHE_SIZE = 32;
+	// FIFO size used to measure ACMR, small enough to be pessimistic on any GPU
+	static const unsigned int ACMR_CACHE_SIZE = 16;
+	// How much ACMR the overdraw pass may give back for a better front-to-back order
+	static const float OVERDRAW_THRESHOLD;
+
+	// Runs all three passes below and prints the ACMR before and after
+	static void Optimize(MeshData& mesh, const char* name);
+
+	// Forsyth's linear-speed vertex cache optimisation
+	static void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount);
+	// Orders cache-friendly clusters of triangles so outward facing ones come first
+	static void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<GLfloat>& vertices, float threshold);
+	// Renumbers vertices in first-use order and drops the unreferenced ones
+	static void OptimizeVertexFetch(std::vector<GLfloat>& vertices, std::vector<unsigned int>& indices);
+
+	// Average cache misses per triangle with a FIFO cache, 0.5 is the best a regular grid gets, 3.0 the worst
+	static float CalculateACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize);
+};
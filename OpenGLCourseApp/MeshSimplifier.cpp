@@ -0,0 +1,401 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <glm\glm.hpp>
+
+#include "MeshOptimizer.h"
+
+const float MeshSimplifier::LOD_RATIOS[MeshLod::MAX_LODS] = { 1.0f, 0.5f, 0.25f, 0.125f };
+const float MeshSimplifier::LOD_ERRORS[MeshLod::MAX_LODS] = { 0.0f, 0.01f, 0.03f, 0.08f };
+const float MeshSimplifier::MIN_REDUCTION = 0.2f;
+
+// A collapse may turn a triangle by at most about 75 degrees
+static const float FLIP_THRESHOLD = 0.25f;
+
+// Sum of the squared distances to a set of planes, weighted by triangle area. Dividing by
+// the total weight keeps the error a distance whatever the triangle sizes are.
+struct Quadric
+{
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+	double weight;
+};
+
+struct Collapse
+{
+	unsigned int from;
+	unsigned int to;
+	double cost;
+
+	bool operator<(const Collapse& other) const { return cost < other.cost; }
+};
+
+static void AddPlane(Quadric& quadric, const glm::dvec3& normal, double distance, double weight)
+{
+	quadric.a2 += weight * normal.x * normal.x;
+	quadric.ab += weight * normal.x * normal.y;
+	quadric.ac += weight * normal.x * normal.z;
+	quadric.ad += weight * normal.x * distance;
+	quadric.b2 += weight * normal.y * normal.y;
+	quadric.bc += weight * normal.y * normal.z;
+	quadric.bd += weight * normal.y * distance;
+	quadric.c2 += weight * normal.z * normal.z;
+	quadric.cd += weight * normal.z * distance;
+	quadric.d2 += weight * distance * distance;
+	quadric.weight += weight;
+}
+
+static void AddQuadric(Quadric& quadric, const Quadric& other)
+{
+	quadric.a2 += other.a2;
+	quadric.ab += other.ab;
+	quadric.ac += other.ac;
+	quadric.ad += other.ad;
+	quadric.b2 += other.b2;
+	quadric.bc += other.bc;
+	quadric.bd += other.bd;
+	quadric.c2 += other.c2;
+	quadric.cd += other.cd;
+	quadric.d2 += other.d2;
+	quadric.weight += other.weight;
+}
+
+static double EvaluateQuadric(const Quadric& quadric, const glm::vec3& position)
+{
+	if (quadric.weight <= 0.0)
+	{
+		return 0.0;
+	}
+
+	double x = position.x, y = position.y, z = position.z;
+	double error = quadric.a2 * x * x + 2.0 * quadric.ab * x * y + 2.0 * quadric.ac * x * z + 2.0 * quadric.ad * x
+		+ quadric.b2 * y * y + 2.0 * quadric.bc * y * z + 2.0 * quadric.bd * y
+		+ quadric.c2 * z * z + 2.0 * quadric.cd * z + quadric.d2;
+
+	// Rounding can take an exact fit slightly below zero
+	return error > 0.0 ? error / quadric.weight : 0.0;
+}
+
+static bool KeepsOrientation(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+	const std::vector<unsigned int>& adjacency, const std::vector<unsigned int>& adjacencyOffsets, unsigned int from, unsigned int to)
+{
+	for (unsigned int i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; i++)
+	{
+		const unsigned int* triangle = &indices[adjacency[i] * 3];
+
+		// Triangles on the collapsed edge disappear, they can't flip
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+		{
+			continue;
+		}
+
+		glm::vec3 before[3], after[3];
+		for (int j = 0; j < 3; j++)
+		{
+			before[j] = positions[triangle[j]];
+			after[j] = positions[triangle[j] == from ? to : triangle[j]];
+		}
+
+		glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+		if (glm::dot(normalBefore, normalAfter) <= FLIP_THRESHOLD * glm::length(normalBefore) * glm::length(normalAfter))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void MeshSimplifier::GenerateLods(MeshData& mesh, const char* name)
+{
+	mesh.lods.clear();
+
+	MeshLod full;
+	full.firstIndex = 0;
+	full.indexCount = (unsigned int)mesh.indices.size();
+	full.error = 0.0f;
+	mesh.lods.push_back(full);
+
+	unsigned int vertexCount = (unsigned int)(mesh.vertices.size() / VertexFormat::FLOATS_PER_VERTEX);
+	if (mesh.indices.size() < 3 || vertexCount == 0)
+	{
+		return;
+	}
+
+	// Every level starts from the full mesh, so errors don't stack up from one level to the next
+	std::vector<unsigned int> fullIndices(mesh.indices);
+	std::vector<unsigned int> lodIndices;
+	for (unsigned int i = 1; i < MeshLod::MAX_LODS; i++)
+	{
+		size_t targetIndexCount = (size_t)(fullIndices.size() * LOD_RATIOS[i]) / 3 * 3;
+		float error = Simplify(mesh.vertices, fullIndices, targetIndexCount, LOD_ERRORS[i], lodIndices);
+
+		// The error budget ran out close to the previous level, a coarser one won't get any further
+		unsigned int previousCount = mesh.lods.back().indexCount;
+		if (lodIndices.empty() || lodIndices.size() > previousCount * (1.0f - MIN_REDUCTION))
+		{
+			break;
+		}
+
+		MeshOptimizer::OptimizeVertexCache(lodIndices, vertexCount);
+
+		MeshLod lod;
+		lod.firstIndex = (unsigned int)mesh.indices.size();
+		lod.indexCount = (unsigned int)lodIndices.size();
+		lod.error = glm::max(error, mesh.lods.back().error);
+		mesh.indices.insert(mesh.indices.end(), lodIndices.begin(), lodIndices.end());
+		mesh.lods.push_back(lod);
+	}
+
+	for (size_t i = 1; i < mesh.lods.size(); i++)
+	{
+		printf("%s: LOD %u, %u triangles, error %.4f\n", name, (unsigned int)i, mesh.lods[i].indexCount / 3, mesh.lods[i].error);
+	}
+}
+
+float MeshSimplifier::Simplify(const std::vector<GLfloat>& vertices, const std::vector<unsigned int>& indices,
+	size_t targetIndexCount, float targetError, std::vector<unsigned int>& result)
+{
+	result = indices;
+
+	size_t vertexCount = vertices.size() / VertexFormat::FLOATS_PER_VERTEX;
+	if (result.size() <= targetIndexCount || vertexCount == 0)
+	{
+		return 0.0f;
+	}
+
+	std::vector<glm::vec3> positions(vertexCount);
+	glm::vec3 boundsMin(vertices[0], vertices[1], vertices[2]);
+	glm::vec3 boundsMax = boundsMin;
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const GLfloat* vertex = &vertices[i * VertexFormat::FLOATS_PER_VERTEX];
+		positions[i] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+		boundsMin = glm::min(boundsMin, positions[i]);
+		boundsMax = glm::max(boundsMax, positions[i]);
+	}
+
+	float radius = glm::length(boundsMax - boundsMin) * 0.5f;
+	if (radius <= 0.0f)
+	{
+		return 0.0f;
+	}
+
+	// Vertices split along a uv or normal seam share a position. Moving one side of a seam
+	// without the other would open a crack, so seam vertices stay where they are.
+	std::vector<unsigned int> sorted(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		sorted[i] = (unsigned int)i;
+	}
+	std::sort(sorted.begin(), sorted.end(), [&positions](unsigned int a, unsigned int b) {
+		const glm::vec3& pa = positions[a];
+		const glm::vec3& pb = positions[b];
+		return pa.x != pb.x ? pa.x < pb.x : (pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z);
+	});
+
+	std::vector<unsigned int> positionIds(vertexCount);
+	std::vector<unsigned char> locked(vertexCount, 0);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		if (i > 0 && positions[sorted[i]] == positions[sorted[i - 1]])
+		{
+			positionIds[sorted[i]] = positionIds[sorted[i - 1]];
+			locked[sorted[i]] = 1;
+			locked[sorted[i - 1]] = 1;
+		}
+		else
+		{
+			positionIds[sorted[i]] = sorted[i];
+		}
+	}
+
+	// An edge with a single triangle is on an open border, collapsing along it would shrink the outline
+	std::vector<uint64_t> edges;
+	edges.reserve(result.size());
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			uint64_t a = positionIds[result[i + j]];
+			uint64_t b = positionIds[result[i + (j + 1) % 3]];
+			edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	std::vector<unsigned char> borderPositions(vertexCount, 0);
+	for (size_t i = 0; i < edges.size(); )
+	{
+		size_t end = i + 1;
+		while (end < edges.size() && edges[end] == edges[i])
+		{
+			end++;
+		}
+		if (end - i == 1)
+		{
+			borderPositions[(size_t)(edges[i] >> 32)] = 1;
+			borderPositions[(size_t)(edges[i] & 0xffffffff)] = 1;
+		}
+		i = end;
+	}
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		locked[i] |= borderPositions[positionIds[i]];
+	}
+
+	Quadric zero = {};
+	std::vector<Quadric> quadrics(vertexCount, zero);
+	for (size_t i = 0; i < result.size(); i += 3)
+	{
+		glm::dvec3 p0(positions[result[i]]);
+		glm::dvec3 p1(positions[result[i + 1]]);
+		glm::dvec3 p2(positions[result[i + 2]]);
+
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		double length = glm::length(normal);
+		if (length <= 0.0)
+		{
+			continue;
+		}
+		normal /= length;
+
+		double distance = -glm::dot(normal, p0);
+		for (int j = 0; j < 3; j++)
+		{
+			AddPlane(quadrics[result[i + j]], normal, distance, length * 0.5);
+		}
+	}
+
+	double maxCost = (double)targetError * radius;
+	maxCost *= maxCost;
+	double reachedCost = 0.0;
+
+	std::vector<unsigned int> adjacencyOffsets, adjacency, fill, remap;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned char> touched;
+
+	// Each pass takes the cheapest collapses that don't share a triangle, then rebuilds the index list
+	while (result.size() > targetIndexCount)
+	{
+		size_t triangleCount = result.size() / 3;
+
+		adjacencyOffsets.assign(vertexCount + 1, 0);
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			adjacencyOffsets[result[i] + 1]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+		adjacency.resize(result.size());
+		fill.assign(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++)
+		{
+			adjacency[fill[result[i]]++] = (unsigned int)(i / 3);
+		}
+
+		// Both directions of every edge, the cost is the error at the end the other one moves onto
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				unsigned int a = result[i + j];
+				unsigned int b = result[i + (j + 1) % 3];
+				Quadric quadric = quadrics[a];
+				AddQuadric(quadric, quadrics[b]);
+
+				if (!locked[a])
+				{
+					Collapse collapse = { a, b, EvaluateQuadric(quadric, positions[b]) };
+					collapses.push_back(collapse);
+				}
+				if (!locked[b])
+				{
+					Collapse collapse = { b, a, EvaluateQuadric(quadric, positions[a]) };
+					collapses.push_back(collapse);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		touched.assign(vertexCount, 0);
+		remap.resize(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			remap[v] = (unsigned int)v;
+		}
+
+		size_t removed = 0;
+		size_t applied = 0;
+		for (size_t i = 0; i < collapses.size(); i++)
+		{
+			const Collapse& collapse = collapses[i];
+			if (collapse.cost > maxCost)
+			{
+				break;
+			}
+
+			if (touched[collapse.from] || touched[collapse.to] ||
+				!KeepsOrientation(positions, result, adjacency, adjacencyOffsets, collapse.from, collapse.to))
+			{
+				continue;
+			}
+
+			// Every vertex around the moved one is frozen for the rest of the pass, so the orientation
+			// test above stays valid for the collapses that follow
+			for (unsigned int k = adjacencyOffsets[collapse.from]; k < adjacencyOffsets[collapse.from + 1]; k++)
+			{
+				const unsigned int* triangle = &result[adjacency[k] * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					removed++;
+				}
+				touched[triangle[0]] = 1;
+				touched[triangle[1]] = 1;
+				touched[triangle[2]] = 1;
+			}
+
+			remap[collapse.from] = collapse.to;
+			AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			reachedCost = glm::max(reachedCost, collapse.cost);
+			applied++;
+
+			if ((triangleCount - removed) * 3 <= targetIndexCount)
+			{
+				break;
+			}
+		}
+
+		if (applied == 0)
+		{
+			break;
+		}
+
+		// Triangles on a collapsed edge are now lines, drop them
+		size_t write = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			unsigned int a = remap[result[i]];
+			unsigned int b = remap[result[i + 1]];
+			unsigned int c = remap[result[i + 2]];
+			if (a == b || b == c || a == c)
+			{
+				continue;
+			}
+
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	return (float)(sqrt(reachedCost) / radius);
+}
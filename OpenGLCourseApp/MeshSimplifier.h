@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include <GL\glew.h>
+
+#include "MeshData.h"
+
+// Import-time level of detail generation. Levels are made by quadric error edge collapse
+// and only ever move a vertex onto one of its neighbours, so every level indexes the same
+// vertices and a mesh keeps one vertex buffer for its whole LOD chain.
+class MeshSimplifier
+{
+public:
+	// Index count of each level relative to the full mesh, level 0 is the full mesh
+	static const float LOD_RATIOS[MeshLod::MAX_LODS];
+	// Largest error each level may reach, relative to the mesh's bounding radius
+	static const float LOD_ERRORS[MeshLod::MAX_LODS];
+	// A level that removes less than this share of the previous level's triangles isn't kept
+	static const float MIN_REDUCTION;
+
+	// Appends the coarser levels after the mesh's own indices and fills mesh.lods
+	static void GenerateLods(MeshData& mesh, const char* name);
+
+	// Collapses edges until result has at most targetIndexCount indices or the next collapse
+	// would pass targetError. Returns the error reached, both errors relative to the bounding radius
+	static float Simplify(const std::vector<GLfloat>& vertices, const std::vector<unsigned int>& indices,
+		size_t targetIndexCount, float targetError, std::vector<unsigned int>& result);
+};
@@ -0,0 +1,539 @@
+#include "Model.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include <thread>
+
+#include "AssetPack.h"
+#include "MappedFile.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OBJ_USE_SSE2
+#endif
+
+// What one thread parsed. Indices written as positive numbers are already global, negative
+// ones are relative to the chunk's own counts until Merge adds the counts of the chunks before it
+struct OBJLoader::Chunk {
+    std::vector<Vertex> vertices;
+    std::vector<TexCoord> texCoords;
+    std::vector<Normal> normals;
+    std::vector<Face> faces;
+    // face * 9 + slot of every index that still needs its chunk's base added, slots as in FaceIndex
+    std::vector<size_t> relativeIndices;
+    // usemtl lines as (first face after it, name). Faces before the first one continue the previous chunk's material
+    std::vector<std::pair<size_t, std::string> > materialSwitches;
+
+    bool failed;
+    std::string failedLine;
+
+    // Corners of the current polygon, kept to avoid an allocation per face
+    std::vector<int> cornerIndices;
+    std::vector<bool> cornerRelative;
+
+    Chunk() : failed(false) {}
+};
+
+static_assert(sizeof(Face) == sizeof(int) * 9, "Face is addressed as nine ints");
+
+// 0-2 position, 3-5 texture coordinate, 6-8 normal
+static int& FaceIndex(Face& face, size_t slot) {
+    return (&face.v1)[slot];
+}
+
+static const char* FindNewline(const char* c, const char* end) {
+#ifdef OBJ_USE_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - c >= 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)c), newline));
+        if (mask != 0) {
+            while (*c != '\n') {
+                c++;
+            }
+            return c;
+        }
+        c += 16;
+    }
+#endif
+    const char* found = (const char*)memchr(c, '\n', end - c);
+    return found != NULL ? found : end;
+}
+
+static bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* SkipSpaces(const char* c, const char* end) {
+    while (c < end && IsSpace(*c)) {
+        c++;
+    }
+    return c;
+}
+
+static double PowerOfTen(int exponent) {
+    // Exact as doubles up to 1e22
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    return exponent <= 22 ? powers[exponent] : pow(10.0, exponent);
+}
+
+// fast_atof style: up to 19 significant digits go into an integer, scaled once by a power of ten.
+// Enough for float, and unlike strtof it needs neither a terminator nor the C locale
+static bool ParseFloat(const char*& c, const char* end, float& value) {
+    c = SkipSpaces(c, end);
+
+    bool negative = false;
+    if (c < end && (*c == '-' || *c == '+')) {
+        negative = *c == '-';
+        c++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool anyDigit = false;
+
+    while (c < end && *c >= '0' && *c <= '9') {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*c - '0');
+            digits += mantissa != 0 ? 1 : 0;
+        }
+        else {
+            exponent++;
+        }
+        anyDigit = true;
+        c++;
+    }
+
+    if (c < end && *c == '.') {
+        c++;
+        while (c < end && *c >= '0' && *c <= '9') {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*c - '0');
+                digits += mantissa != 0 ? 1 : 0;
+                exponent--;
+            }
+            anyDigit = true;
+            c++;
+        }
+    }
+
+    if (!anyDigit) {
+        return false;
+    }
+
+    if (c < end && (*c == 'e' || *c == 'E')) {
+        c++;
+        bool negativeExponent = false;
+        if (c < end && (*c == '-' || *c == '+')) {
+            negativeExponent = *c == '-';
+            c++;
+        }
+        int written = 0;
+        while (c < end && *c >= '0' && *c <= '9') {
+            written = written < 10000 ? written * 10 + (*c - '0') : written;
+            c++;
+        }
+        exponent += negativeExponent ? -written : written;
+    }
+
+    double result = (double)mantissa;
+    if (exponent < 0) {
+        result /= PowerOfTen(-exponent);
+    }
+    else if (exponent > 0) {
+        result *= PowerOfTen(exponent);
+    }
+
+    value = (float)(negative ? -result : result);
+    return true;
+}
+
+static bool ParseInt(const char*& c, const char* end, int& value) {
+    bool negative = false;
+    if (c < end && (*c == '-' || *c == '+')) {
+        negative = *c == '-';
+        c++;
+    }
+
+    if (c >= end || *c < '0' || *c > '9') {
+        return false;
+    }
+
+    // Saturates, anything that large fails the range check in Merge anyway
+    int64_t result = 0;
+    while (c < end && *c >= '0' && *c <= '9') {
+        result = result < 0x7FFFFFFF ? result * 10 + (*c - '0') : result;
+        c++;
+    }
+    result = result < 0x7FFFFFFF ? result : 0x7FFFFFFF;
+
+    value = (int)(negative ? -result : result);
+    return true;
+}
+
+// Turns one written index into its zero based form, see Chunk
+static bool ResolveIndex(int written, size_t localCount, int& index, bool& relative) {
+    if (written > 0) {
+        index = written - 1;
+        relative = false;
+        return true;
+    }
+    if (written < 0) {
+        index = (int)localCount + written;
+        relative = true;
+        return true;
+    }
+    return false;
+}
+
+OBJLoader::OBJLoader() {
+}
+
+OBJLoader::~OBJLoader() {
+}
+
+void OBJLoader::Clear() {
+    vertices.clear();
+    texCoords.clear();
+    normals.clear();
+    faces.clear();
+    faceRuns.clear();
+    materials.clear();
+}
+
+bool OBJLoader::LoadOBJ(const std::string& filename) {
+    Clear();
+
+    // Stored files and loose files are mapped, files compressed in the asset pack are unpacked
+    MappedFile file;
+    std::vector<unsigned char> unpacked;
+    const char* data = NULL;
+    size_t size = 0;
+
+    AssetPack* pack = AssetPack::GetMounted();
+    const unsigned char* storedData;
+    size_t storedSize;
+    if (pack != NULL && pack->Contains(filename) && !pack->GetStoredData(filename, storedData, storedSize)) {
+        if (!pack->Read(filename, unpacked)) {
+            return false;
+        }
+        data = unpacked.empty() ? NULL : (const char*)&unpacked[0];
+        size = unpacked.size();
+    }
+    else if (file.Open(filename)) {
+        data = (const char*)file.GetData();
+        size = file.GetSize();
+    }
+    else {
+        printf("OBJ (%s) failed to open\n", filename.c_str());
+        return false;
+    }
+
+    size_t chunkCount = size / PARALLEL_CHUNK_SIZE;
+    unsigned int hardwareThreads = std::thread::hardware_concurrency();
+    chunkCount = chunkCount < hardwareThreads ? chunkCount : hardwareThreads;
+    chunkCount = chunkCount < MAX_THREADS ? chunkCount : MAX_THREADS;
+    chunkCount = chunkCount > 0 ? chunkCount : 1;
+
+    // Chunks end just after a line break, so no line is split between two of them
+    std::vector<const char*> bounds(chunkCount + 1);
+    bounds[0] = data;
+    bounds[chunkCount] = data + size;
+    for (size_t i = 1; i < chunkCount; i++) {
+        const char* split = data + size / chunkCount * i;
+        split = split > bounds[i - 1] ? split : bounds[i - 1];
+        const char* newline = FindNewline(split, data + size);
+        bounds[i] = newline < data + size ? newline + 1 : data + size;
+    }
+
+    std::vector<Chunk> chunks(chunkCount);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < chunkCount; i++) {
+        threads.push_back(std::thread(&OBJLoader::ParseChunk, bounds[i], bounds[i + 1], std::ref(chunks[i])));
+    }
+    ParseChunk(bounds[0], bounds[1], chunks[0]);
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    return Merge(chunks, filename);
+}
+
+void OBJLoader::ParseChunk(const char* begin, const char* end, Chunk& chunk) {
+    const char* line = begin;
+    while (line < end && !chunk.failed) {
+        const char* lineEnd = FindNewline(line, end);
+        const char* c = SkipSpaces(line, lineEnd);
+        bool valid = true;
+
+        if (lineEnd - c >= 2 && c[0] == 'v' && IsSpace(c[1])) {
+            Vertex vertex;
+            c += 2;
+            valid = ParseFloat(c, lineEnd, vertex.x) && ParseFloat(c, lineEnd, vertex.y) && ParseFloat(c, lineEnd, vertex.z);
+            chunk.vertices.push_back(vertex);
+        }
+        else if (lineEnd - c >= 3 && c[0] == 'v' && c[1] == 't' && IsSpace(c[2])) {
+            TexCoord texCoord;
+            c += 3;
+            valid = ParseFloat(c, lineEnd, texCoord.u);
+            // 1D texture coordinates leave out v
+            if (valid && !ParseFloat(c, lineEnd, texCoord.v)) {
+                texCoord.v = 0.0f;
+            }
+            chunk.texCoords.push_back(texCoord);
+        }
+        else if (lineEnd - c >= 3 && c[0] == 'v' && c[1] == 'n' && IsSpace(c[2])) {
+            Normal normal;
+            c += 3;
+            valid = ParseFloat(c, lineEnd, normal.nx) && ParseFloat(c, lineEnd, normal.ny) && ParseFloat(c, lineEnd, normal.nz);
+            chunk.normals.push_back(normal);
+        }
+        else if (lineEnd - c >= 2 && c[0] == 'f' && IsSpace(c[1])) {
+            // Each corner is v, v/t, v//n or v/t/n, three slots per corner
+            chunk.cornerIndices.clear();
+            chunk.cornerRelative.clear();
+            c += 2;
+            while (valid) {
+                c = SkipSpaces(c, lineEnd);
+                if (c >= lineEnd) {
+                    break;
+                }
+
+                int written[3] = { 0, 0, 0 };
+                bool present[3] = { true, false, false };
+                valid = ParseInt(c, lineEnd, written[0]);
+                if (valid && c < lineEnd && *c == '/') {
+                    c++;
+                    if (c < lineEnd && *c != '/') {
+                        present[1] = true;
+                        valid = ParseInt(c, lineEnd, written[1]);
+                    }
+                    if (valid && c < lineEnd && *c == '/') {
+                        c++;
+                        present[2] = true;
+                        valid = ParseInt(c, lineEnd, written[2]);
+                    }
+                }
+                valid = valid && (c >= lineEnd || IsSpace(*c));
+
+                size_t localCounts[3] = { chunk.vertices.size(), chunk.texCoords.size(), chunk.normals.size() };
+                for (int k = 0; k < 3 && valid; k++) {
+                    int index = -1;
+                    bool relative = false;
+                    if (present[k]) {
+                        valid = ResolveIndex(written[k], localCounts[k], index, relative);
+                    }
+                    chunk.cornerIndices.push_back(index);
+                    chunk.cornerRelative.push_back(relative);
+                }
+            }
+
+            size_t cornerCount = chunk.cornerIndices.size() / 3;
+            valid = valid && cornerCount >= 3;
+
+            // Fan from the first corner, as aiProcess_Triangulate does for convex polygons
+            for (size_t k = 1; valid && k + 1 < cornerCount; k++) {
+                size_t corners[3] = { 0, k, k + 1 };
+                Face face;
+                for (size_t attribute = 0; attribute < 3; attribute++) {
+                    for (size_t corner = 0; corner < 3; corner++) {
+                        size_t source = corners[corner] * 3 + attribute;
+                        size_t slot = attribute * 3 + corner;
+                        FaceIndex(face, slot) = chunk.cornerIndices[source];
+                        if (chunk.cornerRelative[source]) {
+                            chunk.relativeIndices.push_back(chunk.faces.size() * 9 + slot);
+                        }
+                    }
+                }
+                chunk.faces.push_back(face);
+            }
+        }
+        else if (lineEnd - c >= 7 && strncmp(c, "usemtl", 6) == 0 && IsSpace(c[6])) {
+            c = SkipSpaces(c + 7, lineEnd);
+            const char* nameEnd = lineEnd;
+            while (nameEnd > c && IsSpace(nameEnd[-1])) {
+                nameEnd--;
+            }
+            chunk.materialSwitches.push_back(std::make_pair(chunk.faces.size(), std::string(c, nameEnd)));
+        }
+
+        if (!valid) {
+            chunk.failed = true;
+            chunk.failedLine = std::string(line, lineEnd);
+        }
+        line = lineEnd + 1;
+    }
+}
+
+bool OBJLoader::Merge(std::vector<Chunk>& chunks, const std::string& filename) {
+    size_t vertexTotal = 0, texCoordTotal = 0, normalTotal = 0, faceTotal = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (chunks[i].failed) {
+            printf("OBJ (%s) has a line the fast loader can't read: %s\n", filename.c_str(), chunks[i].failedLine.c_str());
+            return false;
+        }
+        vertexTotal += chunks[i].vertices.size();
+        texCoordTotal += chunks[i].texCoords.size();
+        normalTotal += chunks[i].normals.size();
+        faceTotal += chunks[i].faces.size();
+    }
+
+    vertices.reserve(vertexTotal);
+    texCoords.reserve(texCoordTotal);
+    normals.reserve(normalTotal);
+    faces.reserve(faceTotal);
+
+    // Materials in effect carry over chunk boundaries like the counts do
+    std::string currentMaterial;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        Chunk& chunk = chunks[i];
+        int bases[3] = { (int)vertices.size(), (int)texCoords.size(), (int)normals.size() };
+        for (size_t j = 0; j < chunk.relativeIndices.size(); j++) {
+            size_t slot = chunk.relativeIndices[j] % 9;
+            FaceIndex(chunk.faces[chunk.relativeIndices[j] / 9], slot) += bases[slot / 3];
+        }
+
+        size_t faceBase = faces.size();
+        size_t runStart = 0;
+        for (size_t j = 0; j <= chunk.materialSwitches.size(); j++) {
+            size_t runEnd = j < chunk.materialSwitches.size() ? chunk.materialSwitches[j].first : chunk.faces.size();
+            if (runEnd > runStart) {
+                unsigned int material = FindMaterial(currentMaterial);
+                if (!faceRuns.empty() && faceRuns.back().material == material) {
+                    faceRuns.back().faceCount += runEnd - runStart;
+                }
+                else {
+                    FaceRun run = { material, faceBase + runStart, runEnd - runStart };
+                    faceRuns.push_back(run);
+                }
+            }
+            if (j < chunk.materialSwitches.size()) {
+                currentMaterial = chunk.materialSwitches[j].second;
+            }
+            runStart = runEnd;
+        }
+
+        vertices.insert(vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+        texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+        faces.insert(faces.end(), chunk.faces.begin(), chunk.faces.end());
+    }
+
+    int counts[3] = { (int)vertices.size(), (int)texCoords.size(), (int)normals.size() };
+    for (size_t i = 0; i < faces.size(); i++) {
+        for (size_t slot = 0; slot < 9; slot++) {
+            int index = FaceIndex(faces[i], slot);
+            // Only positions are required
+            int lowest = slot < 3 ? 0 : -1;
+            if (index < lowest || index >= counts[slot / 3]) {
+                printf("OBJ (%s) face %zu refers to a missing element\n", filename.c_str(), i);
+                Clear();
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+unsigned int OBJLoader::FindMaterial(const std::string& name) {
+    for (size_t i = 0; i < materials.size(); i++) {
+        if (materials[i] == name) {
+            return (unsigned int)i;
+        }
+    }
+    materials.push_back(name);
+    return (unsigned int)(materials.size() - 1);
+}
+
+void OBJLoader::BuildMeshData(unsigned int material, MeshData& meshData) const {
+    std::vector<GLfloat>& output = meshData.vertices;
+    std::vector<unsigned int>& indices = meshData.indices;
+
+    // Every position keeps a list of the vt/vn pairs it has been used with and their output vertex
+    std::vector<int> firstVariant(vertices.size(), -1);
+    std::vector<int> nextVariant;
+    std::vector<int> variantTexCoord;
+    std::vector<int> variantNormal;
+
+    // The index count is known up front, the vertex count only once the corners are matched
+    size_t faceCount = 0;
+    for (size_t r = 0; r < faceRuns.size(); r++) {
+        faceCount += faceRuns[r].material == material ? faceRuns[r].faceCount : 0;
+    }
+    indices.reserve(indices.size() + faceCount * 3);
+
+    for (size_t r = 0; r < faceRuns.size(); r++) {
+        if (faceRuns[r].material != material) {
+            continue;
+        }
+
+        for (size_t i = faceRuns[r].firstFace; i < faceRuns[r].firstFace + faceRuns[r].faceCount; i++) {
+            Face face = faces[i];
+            for (size_t corner = 0; corner < 3; corner++) {
+                int position = FaceIndex(face, corner);
+                int texCoord = FaceIndex(face, 3 + corner);
+                int normal = FaceIndex(face, 6 + corner);
+
+                int variant = firstVariant[position];
+                while (variant >= 0 && (variantTexCoord[variant] != texCoord || variantNormal[variant] != normal)) {
+                    variant = nextVariant[variant];
+                }
+
+                if (variant < 0) {
+                    variant = (int)variantTexCoord.size();
+                    nextVariant.push_back(firstVariant[position]);
+                    firstVariant[position] = variant;
+                    variantTexCoord.push_back(texCoord);
+                    variantNormal.push_back(normal);
+
+                    const Vertex& v = vertices[position];
+                    TexCoord t = { 0.0f, 0.0f };
+                    if (texCoord >= 0) {
+                        t = texCoords[texCoord];
+                        t.v = 1.0f - t.v;
+                    }
+                    Normal n = { 0.0f, 0.0f, 0.0f };
+                    if (normal >= 0) {
+                        n = normals[normal];
+                    }
+
+                    GLfloat interleaved[VertexFormat::FLOATS_PER_VERTEX] = { v.x, v.y, v.z, t.u, t.v, n.nx, n.ny, n.nz };
+                    output.insert(output.end(), interleaved, interleaved + VertexFormat::FLOATS_PER_VERTEX);
+                }
+
+                // Variants are numbered in the order their vertices were written
+                indices.push_back((unsigned int)variant);
+            }
+        }
+    }
+}
+
+const std::vector<Vertex>& OBJLoader::GetVertices() const {
+    return vertices;
+}
+
+const std::vector<TexCoord>& OBJLoader::GetTexCoords() const {
+    return texCoords;
+}
+
+const std::vector<Normal>& OBJLoader::GetNormals() const {
+    return normals;
+}
+
+const std::vector<Face>& OBJLoader::GetFaces() const {
+    return faces;
+}
+
+const std::vector<FaceRun>& OBJLoader::GetFaceRuns() const {
+    return faceRuns;
+}
+
+const std::vector<std::string>& OBJLoader::GetMaterials() const {
+    return materials;
+}
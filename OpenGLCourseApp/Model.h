@@ -4,34 +4,75 @@
 #include <string>
 #include <vector>
 
+#include "MeshData.h"
+
 struct Vertex {
     float x, y, z;
 };
 
+struct TexCoord {
+    float u, v;
+};
+
 struct Normal {
     float nx, ny, nz;
 };
 
+// Zero based, -1 when the corner has no texture coordinate or normal
 struct Face {
     int v1, v2, v3;
+    int t1, t2, t3;
     int n1, n2, n3;
 };
 
+// Faces in file order, consecutive faces that share a usemtl form one run
+struct FaceRun {
+    unsigned int material;
+    size_t firstFace;
+    size_t faceCount;
+};
+
+// Reads the geometry of an OBJ file without Assimp. The file is memory mapped, split into lines
+// with an SSE2 newline scan and numbers are parsed in place. Large files are cut at line breaks
+// and parsed on several threads, each chunk counts its own v/vt/vn and the index spaces are
+// merged afterwards. Polygons are fanned into triangles. mtllib, groups and smoothing are ignored.
 class OBJLoader {
 public:
+    // Files smaller than this are parsed on the calling thread
+    static const size_t PARALLEL_CHUNK_SIZE = 4 * 1024 * 1024;
+    static const unsigned int MAX_THREADS = 8;
+
     OBJLoader();
     ~OBJLoader();
 
     bool LoadOBJ(const std::string& filename);
+    void Clear();
 
     const std::vector<Vertex>& GetVertices() const;
+    const std::vector<TexCoord>& GetTexCoords() const;
     const std::vector<Normal>& GetNormals() const;
     const std::vector<Face>& GetFaces() const;
+    const std::vector<FaceRun>& GetFaceRuns() const;
+    // usemtl names, runs before the first usemtl use an empty name
+    const std::vector<std::string>& GetMaterials() const;
+
+    // The faces of one material in the interleaved layout Mesh::CreateMesh expects, with one vertex
+    // per distinct v/vt/vn corner. V is flipped to match aiProcess_FlipUVs, missing attributes are 0
+    void BuildMeshData(unsigned int material, MeshData& meshData) const;
 
 private:
+    struct Chunk;
+
     std::vector<Vertex> vertices;
+    std::vector<TexCoord> texCoords;
     std::vector<Normal> normals;
     std::vector<Face> faces;
+    std::vector<FaceRun> faceRuns;
+    std::vector<std::string> materials;
+
+    static void ParseChunk(const char* begin, const char* end, Chunk& chunk);
+    bool Merge(std::vector<Chunk>& chunks, const std::string& filename);
+    unsigned int FindMaterial(const std::string& name);
 };
 
 #endif // OBJLOADER_H
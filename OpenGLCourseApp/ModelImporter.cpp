@@ -0,0 +1,336 @@
+#include "ModelImporter.h"
+
+#include <stdio.h>
+#include <ctype.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define IMPORTER_USE_SSE
+#endif
+
+#include <assimp/config.h>
+
+#include "AssetPack.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+
+static const unsigned int BASE_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+const ModelImporter::ImportPreset ModelImporter::PRESETS[] =
+{
+	{ "native", BASE_FLAGS | aiProcess_JoinIdenticalVertices, true },
+	{ "assimp", BASE_FLAGS | aiProcess_JoinIdenticalVertices, false },
+	{ "assimp-indexed", BASE_FLAGS, false },
+	{ "assimp-cache", BASE_FLAGS | aiProcess_JoinIdenticalVertices | aiProcess_ImproveCacheLocality | aiProcess_GenBoundingBoxes, false },
+};
+
+std::map<std::string, const ModelImporter::ImportPreset*> ModelImporter::assetPresets;
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const ModelImporter::ImportPreset* ModelImporter::FindPreset(const std::string& name)
+{
+	for (unsigned int i = 0; i < PRESET_COUNT; i++)
+	{
+		if (name == PRESETS[i].name)
+		{
+			return &PRESETS[i];
+		}
+	}
+	return NULL;
+}
+
+const ModelImporter::ImportPreset& ModelImporter::GetPreset(const std::string& filePath)
+{
+	std::map<std::string, const ImportPreset*>::const_iterator preset = assetPresets.find(AssetPack::NormalizeName(filePath));
+	return preset != assetPresets.end() ? *preset->second : PRESETS[0];
+}
+
+bool ModelImporter::LoadPresets(const std::string& fileLocation)
+{
+	std::ifstream fileStream(fileLocation.c_str());
+	if (!fileStream.is_open())
+	{
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(fileStream, line))
+	{
+		std::istringstream lineStream(line);
+		std::string filePath;
+		std::string name;
+		if (!(lineStream >> filePath >> name) || filePath[0] == '#')
+		{
+			continue;
+		}
+
+		const ImportPreset* preset = FindPreset(name);
+		if (preset == NULL)
+		{
+			printf("Unknown import preset %s for %s in %s\n", name.c_str(), filePath.c_str(), fileLocation.c_str());
+			continue;
+		}
+		assetPresets[AssetPack::NormalizeName(filePath)] = preset;
+	}
+	return true;
+}
+
+uint64_t ModelImporter::HashSource(const std::string& filePath)
+{
+	uint64_t fileHash = MeshCache::HashFile(filePath);
+	if (fileHash == 0)
+	{
+		return 0;
+	}
+
+	const ImportPreset& preset = GetPreset(filePath);
+	std::string key((const char*)&fileHash, sizeof(fileHash));
+	key.append((const char*)&preset.postProcessFlags, sizeof(preset.postProcessFlags));
+	key.append(1, preset.nativeOBJ ? '1' : '0');
+	key.append(preset.name);
+	return MeshCache::HashData((const unsigned char*)key.data(), key.size());
+}
+
+ModelImporter::ModelImporter()
+{
+	ioSystem = new MappedIOSystem();
+	importer.SetIOHandler(ioSystem);
+	finishMilliseconds = 0.0;
+}
+
+bool ModelImporter::Import(const std::string& filePath, std::vector<MeshData>& meshDataList)
+{
+	return Import(filePath, meshDataList, GetPreset(filePath), NULL);
+}
+
+bool ModelImporter::Import(const std::string& filePath, std::vector<MeshData>& meshDataList, const ImportPreset& preset, ImportProfiler::Record* record)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	double readMilliseconds = 0.0;
+	finishMilliseconds = 0.0;
+	size_t firstMesh = meshDataList.size();
+
+	size_t dot = filePath.find_last_of('.');
+	std::string extension = dot != std::string::npos ? filePath.substr(dot + 1) : "";
+	for (size_t i = 0; i < extension.size(); i++)
+	{
+		extension[i] = (char)tolower((unsigned char)extension[i]);
+	}
+
+	if (record != NULL)
+	{
+		ImportProfiler::Begin(record);
+	}
+	bool succeeded = preset.nativeOBJ && extension == "obj" && ImportOBJ(filePath, meshDataList, readMilliseconds);
+	if (!succeeded)
+	{
+		// Assimp only times its steps when asked to
+		importer.SetPropertyBool(AI_CONFIG_GLOB_MEASURE_TIME, record != NULL && ImportProfiler::IsEnabled());
+		succeeded = ImportAssimp(filePath, preset.postProcessFlags, meshDataList, readMilliseconds);
+	}
+	if (record == NULL)
+	{
+		return succeeded;
+	}
+	ImportProfiler::End();
+
+	record->filePath = filePath;
+	record->preset = preset.name;
+	record->succeeded = succeeded;
+	record->totalMilliseconds = MillisecondsSince(start);
+	record->readMilliseconds = readMilliseconds;
+	record->finishMilliseconds = finishMilliseconds;
+	record->convertMilliseconds = record->totalMilliseconds - readMilliseconds - finishMilliseconds;
+	record->meshCount = meshDataList.size() - firstMesh;
+	record->vertexCount = 0;
+	record->indexCount = 0;
+	for (size_t i = firstMesh; i < meshDataList.size(); i++)
+	{
+		record->vertexCount += meshDataList[i].vertices.size() / VertexFormat::FLOATS_PER_VERTEX;
+		record->indexCount += meshDataList[i].indices.size();
+	}
+	return succeeded;
+}
+
+bool ModelImporter::ImportAssimp(const std::string& filePath, unsigned int postProcessFlags, std::vector<MeshData>& meshDataList, double& readMilliseconds)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const aiScene* scene = importer.ReadFile(filePath, postProcessFlags);
+	readMilliseconds = MillisecondsSince(start);
+	if (!scene)
+	{
+		printf("Model (%s) failed to load: %s\n", filePath.c_str(), importer.GetErrorString());
+		ioSystem->ReleaseFiles();
+		return false;
+	}
+
+	LoadNode(scene->mRootNode, scene, meshDataList);
+	importer.FreeScene();
+	ioSystem->ReleaseFiles();
+	return true;
+}
+
+bool ModelImporter::Cook(const std::string& filePath, uint64_t sourceHash, std::vector<MeshData>& meshDataList)
+{
+	if (!Import(filePath, meshDataList, GetPreset(filePath), NULL))
+	{
+		return false;
+	}
+
+	MeshCache::Write(MeshCache::GetCacheLocation(filePath), sourceHash, meshDataList);
+	return true;
+}
+
+bool ModelImporter::ImportOBJ(const std::string& filePath, std::vector<MeshData>& meshDataList, double& readMilliseconds)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool loaded = objLoader.LoadOBJ(filePath);
+	readMilliseconds = MillisecondsSince(start);
+	if (!loaded)
+	{
+		objLoader.Clear();
+		return false;
+	}
+
+	// A mesh per material, like Assimp's OBJ importer
+	const std::vector<std::string>& materials = objLoader.GetMaterials();
+	for (unsigned int i = 0; i < materials.size(); i++)
+	{
+		meshDataList.push_back(MeshData());
+		objLoader.BuildMeshData(i, meshDataList.back());
+		FinishMesh(meshDataList.back(), materials[i].empty() ? filePath.c_str() : materials[i].c_str());
+	}
+
+	objLoader.Clear();
+	return true;
+}
+
+void ModelImporter::LoadNode(aiNode* node, const aiScene* scene, std::vector<MeshData>& meshDataList)
+{
+	for (size_t i = 0; i < node->mNumMeshes; i++)
+	{
+		LoadMesh(scene->mMeshes[node->mMeshes[i]], scene, meshDataList);
+	}
+
+	for (size_t i = 0; i < node->mNumChildren; i++)
+	{
+		LoadNode(node->mChildren[i], scene, meshDataList);
+	}
+}
+
+void ModelImporter::LoadMesh(aiMesh* mesh, const aiScene* scene, std::vector<MeshData>& meshDataList)
+{
+	meshDataList.push_back(MeshData());
+	std::vector<GLfloat>& vertices = meshDataList.back().vertices;
+	std::vector<unsigned int>& indices = meshDataList.back().indices;
+
+	// Sized once, every element below is written in place
+	vertices.resize((size_t)mesh->mNumVertices * VertexFormat::FLOATS_PER_VERTEX);
+	if (mesh->mNumVertices > 0)
+	{
+		InterleaveVertices(mesh, &vertices[0]);
+	}
+
+	// Triangulate leaves points and lines as they are, they can't be drawn with the triangles
+	size_t triangleCount = 0;
+	if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+	{
+		triangleCount = mesh->mNumFaces;
+	}
+	else
+	{
+		for (size_t i = 0; i < mesh->mNumFaces; i++)
+		{
+			triangleCount += mesh->mFaces[i].mNumIndices == 3 ? 1 : 0;
+		}
+	}
+
+	indices.resize(triangleCount * 3);
+	unsigned int* index = indices.empty() ? NULL : &indices[0];
+	for (size_t i = 0; i < mesh->mNumFaces; i++)
+	{
+		const aiFace& face = mesh->mFaces[i];
+		if (face.mNumIndices == 3)
+		{
+			index[0] = face.mIndices[0];
+			index[1] = face.mIndices[1];
+			index[2] = face.mIndices[2];
+			index += 3;
+		}
+	}
+
+	FinishMesh(meshDataList.back(), mesh->mName.C_Str());
+}
+
+void ModelImporter::InterleaveVertices(const aiMesh* mesh, GLfloat* output)
+{
+	// Missing streams are read from a zero vector with no stride, so the loops don't branch on them
+	static const float zeros[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const float* positions = &mesh->mVertices[0].x;
+	const float* texCoords = mesh->HasTextureCoords(0) ? &mesh->mTextureCoords[0][0].x : zeros;
+	const float* normals = mesh->HasNormals() ? &mesh->mNormals[0].x : zeros;
+	size_t texCoordStride = mesh->HasTextureCoords(0) ? 3 : 0;
+	size_t normalStride = mesh->HasNormals() ? 3 : 0;
+
+	size_t vertexCount = mesh->mNumVertices;
+	size_t i = 0;
+#ifdef IMPORTER_USE_SSE
+	// Each load takes four floats from a three float stream, the last vertex is left to
+	// the scalar loop so it doesn't read past the end
+	for (; i + 1 < vertexCount; i++)
+	{
+		__m128 position = _mm_loadu_ps(positions + i * 3);
+		__m128 texCoord = _mm_loadu_ps(texCoords + i * texCoordStride);
+		__m128 normal = _mm_loadu_ps(normals + i * normalStride);
+
+		// x y z u
+		__m128 uuzz = _mm_shuffle_ps(texCoord, position, _MM_SHUFFLE(2, 2, 0, 0));
+		_mm_storeu_ps(output, _mm_shuffle_ps(position, uuzz, _MM_SHUFFLE(0, 2, 1, 0)));
+		// v nx ny nz
+		__m128 vvnn = _mm_shuffle_ps(texCoord, normal, _MM_SHUFFLE(0, 0, 1, 1));
+		_mm_storeu_ps(output + 4, _mm_shuffle_ps(vvnn, normal, _MM_SHUFFLE(2, 1, 2, 0)));
+
+		output += VertexFormat::FLOATS_PER_VERTEX;
+	}
+#endif
+
+	for (; i < vertexCount; i++)
+	{
+		output[0] = positions[i * 3];
+		output[1] = positions[i * 3 + 1];
+		output[2] = positions[i * 3 + 2];
+		output[3] = texCoords[i * texCoordStride];
+		output[4] = texCoords[i * texCoordStride + 1];
+		output[5] = normals[i * normalStride];
+		output[6] = normals[i * normalStride + 1];
+		output[7] = normals[i * normalStride + 2];
+		output += VertexFormat::FLOATS_PER_VERTEX;
+	}
+}
+
+void ModelImporter::FinishMesh(MeshData& meshData, const char* name)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	MeshOptimizer::Optimize(meshData, name);
+	// The coarser levels go after the optimized full mesh and share its vertices
+	MeshSimplifier::GenerateLods(meshData, name);
+
+	// Dense meshes go to the GPU at half the size when their range allows it
+	if (!meshData.vertices.empty())
+	{
+		meshData.format = VertexFormat::Choose(&meshData.vertices[0], (unsigned int)(meshData.vertices.size() / VertexFormat::FLOATS_PER_VERTEX));
+	}
+	finishMilliseconds += MillisecondsSince(start);
+}
+
+ModelImporter::~ModelImporter()
+{
+}
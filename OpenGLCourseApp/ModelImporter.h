@@ -0,0 +1,77 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "ImportProfiler.h"
+#include "MappedIOSystem.h"
+#include "MeshData.h"
+#include "Model.h"
+
+// Turns a model file into MeshData on the CPU, no GL calls, so it can run on any thread.
+// Keeps its Assimp::Importer between calls, use one ModelImporter per thread.
+// OBJ files go through the native OBJLoader, Assimp is kept for other formats and for OBJ files it can't read.
+// Assimp reads files through a MappedIOSystem, memory mapped rather than read with stdio.
+// How a file is read is picked per asset from PRESETS, see LoadPresets.
+class ModelImporter
+{
+public:
+	struct ImportPreset
+	{
+		const char* name;
+		// Assimp post-process steps, also used when the native OBJ import fails
+		unsigned int postProcessFlags;
+		bool nativeOBJ;
+	};
+
+	// "native" is the default. "assimp-indexed" skips JoinIdenticalVertices for meshes that are
+	// already indexed, "assimp-cache" adds ImproveCacheLocality and GenBoundingBoxes
+	static const ImportPreset PRESETS[];
+	static const unsigned int PRESET_COUNT = 4;
+
+	// NULL for an unknown name
+	static const ImportPreset* FindPreset(const std::string& name);
+	static const ImportPreset& GetPreset(const std::string& filePath);
+	// "<model file> <preset name>" lines, as printed by "--import-report". Call before any import starts
+	static bool LoadPresets(const std::string& fileLocation);
+	// MeshCache::HashFile of the model mixed with its preset, so the .tmesh is cooked again when
+	// either changes. 0 when the file is missing, like HashFile
+	static uint64_t HashSource(const std::string& filePath);
+
+	ModelImporter();
+
+	bool Import(const std::string& filePath, std::vector<MeshData>& meshDataList);
+	// Fills in record when it isn't NULL, with Assimp's step timings when ImportProfiler is enabled
+	bool Import(const std::string& filePath, std::vector<MeshData>& meshDataList, const ImportPreset& preset, ImportProfiler::Record* record);
+
+	// Import and write the result to the model's .tmesh cache
+	bool Cook(const std::string& filePath, uint64_t sourceHash, std::vector<MeshData>& meshDataList);
+
+	~ModelImporter();
+
+private:
+	Assimp::Importer importer;
+	// Owned by importer
+	MappedIOSystem* ioSystem;
+	OBJLoader objLoader;
+	// Time spent in FinishMesh during the current import
+	double finishMilliseconds;
+
+	static std::map<std::string, const ImportPreset*> assetPresets;
+
+	bool ImportOBJ(const std::string& filePath, std::vector<MeshData>& meshDataList, double& readMilliseconds);
+	bool ImportAssimp(const std::string& filePath, unsigned int postProcessFlags, std::vector<MeshData>& meshDataList, double& readMilliseconds);
+
+	void LoadNode(aiNode* node, const aiScene* scene, std::vector<MeshData>& meshDataList);
+	void LoadMesh(aiMesh* mesh, const aiScene* scene, std::vector<MeshData>& meshDataList);
+	// Writes mNumVertices vertices in the MeshData layout, missing uvs and normals become 0
+	static void InterleaveVertices(const aiMesh* mesh, GLfloat* output);
+	// Optimization, LODs and vertex format, the same for every importer
+	void FinishMesh(MeshData& meshData, const char* name);
+};
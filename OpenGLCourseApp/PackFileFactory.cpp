@@ -0,0 +1,68 @@
+#include "PackFileFactory.h"
+
+#include <string.h>
+
+PackFileReader::PackFileReader(AssetPack* pack, const std::string& fileLocation)
+{
+	fileName = fileLocation;
+	data = NULL;
+	size = 0;
+	position = 0;
+
+	size_t storedSize = 0;
+	valid = pack->GetStoredData(fileLocation, data, storedSize);
+	if (!valid && pack->Read(fileLocation, unpacked))
+	{
+		data = unpacked.empty() ? NULL : &unpacked[0];
+		storedSize = unpacked.size();
+		valid = true;
+	}
+
+	// irrKlang addresses files with 32-bit offsets
+	if (storedSize > 0x7FFFFFFF)
+	{
+		valid = false;
+	}
+	size = valid ? (irrklang::ik_s32)storedSize : 0;
+}
+
+irrklang::ik_s32 PackFileReader::read(void* buffer, irrklang::ik_u32 sizeToRead)
+{
+	irrklang::ik_u32 remaining = (irrklang::ik_u32)(size - position);
+	irrklang::ik_u32 count = sizeToRead < remaining ? sizeToRead : remaining;
+	if (count > 0)
+	{
+		memcpy(buffer, data + position, count);
+		position += (irrklang::ik_s32)count;
+	}
+	return (irrklang::ik_s32)count;
+}
+
+bool PackFileReader::seek(irrklang::ik_s32 finalPos, bool relativeMovement)
+{
+	irrklang::ik_s32 target = relativeMovement ? position + finalPos : finalPos;
+	if (target < 0 || target > size)
+	{
+		return false;
+	}
+
+	position = target;
+	return true;
+}
+
+irrklang::IFileReader* PackFileFactory::createFileReader(const irrklang::ik_c8* filename)
+{
+	AssetPack* pack = AssetPack::GetMounted();
+	if (pack == NULL || !pack->Contains(filename))
+	{
+		return NULL;
+	}
+
+	PackFileReader* reader = new PackFileReader(pack, filename);
+	if (!reader->IsValid())
+	{
+		reader->drop();
+		return NULL;
+	}
+	return reader;
+}
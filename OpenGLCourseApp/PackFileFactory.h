@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <irrKlang.h>
+
+#include "AssetPack.h"
+
+// Reads one file out of the mounted AssetPack for irrKlang. Stored files are read straight
+// from the pack's mapping, compressed ones are unpacked once when the reader is created.
+class PackFileReader : public irrklang::IFileReader
+{
+public:
+	PackFileReader(AssetPack* pack, const std::string& fileLocation);
+
+	bool IsValid() { return valid; }
+
+	irrklang::ik_s32 read(void* buffer, irrklang::ik_u32 sizeToRead) override;
+	bool seek(irrklang::ik_s32 finalPos, bool relativeMovement = false) override;
+	irrklang::ik_s32 getSize() override { return size; }
+	irrklang::ik_s32 getPos() override { return position; }
+	const irrklang::ik_c8* getFileName() override { return fileName.c_str(); }
+
+private:
+	std::string fileName;
+	std::vector<unsigned char> unpacked;
+	const unsigned char* data;
+	irrklang::ik_s32 size;
+	irrklang::ik_s32 position;
+	bool valid;
+};
+
+// Lets irrKlang open sounds from the mounted AssetPack, see ISoundEngine::addFileFactory.
+// Files that aren't in the pack are left to irrKlang's own file access.
+class PackFileFactory : public irrklang::IFileFactory
+{
+public:
+	irrklang::IFileReader* createFileReader(const irrklang::ik_c8* filename) override;
+};
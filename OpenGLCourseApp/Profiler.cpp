@@ -0,0 +1,361 @@
+#include "Profiler.h"
+
+#include <chrono>
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+
+#include "imgui.h"
+
+// Weight of the newest sample in the rolling zone averages
+static const float AVERAGE_WEIGHT = 0.05f;
+
+Profiler::Profiler()
+{
+	memset(frames, 0, sizeof(frames));
+	frameIndex = 0;
+	openZoneCount = 0;
+	overflowZoneCount = 0;
+
+	memset(frameHistory, 0, sizeof(frameHistory));
+	historyIndex = 0;
+	lastFrameStart = 0.0;
+	droppedFrames = 0;
+
+	captureFramesLeft = 0;
+	capturePending = false;
+
+	created = false;
+}
+
+void Profiler::Create()
+{
+	for (unsigned int i = 0; i < QUERY_LATENCY; i++)
+	{
+		glGenQueries(MAX_ZONES_PER_FRAME * 2, frames[i].queries);
+	}
+
+	created = true;
+	lastFrameStart = GetMicroseconds();
+}
+
+double Profiler::GetMicroseconds()
+{
+	static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned int Profiler::FindZone(const char* name)
+{
+	// Zone names are string literals, compare the pointer first and the text only on a miss
+	for (size_t i = 0; i < zoneStats.size(); i++)
+	{
+		if (zoneStats[i].name == name || strcmp(zoneStats[i].name, name) == 0)
+		{
+			return (unsigned int)i;
+		}
+	}
+
+	if (zoneStats.size() >= MAX_ZONES)
+	{
+		return MAX_ZONES;
+	}
+
+	ZoneStats stats;
+	stats.name = name;
+	stats.cpuMilliseconds = 0.0f;
+	stats.gpuMilliseconds = 0.0f;
+	stats.cpuTotal = 0.0;
+	stats.gpuTotal = 0.0;
+	stats.cpuSamples = 0;
+	stats.gpuSamples = 0;
+	zoneStats.push_back(stats);
+	return (unsigned int)zoneStats.size() - 1;
+}
+
+void Profiler::BeginFrame()
+{
+	if (!created)
+	{
+		return;
+	}
+
+	double now = GetMicroseconds();
+	frameHistory[historyIndex] = (float)((now - lastFrameStart) / 1000.0);
+	historyIndex = (historyIndex + 1) % HISTORY_SIZE;
+	lastFrameStart = now;
+
+	openZoneCount = 0;
+	overflowZoneCount = 0;
+
+	if (captureFramesLeft > 0)
+	{
+		captureFramesLeft--;
+	}
+
+	frameIndex++;
+	FrameRecord& frame = frames[frameIndex % QUERY_LATENCY];
+
+	// This slot was last used QUERY_LATENCY frames ago, its timestamps are normally done by now
+	if (frame.pending)
+	{
+		ResolveFrame(frame);
+	}
+
+	if (capturePending && captureFramesLeft == 0)
+	{
+		bool waiting = false;
+		for (unsigned int i = 0; i < QUERY_LATENCY; i++)
+		{
+			waiting = waiting || (frames[i].pending && frames[i].capture);
+		}
+
+		if (!waiting)
+		{
+			WriteCapture();
+		}
+	}
+
+	frame.zoneCount = 0;
+	frame.lastQuery = 0;
+	frame.pending = false;
+	frame.capture = captureFramesLeft > 0;
+	if (frame.capture)
+	{
+		glGetInteger64v(GL_TIMESTAMP, &frame.gpuReference);
+		frame.cpuReference = GetMicroseconds();
+	}
+}
+
+void Profiler::BeginZone(const char* name)
+{
+	if (!created)
+	{
+		return;
+	}
+
+	FrameRecord& frame = frames[frameIndex % QUERY_LATENCY];
+	if (openZoneCount == MAX_ZONES_PER_FRAME)
+	{
+		overflowZoneCount++;
+		return;
+	}
+
+	unsigned int zone = FindZone(name);
+	if (zone == MAX_ZONES || frame.zoneCount == MAX_ZONES_PER_FRAME)
+	{
+		openZones[openZoneCount++] = UNOPENED_ZONE;
+		return;
+	}
+
+	ZoneRecord& record = frame.zones[frame.zoneCount];
+	record.zone = zone;
+	record.cpuStart = GetMicroseconds();
+	record.cpuEnd = record.cpuStart;
+
+	glQueryCounter(frame.queries[frame.zoneCount * 2], GL_TIMESTAMP);
+	frame.lastQuery = frame.zoneCount * 2;
+
+	openZones[openZoneCount++] = frame.zoneCount;
+	frame.zoneCount++;
+}
+
+void Profiler::EndZone()
+{
+	if (!created || openZoneCount == 0)
+	{
+		return;
+	}
+
+	if (overflowZoneCount > 0)
+	{
+		overflowZoneCount--;
+		return;
+	}
+
+	FrameRecord& frame = frames[frameIndex % QUERY_LATENCY];
+	unsigned int index = openZones[--openZoneCount];
+	if (index == UNOPENED_ZONE)
+	{
+		return;
+	}
+	ZoneRecord& record = frame.zones[index];
+
+	glQueryCounter(frame.queries[index * 2 + 1], GL_TIMESTAMP);
+	frame.lastQuery = index * 2 + 1;
+	record.cpuEnd = GetMicroseconds();
+	frame.pending = true;
+
+	ZoneStats& stats = zoneStats[record.zone];
+	float cpuMilliseconds = (float)((record.cpuEnd - record.cpuStart) / 1000.0);
+	stats.cpuMilliseconds += (cpuMilliseconds - stats.cpuMilliseconds) * AVERAGE_WEIGHT;
+	stats.cpuTotal += cpuMilliseconds;
+	stats.cpuSamples++;
+
+	if (frame.capture)
+	{
+		TraceEvent event;
+		event.name = stats.name;
+		event.gpu = false;
+		event.start = record.cpuStart;
+		event.duration = record.cpuEnd - record.cpuStart;
+		traceEvents.push_back(event);
+	}
+}
+
+void Profiler::ResolveFrame(FrameRecord& frame)
+{
+	frame.pending = false;
+	if (frame.zoneCount == 0)
+	{
+		return;
+	}
+
+	// Timestamps complete in the order they were issued, if the last one is ready they all are
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[frame.lastQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+	{
+		droppedFrames++;
+		return;
+	}
+
+	for (unsigned int i = 0; i < frame.zoneCount; i++)
+	{
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+		ZoneStats& stats = zoneStats[frame.zones[i].zone];
+		float gpuMilliseconds = (float)((end - start) / 1000000.0);
+		stats.gpuMilliseconds += (gpuMilliseconds - stats.gpuMilliseconds) * AVERAGE_WEIGHT;
+		stats.gpuTotal += gpuMilliseconds;
+		stats.gpuSamples++;
+
+		if (frame.capture)
+		{
+			TraceEvent event;
+			event.name = stats.name;
+			event.gpu = true;
+			event.start = frame.cpuReference + (double)((GLint64)start - frame.gpuReference) / 1000.0;
+			event.duration = (end - start) / 1000.0;
+			traceEvents.push_back(event);
+		}
+	}
+}
+
+void Profiler::DrawOverlay()
+{
+	float average = 0.0f, worst = 0.0f;
+	for (unsigned int i = 0; i < HISTORY_SIZE; i++)
+	{
+		average += frameHistory[i];
+		if (frameHistory[i] > worst)
+		{
+			worst = frameHistory[i];
+		}
+	}
+	average /= HISTORY_SIZE;
+
+	char overlay[64];
+	snprintf(overlay, sizeof(overlay), "avg %.2f ms, max %.2f ms", average, worst);
+	ImGui::PlotHistogram("Frame time", frameHistory, HISTORY_SIZE, historyIndex, overlay, 0.0f, worst > 0.0f ? worst : 1.0f, ImVec2(0.0f, 60.0f));
+
+	for (size_t i = 0; i < zoneStats.size(); i++)
+	{
+		ImGui::Text("%-8s CPU %6.3f ms  GPU %6.3f ms", zoneStats[i].name, zoneStats[i].cpuMilliseconds, zoneStats[i].gpuMilliseconds);
+	}
+
+	if (droppedFrames > 0)
+	{
+		ImGui::Text("GPU timings not ready: %u frames", droppedFrames);
+	}
+}
+
+void Profiler::ResetTotals()
+{
+	for (size_t i = 0; i < zoneStats.size(); i++)
+	{
+		zoneStats[i].cpuTotal = 0.0;
+		zoneStats[i].gpuTotal = 0.0;
+		zoneStats[i].cpuSamples = 0;
+		zoneStats[i].gpuSamples = 0;
+	}
+}
+
+double Profiler::GetMeanCpuMilliseconds(unsigned int zone)
+{
+	const ZoneStats& stats = zoneStats[zone];
+	return stats.cpuSamples > 0 ? stats.cpuTotal / stats.cpuSamples : 0.0;
+}
+
+double Profiler::GetMeanGpuMilliseconds(unsigned int zone)
+{
+	const ZoneStats& stats = zoneStats[zone];
+	return stats.gpuSamples > 0 ? stats.gpuTotal / stats.gpuSamples : 0.0;
+}
+
+void Profiler::RequestCapture(unsigned int frameCount, const std::string& fileLocation)
+{
+	if (IsCapturing())
+	{
+		return;
+	}
+
+	traceEvents.clear();
+	captureLocation = fileLocation;
+	captureFramesLeft = frameCount + 1;
+	capturePending = true;
+}
+
+void Profiler::WriteCapture()
+{
+	capturePending = false;
+
+	std::ofstream fileStream(captureLocation.c_str(), std::ios::out | std::ios::trunc);
+	if (!fileStream.is_open())
+	{
+		printf("Failed to write trace %s!\n", captureLocation.c_str());
+		return;
+	}
+
+	// Complete ("X") events, CPU zones on thread 1 and GPU zones on thread 2
+	fileStream << "{\"traceEvents\":[\n";
+	for (size_t i = 0; i < traceEvents.size(); i++)
+	{
+		const TraceEvent& event = traceEvents[i];
+		char line[256];
+		snprintf(line, sizeof(line), "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+			event.name, event.gpu ? "GPU" : "CPU", event.gpu ? 2 : 1, event.start, event.duration, i + 1 < traceEvents.size() ? "," : "");
+		fileStream << line;
+	}
+	fileStream << "],\n\"displayTimeUnit\":\"ms\"}\n";
+
+	printf("Wrote %u trace events to %s\n", (unsigned int)traceEvents.size(), captureLocation.c_str());
+	traceEvents.clear();
+}
+
+void Profiler::Clear()
+{
+	if (created)
+	{
+		for (unsigned int i = 0; i < QUERY_LATENCY; i++)
+		{
+			glDeleteQueries(MAX_ZONES_PER_FRAME * 2, frames[i].queries);
+		}
+	}
+
+	memset(frames, 0, sizeof(frames));
+	zoneStats.clear();
+	traceEvents.clear();
+	openZoneCount = 0;
+	overflowZoneCount = 0;
+	captureFramesLeft = 0;
+	capturePending = false;
+	created = false;
+}
+
+Profiler::~Profiler()
+{
+	Clear();
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <GL\glew.h>
+
+// CPU and GPU timings per named zone. GPU zones are timestamp queries read back QUERY_LATENCY frames
+// later, and only if the driver already has the result, so profiling never stalls the pipeline.
+class Profiler
+{
+public:
+	static const unsigned int MAX_ZONES = 32;
+	static const unsigned int MAX_ZONES_PER_FRAME = 64;
+	static const unsigned int QUERY_LATENCY = 2;
+	static const unsigned int HISTORY_SIZE = 120;
+
+	Profiler();
+
+	void Create();
+
+	void BeginFrame();
+	void BeginZone(const char* name);
+	void EndZone();
+
+	// Rolling zone timings and a frame time histogram, call inside an ImGui window
+	void DrawOverlay();
+
+	// Records the next frameCount frames and writes them as chrome://tracing JSON
+	void RequestCapture(unsigned int frameCount, const std::string& fileLocation);
+	bool IsCapturing() { return captureFramesLeft > 0 || capturePending; }
+
+	// Plain means since the last ResetTotals, for benchmark reports
+	void ResetTotals();
+	unsigned int GetZoneCount() { return (unsigned int)zoneStats.size(); }
+	const char* GetZoneName(unsigned int zone) { return zoneStats[zone].name; }
+	double GetMeanCpuMilliseconds(unsigned int zone);
+	double GetMeanGpuMilliseconds(unsigned int zone);
+
+	void Clear();
+
+	~Profiler();
+
+private:
+	struct ZoneStats
+	{
+		const char* name;
+		float cpuMilliseconds;
+		float gpuMilliseconds;
+
+		double cpuTotal, gpuTotal;
+		unsigned int cpuSamples, gpuSamples;
+	};
+
+	struct ZoneRecord
+	{
+		unsigned int zone;
+		double cpuStart, cpuEnd;
+	};
+
+	// One frame worth of zones, its queries are reused QUERY_LATENCY frames later
+	struct FrameRecord
+	{
+		GLuint queries[MAX_ZONES_PER_FRAME * 2];
+		ZoneRecord zones[MAX_ZONES_PER_FRAME];
+		unsigned int zoneCount;
+		// Index in queries of the timestamp issued last, nested zones end out of index order
+		unsigned int lastQuery;
+		bool pending;
+		bool capture;
+
+		// CPU microseconds at the GPU timestamp gpuReference, used to line GPU zones up in a capture
+		double cpuReference;
+		GLint64 gpuReference;
+	};
+
+	struct TraceEvent
+	{
+		const char* name;
+		bool gpu;
+		double start, duration;
+	};
+
+	std::vector<ZoneStats> zoneStats;
+	FrameRecord frames[QUERY_LATENCY];
+	unsigned int frameIndex;
+
+	// Zones dropped for lack of room are kept as UNOPENED_ZONE so their EndZone closes nothing,
+	// past the depth of openZones they are only counted
+	static const unsigned int UNOPENED_ZONE = MAX_ZONES_PER_FRAME;
+	unsigned int openZones[MAX_ZONES_PER_FRAME];
+	unsigned int openZoneCount;
+	unsigned int overflowZoneCount;
+
+	float frameHistory[HISTORY_SIZE];
+	unsigned int historyIndex;
+	double lastFrameStart;
+	unsigned int droppedFrames;
+
+	std::vector<TraceEvent> traceEvents;
+	std::string captureLocation;
+	unsigned int captureFramesLeft;
+	bool capturePending;
+
+	bool created;
+
+	unsigned int FindZone(const char* name);
+	void ResolveFrame(FrameRecord& frame);
+	void WriteCapture();
+
+	static double GetMicroseconds();
+};
+
+// Times the enclosing scope as one zone
+class ProfileZone
+{
+public:
+	ProfileZone(Profiler& profiler, const char* name) : profiler(profiler) { profiler.BeginZone(name); }
+	~ProfileZone() { profiler.EndZone(); }
+
+private:
+	Profiler& profiler;
+};
@@ -0,0 +1,120 @@
+#include "ProgramCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <vector>
+
+#include "MappedFile.h"
+
+const char* ProgramCache::CACHE_DIRECTORY = "Shaders/";
+
+static const char GLPROG_MAGIC[4] = { 'G', 'L', 'P', 'B' };
+
+static void HashString(uint64_t& hash, const char* text)
+{
+	// 64-bit FNV-1a, the terminator goes in as well so "ab" + "c" and "a" + "bc" differ
+	const unsigned char* data = (const unsigned char*)(text != NULL ? text : "");
+	do
+	{
+		hash ^= *data;
+		hash *= 1099511628211ULL;
+	} while (*data++ != 0);
+}
+
+bool ProgramCache::IsSupported()
+{
+	if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+	{
+		return false;
+	}
+
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	return formatCount > 0;
+}
+
+uint64_t ProgramCache::HashSources(const char* vertexCode, const char* fragmentCode)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	HashString(hash, (const char*)glGetString(GL_VENDOR));
+	HashString(hash, (const char*)glGetString(GL_RENDERER));
+	HashString(hash, (const char*)glGetString(GL_VERSION));
+	HashString(hash, vertexCode);
+	HashString(hash, fragmentCode);
+
+	return hash != 0 ? hash : 1;
+}
+
+std::string ProgramCache::GetCacheLocation(uint64_t key)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "program_%016llx.glprog", (unsigned long long)key);
+	return std::string(CACHE_DIRECTORY) + name;
+}
+
+bool ProgramCache::Load(GLuint program, uint64_t key)
+{
+	MappedFile file;
+	if (!file.Open(GetCacheLocation(key)))
+	{
+		return false;
+	}
+
+	if (file.GetSize() < sizeof(Header))
+	{
+		return false;
+	}
+
+	const Header* header = (const Header*)file.GetData();
+	if (memcmp(header->magic, GLPROG_MAGIC, 4) != 0 || header->version != VERSION || header->key != key ||
+		sizeof(Header) + (size_t)header->binaryLength > file.GetSize())
+	{
+		return false;
+	}
+
+	glProgramBinary(program, header->binaryFormat, file.GetData() + sizeof(Header), header->binaryLength);
+
+	GLint result = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &result);
+	if (!result)
+	{
+		printf("Cached program %s was rejected by the driver, compiling from source\n", GetCacheLocation(key).c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool ProgramCache::Save(GLuint program, uint64_t key)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	{
+		return false;
+	}
+
+	std::vector<unsigned char> binary(length);
+	GLenum binaryFormat = 0;
+	glGetProgramBinary(program, length, &length, &binaryFormat, &binary[0]);
+
+	Header header;
+	memcpy(header.magic, GLPROG_MAGIC, 4);
+	header.version = VERSION;
+	header.key = key;
+	header.binaryFormat = binaryFormat;
+	header.binaryLength = (uint32_t)length;
+
+	std::string cacheLocation = GetCacheLocation(key);
+	std::ofstream fileStream(cacheLocation.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fileStream.is_open())
+	{
+		printf("Failed to write program cache %s\n", cacheLocation.c_str());
+		return false;
+	}
+
+	fileStream.write((const char*)&header, sizeof(header));
+	fileStream.write((const char*)&binary[0], length);
+	return fileStream.good();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+#include <GL\glew.h>
+
+// Linked programs saved with glGetProgramBinary, one .glprog file per program named after
+// a hash of its sources and the driver. A hit skips compiling, linking and validating.
+// Drivers are free to reject a binary they wrote themselves, callers compile from source then.
+class ProgramCache
+{
+public:
+	static const uint32_t VERSION = 1;
+	static const char* CACHE_DIRECTORY;
+
+	// Needs GL 4.1 or ARB_get_program_binary and at least one binary format
+	static bool IsSupported();
+
+	// Sources plus GL_VENDOR, GL_RENDERER and GL_VERSION, so a driver update misses the cache.
+	// Permutation defines are part of the sources, so they are covered too
+	static uint64_t HashSources(const char* vertexCode, const char* fragmentCode);
+	static std::string GetCacheLocation(uint64_t key);
+
+	// Returns true when program is linked from the cached binary
+	static bool Load(GLuint program, uint64_t key);
+	// program must be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	static bool Save(GLuint program, uint64_t key);
+
+private:
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t binaryFormat;
+		uint32_t binaryLength;
+	};
+};
@@ -0,0 +1,168 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+#include <glm\gtc\matrix_inverse.hpp>
+#include <glm\gtc\type_ptr.hpp>
+
+static const float MAX_SORT_DEPTH = 1000.0f;
+
+RenderQueue::RenderQueue()
+{
+	viewMatrix = glm::mat4(1.0f);
+	cullFrustum = NULL;
+	culledCount = 0;
+}
+
+void RenderQueue::Begin(const glm::mat4& view, const Frustum* frustum)
+{
+	packets.clear();
+	boxes.Clear();
+	boxPackets.clear();
+	viewMatrix = view;
+	cullFrustum = frustum;
+	culledCount = 0;
+}
+
+uint64_t RenderQueue::GetSortID(std::map<GLuint, uint64_t>& ids, GLuint name)
+{
+	std::map<GLuint, uint64_t>::iterator it = ids.find(name);
+	if (it == ids.end())
+	{
+		it = ids.insert(std::make_pair(name, (uint64_t)ids.size())).first;
+	}
+	return it->second;
+}
+
+uint64_t RenderQueue::MakeKey(GLuint shader, GLuint texture, GLuint vertexArray, float depth)
+{
+	// Front to back inside a state group, so early depth testing rejects more fragments
+	float clamped = std::min(std::max(depth, 0.0f), MAX_SORT_DEPTH);
+	uint64_t quantisedDepth = (uint64_t)(clamped / MAX_SORT_DEPTH * 0xFFFFFF);
+
+	// Only past 256 programs or 65536 textures or VAOs would two IDs share a field value
+	return ((GetSortID(shaderIDs, shader) & 0xFF) << 56) |
+		((GetSortID(textureIDs, texture) & 0xFFFF) << 40) |
+		((GetSortID(vertexArrayIDs, vertexArray) & 0xFFFF) << 24) |
+		quantisedDepth;
+}
+
+void RenderQueue::Submit(ShaderVariants* shaders, Texture* texture, Mesh* mesh, const glm::mat4& model)
+{
+	Shader* shader = shaders->Get(ShaderVariants::GetFeatures(mesh, texture, model));
+
+	RenderPacket packet;
+	packet.shader = shader;
+	packet.texture = texture;
+	packet.mesh = mesh;
+	packet.model = mesh->IsQuantized() ? model * mesh->GetDequantizeTransform() : model;
+	packet.instanceCount = 0;
+	packet.firstInstance = 0;
+	packet.lod = 0;
+	packet.culled = false;
+
+	float depth = -(viewMatrix * model[3]).z;
+	packet.key = MakeKey(shader->GetShaderID(), texture->GetBindID(), mesh->GetVAO(), depth);
+
+	if (cullFrustum != NULL)
+	{
+		glm::vec3 center, extent;
+		Frustum::TransformBox(model, mesh->GetBoundsMin(), mesh->GetBoundsMax(), center, extent);
+		boxes.Add(center, extent);
+		boxPackets.push_back(packets.size());
+	}
+
+	packets.push_back(packet);
+}
+
+void RenderQueue::SubmitInstanced(Shader* shader, Texture* texture, Mesh* mesh, GLsizei instanceCount)
+{
+	SubmitInstanced(shader, texture, mesh, instanceCount, 0, 0);
+}
+
+void RenderQueue::SubmitInstanced(Shader* shader, Texture* texture, Mesh* mesh, GLsizei instanceCount, unsigned int lod, GLsizei firstInstance)
+{
+	RenderPacket packet;
+	packet.shader = shader;
+	packet.texture = texture;
+	packet.mesh = mesh;
+	packet.model = glm::mat4(1.0f);
+	packet.instanceCount = instanceCount;
+	packet.firstInstance = firstInstance;
+	packet.lod = lod;
+	packet.culled = false;
+	packet.key = MakeKey(shader->GetShaderID(), texture->GetBindID(), mesh->GetVAO(), 0.0f);
+
+	packets.push_back(packet);
+}
+
+void RenderQueue::Flush(GLStateCache& stateCache)
+{
+	// Culled packets never reach the sort
+	if (cullFrustum != NULL)
+	{
+		culledCount = cullFrustum->CullBoxes(boxes, boxVisible);
+		for (size_t i = 0; i < boxPackets.size(); i++)
+		{
+			if (!boxVisible[i])
+			{
+				packets[boxPackets[i]].culled = true;
+			}
+		}
+	}
+
+	sortEntries.clear();
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		if (packets[i].culled)
+		{
+			continue;
+		}
+
+		SortEntry entry;
+		entry.key = packets[i].key;
+		entry.index = i;
+		sortEntries.push_back(entry);
+	}
+	std::sort(sortEntries.begin(), sortEntries.end());
+
+	for (size_t i = 0; i < sortEntries.size(); i++)
+	{
+		RenderPacket& packet = packets[sortEntries[i].index];
+
+		stateCache.UseProgram(packet.shader->GetShaderID());
+		packet.texture->BindTexture(stateCache);
+		stateCache.BindVertexArray(packet.mesh->GetVAO());
+
+		if (packet.instanceCount > 0)
+		{
+			packet.mesh->DrawInstanced(packet.instanceCount, packet.lod, packet.firstInstance);
+		}
+		else
+		{
+			glUniformMatrix4fv(packet.shader->GetModelLocation(), 1, GL_FALSE, glm::value_ptr(packet.model));
+			// Once per draw here instead of once per vertex in the shader
+			if (packet.shader->UsesNormalMatrix())
+			{
+				glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(packet.model));
+				glUniformMatrix3fv(packet.shader->GetNormalMatrixLocation(), 1, GL_FALSE, glm::value_ptr(normalMatrix));
+			}
+			if (packet.shader->UsesTextureLayer())
+			{
+				glUniform1f(packet.shader->GetTextureLayerLocation(), (GLfloat)packet.texture->GetArrayLayer());
+			}
+			packet.mesh->Draw(packet.lod);
+		}
+		stateCache.CountDraw();
+	}
+
+	// Leave GL the way the rest of the frame expects it
+	stateCache.BindVertexArray(0);
+	stateCache.UseProgram(0);
+
+	packets.clear();
+}
+
+RenderQueue::~RenderQueue()
+{
+}
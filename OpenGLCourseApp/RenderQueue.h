@@ -0,0 +1,82 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+
+#include "Frustum.h"
+#include "GLStateCache.h"
+#include "Mesh.h"
+#include "Shader.h"
+#include "ShaderVariants.h"
+#include "Texture.h"
+
+struct RenderPacket
+{
+	uint64_t key;
+	Shader* shader;
+	Texture* texture;
+	Mesh* mesh;
+	glm::mat4 model;
+	GLsizei instanceCount; // 0 for a plain draw using the model uniform
+	GLsizei firstInstance;
+	unsigned int lod;
+	bool culled;
+};
+
+// Draws are submitted during the frame and replayed sorted by a 64-bit key,
+// shader | texture | VAO | depth from most to least significant, so objects that
+// share state end up next to each other and the state cache can drop the rebinds.
+// The key holds small IDs handed out the first time each GL object is seen, GL names
+// are too sparse to fit the fields without colliding.
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	// Plain draws outside the frustum are dropped at Flush, pass NULL to draw everything
+	void Begin(const glm::mat4& view, const Frustum* frustum);
+	// Picks the variant of shaders that fits the mesh, texture and model matrix
+	void Submit(ShaderVariants* shaders, Texture* texture, Mesh* mesh, const glm::mat4& model);
+	void SubmitInstanced(Shader* shader, Texture* texture, Mesh* mesh, GLsizei instanceCount);
+	// Draws instances firstInstance to firstInstance + instanceCount of the mesh's instance buffer at one level of detail
+	void SubmitInstanced(Shader* shader, Texture* texture, Mesh* mesh, GLsizei instanceCount, unsigned int lod, GLsizei firstInstance);
+	void Flush(GLStateCache& stateCache);
+
+	size_t GetPacketCount() { return packets.size(); }
+	unsigned int GetCulledCount() { return culledCount; }
+
+	uint64_t MakeKey(GLuint shader, GLuint texture, GLuint vertexArray, float depth);
+
+	~RenderQueue();
+
+private:
+	struct SortEntry
+	{
+		uint64_t key;
+		size_t index;
+
+		bool operator<(const SortEntry& other) const { return key < other.key; }
+	};
+
+	// GL name to sort ID, kept for the queue's lifetime so the order is stable between frames
+	std::map<GLuint, uint64_t> shaderIDs;
+	std::map<GLuint, uint64_t> textureIDs;
+	std::map<GLuint, uint64_t> vertexArrayIDs;
+
+	static uint64_t GetSortID(std::map<GLuint, uint64_t>& ids, GLuint name);
+
+	std::vector<RenderPacket> packets;
+	std::vector<SortEntry> sortEntries;
+	glm::mat4 viewMatrix;
+
+	const Frustum* cullFrustum;
+	BoundingBoxList boxes;
+	std::vector<size_t> boxPackets;
+	std::vector<unsigned char> boxVisible;
+	unsigned int culledCount;
+};
@@ -0,0 +1,80 @@
+#include "SceneGraph.h"
+
+#include <stdio.h>
+
+SceneGraph::SceneGraph()
+{
+	updatedCount = 0;
+}
+
+int SceneGraph::AddNode(int parent, const glm::mat4& localTransform)
+{
+	int node = (int)parents.size();
+	if (parent >= node)
+	{
+		printf("Scene node %d added before its parent %d!\n", node, parent);
+		parent = NO_PARENT;
+	}
+
+	parents.push_back(parent);
+	localTransforms.push_back(localTransform);
+	worldTransforms.push_back(glm::mat4(1.0f));
+	dirty.push_back(1);
+	changed.push_back(0);
+
+	return node;
+}
+
+void SceneGraph::SetLocalTransform(int node, const glm::mat4& localTransform)
+{
+	localTransforms[node] = localTransform;
+	dirty[node] = 1;
+}
+
+void SceneGraph::UpdateTransforms()
+{
+	updatedCount = 0;
+
+	for (size_t i = 0; i < parents.size(); i++)
+	{
+		int parent = parents[i];
+		if (parent != NO_PARENT && changed[parent])
+		{
+			dirty[i] = 1;
+		}
+
+		if (!dirty[i])
+		{
+			changed[i] = 0;
+			continue;
+		}
+
+		if (parent == NO_PARENT)
+		{
+			worldTransforms[i] = localTransforms[i];
+		}
+		else
+		{
+			worldTransforms[i] = worldTransforms[parent] * localTransforms[i];
+		}
+
+		dirty[i] = 0;
+		changed[i] = 1;
+		updatedCount++;
+	}
+}
+
+void SceneGraph::Clear()
+{
+	parents.clear();
+	localTransforms.clear();
+	worldTransforms.clear();
+	dirty.clear();
+	changed.clear();
+	updatedCount = 0;
+}
+
+SceneGraph::~SceneGraph()
+{
+	Clear();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+
+#include <glm\glm.hpp>
+
+// Flat transform hierarchy. Nodes live in parallel arrays in the order they were added,
+// a parent is always added before its children, so one forward pass updates the whole tree.
+class SceneGraph
+{
+public:
+	static const int NO_PARENT = -1;
+
+	SceneGraph();
+
+	int AddNode(int parent, const glm::mat4& localTransform);
+
+	// Marks the node dirty, its world transform and its subtree are recomputed by the next UpdateTransforms
+	void SetLocalTransform(int node, const glm::mat4& localTransform);
+	void UpdateTransforms();
+
+	const glm::mat4& GetWorldTransform(int node) { return worldTransforms[node]; }
+	unsigned int GetNodeCount() { return (unsigned int)parents.size(); }
+	unsigned int GetUpdatedCount() { return updatedCount; }
+
+	void Clear();
+
+	~SceneGraph();
+
+private:
+	std::vector<int> parents;
+	std::vector<glm::mat4> localTransforms;
+	std::vector<glm::mat4> worldTransforms;
+
+	// dirty is set by SetLocalTransform, changed records which nodes moved in the current pass
+	std::vector<unsigned char> dirty;
+	std::vector<unsigned char> changed;
+
+	unsigned int updatedCount;
+};
@@ -1,10 +1,17 @@
 #include "Shader.h"
 
+#include "AssetPack.h"
+#include "FrameUniformBuffer.h"
+#include "LightClusters.h"
+#include "ProgramCache.h"
+#include "TextureArray.h"
+
 Shader::Shader()
 {
 	shaderID = 0;
 	uniformModel = 0;
-	uniformProjection = 0;
+	uniformNormalMatrix = (GLuint)-1;
+	uniformTextureLayer = (GLuint)-1;
 }
 
 void Shader::CreateFromString(const char* vertexCode, const char* fragmentCode)
@@ -24,19 +31,27 @@ void Shader::CreateFromFiles(const char* vertexLocation, const char* fragmentLoc
 
 std::string Shader::ReadFile(const char* fileLocation)
 {
-	std::string content;
-	std::ifstream fileStream(fileLocation, std::ios::in);
+	AssetPack* pack = AssetPack::GetMounted();
+	std::vector<unsigned char> packed;
+	if (pack != NULL && pack->Read(fileLocation, packed))
+	{
+		return std::string(packed.begin(), packed.end());
+	}
+
+	std::ifstream fileStream(fileLocation, std::ios::in | std::ios::binary);
 
 	if (!fileStream.is_open()) {
 		printf("Failed to read %s! File doesn't exist.", fileLocation);
 		return "";
 	}
 
-	std::string line = "";
-	while (!fileStream.eof())
+	// One read for the whole file, the source goes to the cache hash and the compiler as it is on disk
+	fileStream.seekg(0, std::ios::end);
+	std::string content((size_t)fileStream.tellg(), '\0');
+	fileStream.seekg(0, std::ios::beg);
+	if (!content.empty())
 	{
-		std::getline(fileStream, line);
-		content.append(line + "\n");
+		fileStream.read(&content[0], content.size());
 	}
 
 	fileStream.close();
@@ -53,6 +68,36 @@ void Shader::CompileShader(const char* vertexCode, const char* fragmentCode)
 		return;
 	}
 
+	// A cached binary skips compile, link and validate. If the driver rejects it the same
+	// program object is simply linked again from source
+	uint64_t cacheKey = 0;
+	if (ProgramCache::IsSupported())
+	{
+		cacheKey = ProgramCache::HashSources(vertexCode, fragmentCode);
+		if (ProgramCache::Load(shaderID, cacheKey))
+		{
+			GetLocations();
+			return;
+		}
+
+		glProgramParameteri(shaderID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	if (!LinkProgram(vertexCode, fragmentCode))
+	{
+		return;
+	}
+
+	if (cacheKey != 0)
+	{
+		ProgramCache::Save(shaderID, cacheKey);
+	}
+
+	GetLocations();
+}
+
+bool Shader::LinkProgram(const char* vertexCode, const char* fragmentCode)
+{
 	AddShader(shaderID, vertexCode, GL_VERTEX_SHADER);
 	AddShader(shaderID, fragmentCode, GL_FRAGMENT_SHADER);
 
@@ -65,7 +110,7 @@ void Shader::CompileShader(const char* vertexCode, const char* fragmentCode)
 	{
 		glGetProgramInfoLog(shaderID, sizeof(eLog), NULL, eLog);
 		printf("Error linking program: '%s'\n", eLog);
-		return;
+		return false;
 	}
 
 	glValidateProgram(shaderID);
@@ -74,57 +119,60 @@ void Shader::CompileShader(const char* vertexCode, const char* fragmentCode)
 	{
 		glGetProgramInfoLog(shaderID, sizeof(eLog), NULL, eLog);
 		printf("Error validating program: '%s'\n", eLog);
-		return;
+		return false;
 	}
 
-	uniformProjection = glGetUniformLocation(shaderID, "projection");
-	uniformModel = glGetUniformLocation(shaderID, "model");
-	uniformView = glGetUniformLocation(shaderID, "view");
-	uniformAmbientColour = glGetUniformLocation(shaderID, "directionalLight.colour");
-	uniformAmbientIntensity = glGetUniformLocation(shaderID, "directionalLight.ambientIntensity");
-	uniformLightDirection = glGetUniformLocation(shaderID, "directionalLight.direction");
-	uniformSpecularIntensity = glGetUniformLocation(shaderID, "directionalLight.specularIntensity");
-	uniformDiffuseIntensity = glGetUniformLocation(shaderID, "directionalLight.diffuseIntensity");
-	uniformCameraPos = glGetUniformLocation(shaderID, "cameraPos");
+	return true;
 }
 
-GLuint Shader::GetProjectionLocation()
+void Shader::GetLocations()
 {
-	return uniformProjection;
+	uniformModel = glGetUniformLocation(shaderID, "model");
+	uniformNormalMatrix = glGetUniformLocation(shaderID, "normalMatrix");
+	uniformTextureLayer = glGetUniformLocation(shaderID, "textureLayer");
+
+	// Sampler units never change, set them once. The program has to be current for that,
+	// put back whatever was bound so GLStateCache stays right
+	const char* samplerNames[] = { "theTextureArray", "lightData", "clusterLights", "lightIndices" };
+	const GLint samplerUnits[] = { TextureArray::TEXTURE_UNIT, LightClusters::LIGHT_DATA_UNIT, LightClusters::CLUSTER_UNIT, LightClusters::LIGHT_INDEX_UNIT };
+	GLint previousProgram = -1;
+	for (size_t i = 0; i < sizeof(samplerNames) / sizeof(samplerNames[0]); i++)
+	{
+		GLint sampler = glGetUniformLocation(shaderID, samplerNames[i]);
+		if (sampler == -1)
+		{
+			continue;
+		}
+
+		if (previousProgram == -1)
+		{
+			glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+			glUseProgram(shaderID);
+		}
+		glUniform1i(sampler, samplerUnits[i]);
+	}
+	if (previousProgram != -1)
+	{
+		glUseProgram(previousProgram);
+	}
+
+	GLuint frameBlock = glGetUniformBlockIndex(shaderID, "FrameData");
+	if (frameBlock != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(shaderID, frameBlock, FrameUniformBuffer::BINDING);
+	}
+
+	GLuint clusterBlock = glGetUniformBlockIndex(shaderID, "ClusterData");
+	if (clusterBlock != GL_INVALID_INDEX)
+	{
+		glUniformBlockBinding(shaderID, clusterBlock, LightClusters::BINDING);
+	}
 }
+
 GLuint Shader::GetModelLocation()
 {
 	return uniformModel;
 }
-GLuint Shader::GetViewLocation()
-{
-	return uniformView;
-}
-GLuint Shader::GetAmbientColourLocation()
-{
-	return uniformAmbientColour;
-}
-
-GLuint Shader::GetCameraLocalPos()
-{
-	return uniformCameraPos;
-}
-GLuint Shader::GetAmbientIntensityLocation()
-{
-	return uniformAmbientIntensity;
-}
-GLuint Shader::GetDiffuseIntensityLocation()
-{
-	return uniformDiffuseIntensity;
-}
-GLuint Shader::GetSpecularIntensityLocation()
-{
-	return uniformSpecularIntensity;
-}
-GLuint Shader::GetLightDirectionLocation()
-{
-	return uniformLightDirection;
-}
 void Shader::UseShader()
 {
 	glUseProgram(shaderID);
@@ -139,7 +187,8 @@ void Shader::ClearShader()
 	}
 
 	uniformModel = 0;
-	uniformProjection = 0;
+	uniformNormalMatrix = (GLuint)-1;
+	uniformTextureLayer = (GLuint)-1;
 }
 
 
@@ -15,17 +15,18 @@ public:
 	void CreateFromString(const char* vertexCode, const char* fragmentCode);
 	void CreateFromFiles(const char* vertexLocation, const char* fragmentLocation);
 
-	std::string ReadFile(const char* fileLocation);
+	static std::string ReadFile(const char* fileLocation);
 
-	GLuint GetProjectionLocation();
+	// Camera and light come from the FrameData uniform block, see FrameUniformBuffer
 	GLuint GetModelLocation();
-	GLuint GetViewLocation();
-	GLuint GetAmbientIntensityLocation();
-	GLuint GetDiffuseIntensityLocation();
-	GLuint GetLightDirectionLocation();
-	GLuint GetAmbientColourLocation();
-	GLuint GetSpecularIntensityLocation();
-	GLuint GetCameraLocalPos();
+	// Only plain draws of variants without UNIFORM_SCALE have one, see ShaderVariants
+	GLuint GetNormalMatrixLocation() { return uniformNormalMatrix; }
+	bool UsesNormalMatrix() { return uniformNormalMatrix != (GLuint)-1; }
+	// Only plain draws of TEXTURE_ARRAY variants have one, instanced draws read the layer per instance
+	GLuint GetTextureLayerLocation() { return uniformTextureLayer; }
+	bool UsesTextureLayer() { return uniformTextureLayer != (GLuint)-1; }
+
+	GLuint GetShaderID() { return shaderID; }
 
 	void UseShader();
 	void ClearShader();
@@ -33,9 +34,11 @@ public:
 	~Shader();
 
 private:
-	GLuint shaderID, uniformProjection, uniformModel, uniformView, uniformAmbientIntensity, uniformAmbientColour, uniformLightDirection, uniformDiffuseIntensity, uniformSpecularIntensity, uniformCameraPos, uniformLightPosition, uniformLightConstant, uniformLightLinear, uniformLightQuadratic;
+	GLuint shaderID, uniformModel, uniformNormalMatrix, uniformTextureLayer;
 
 	void CompileShader(const char* vertexCode, const char* fragmentCode);
+	bool LinkProgram(const char* vertexCode, const char* fragmentCode);
+	void GetLocations();
 	void AddShader(GLuint theProgram, const char* shaderCode, GLenum shaderType);
 };
 
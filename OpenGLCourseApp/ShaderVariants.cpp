@@ -0,0 +1,124 @@
+#include "ShaderVariants.h"
+
+#include <glm\gtc\epsilon.hpp>
+
+static const char* FEATURE_DEFINES[] = { "TEXTURED", "NORMALS", "INSTANCED", "UNIFORM_SCALE", "TEXTURE_ARRAY" };
+
+// Relative slack allowed when deciding a matrix has one scale and square axes
+static const float UNIFORM_SCALE_EPSILON = 1e-3f;
+
+ShaderVariants::ShaderVariants()
+{
+	for (unsigned int i = 0; i < VARIANT_COUNT; i++)
+	{
+		variants[i] = NULL;
+	}
+}
+
+void ShaderVariants::CreateFromFiles(const char* vertexLocation, const char* fragmentLocation)
+{
+	ClearVariants();
+
+	vertexSource = Shader::ReadFile(vertexLocation);
+	fragmentSource = Shader::ReadFile(fragmentLocation);
+}
+
+Shader* ShaderVariants::Get(unsigned int features)
+{
+	// Instanced variants get their normal matrix from the instance data whatever the scale
+	if (features & INSTANCED)
+	{
+		features &= ~UNIFORM_SCALE;
+	}
+	features &= VARIANT_COUNT - 1;
+
+	if (variants[features] == NULL)
+	{
+		std::string vertexCode = AddDefines(vertexSource, features);
+		std::string fragmentCode = AddDefines(fragmentSource, features);
+
+		variants[features] = new Shader();
+		variants[features]->CreateFromString(vertexCode.c_str(), fragmentCode.c_str());
+	}
+
+	return variants[features];
+}
+
+unsigned int ShaderVariants::GetFeatures(Mesh* mesh, Texture* texture)
+{
+	unsigned int features = 0;
+
+	// A texture that failed to load draws untextured instead of black
+	if (texture != NULL && texture->GetBindID() != 0)
+	{
+		features |= texture->GetArray() != NULL ? TEXTURE_ARRAY : TEXTURED;
+	}
+	if (mesh->HasNormals())
+	{
+		features |= NORMALS;
+	}
+
+	return features;
+}
+
+unsigned int ShaderVariants::GetFeatures(Mesh* mesh, Texture* texture, const glm::mat4& model)
+{
+	unsigned int features = GetFeatures(mesh, texture);
+	if (IsUniformScale(model))
+	{
+		features |= UNIFORM_SCALE;
+	}
+
+	return features;
+}
+
+bool ShaderVariants::IsUniformScale(const glm::mat4& model)
+{
+	glm::vec3 x(model[0]), y(model[1]), z(model[2]);
+	float xx = glm::dot(x, x), yy = glm::dot(y, y), zz = glm::dot(z, z);
+	float epsilon = UNIFORM_SCALE_EPSILON * xx;
+
+	return glm::epsilonEqual(xx, yy, epsilon) && glm::epsilonEqual(xx, zz, epsilon) &&
+		glm::abs(glm::dot(x, y)) <= epsilon && glm::abs(glm::dot(x, z)) <= epsilon && glm::abs(glm::dot(y, z)) <= epsilon;
+}
+
+std::string ShaderVariants::AddDefines(const std::string& source, unsigned int features)
+{
+	std::string defines;
+	for (unsigned int i = 0; i < sizeof(FEATURE_DEFINES) / sizeof(FEATURE_DEFINES[0]); i++)
+	{
+		if (features & (1 << i))
+		{
+			defines += std::string("#define ") + FEATURE_DEFINES[i] + "\n";
+		}
+	}
+
+	// #version has to stay the first line, the defines go right after it
+	size_t versionLine = source.find("#version");
+	if (versionLine == std::string::npos)
+	{
+		return defines + source;
+	}
+
+	size_t lineEnd = source.find('\n', versionLine);
+	if (lineEnd == std::string::npos)
+	{
+		return source + "\n" + defines;
+	}
+
+	return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+void ShaderVariants::ClearVariants()
+{
+	for (unsigned int i = 0; i < VARIANT_COUNT; i++)
+	{
+		delete variants[i];
+		variants[i] = NULL;
+	}
+}
+
+ShaderVariants::~ShaderVariants()
+{
+	ClearVariants();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+
+#include <glm\glm.hpp>
+
+#include "Mesh.h"
+#include "Shader.h"
+#include "Texture.h"
+
+// Every permutation of one vertex/fragment source pair. A variant is the source compiled with
+// a #define per feature bit, built the first time it is asked for and kept until ClearVariants.
+class ShaderVariants
+{
+public:
+	enum Feature
+	{
+		// Sample theTexture, otherwise the surface is white
+		TEXTURED = 1 << 0,
+		// Light with the vertex normals, otherwise ambient only
+		NORMALS = 1 << 1,
+		// Model and normal matrices from the per-instance attributes, see InstanceTransform
+		INSTANCED = 1 << 2,
+		// The model matrix is a rotation and one scale, so it transforms normals itself and
+		// the normalMatrix uniform isn't needed. Instanced variants read a normal matrix either way
+		UNIFORM_SCALE = 1 << 3,
+		// Sample theTextureArray at the instance's layer, or the textureLayer uniform for a plain draw.
+		// Replaces TEXTURED for textures that are a layer of a TextureArray
+		TEXTURE_ARRAY = 1 << 4
+	};
+
+	static const unsigned int VARIANT_COUNT = 1 << 5;
+
+	ShaderVariants();
+
+	void CreateFromFiles(const char* vertexLocation, const char* fragmentLocation);
+	Shader* Get(unsigned int features);
+
+	// Features that follow from the mesh and its material
+	static unsigned int GetFeatures(Mesh* mesh, Texture* texture);
+	// Features for a plain draw, adds UNIFORM_SCALE when the model matrix allows it
+	static unsigned int GetFeatures(Mesh* mesh, Texture* texture, const glm::mat4& model);
+	static bool IsUniformScale(const glm::mat4& model);
+
+	void ClearVariants();
+
+	~ShaderVariants();
+
+private:
+	std::string vertexSource, fragmentSource;
+	Shader* variants[VARIANT_COUNT];
+
+	static std::string AddDefines(const std::string& source, unsigned int features);
+};
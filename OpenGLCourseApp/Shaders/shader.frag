@@ -1,37 +1,110 @@
 #version 330
 
+// Same permutation defines as shader.vert, see ShaderVariants
+
 in vec3 fPos;
 in vec2 fTexCoord;
 in vec3 fNormal;
+#ifdef TEXTURE_ARRAY
+flat in float fLayer;
+#endif
 
 out vec4 colour;
 
-struct DirectionalLight 
+// Packed as in FrameUniformBuffer: lightColour.w is the ambient intensity, lightDirection.w the diffuse intensity
+layout(std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec4 cameraPos;
+	vec4 lightColour;
+	vec4 lightDirection;
+	vec4 lightSpecular;
+};
+
+#ifdef NORMALS
+// Point lights, see LightClusters. The fragment finds its cluster from its screen tile and view depth
+layout(std140) uniform ClusterData
 {
-	vec3 colour;
-	float ambientIntensity;
-	float diffuseIntensity;
-	float specularIntensity;
-	vec3 direction;
+	vec4 clusterScale; // clusters per pixel in x and y, depth slice scale and bias
+	vec4 clusterGrid; // cluster counts in x, y and z
 };
 
+// Three texels per light: position and range, colour and specular intensity, attenuation
+uniform samplerBuffer lightData;
+// Offset and count into lightIndices for every cluster
+uniform usamplerBuffer clusterLights;
+uniform usamplerBuffer lightIndices;
+
+vec3 PointLights(vec3 albedo, vec3 viewDir)
+{
+	float viewDepth = -(view * vec4(fPos, 1.0)).z;
+	ivec3 grid = ivec3(clusterGrid.xyz);
+	ivec3 cluster = ivec3(gl_FragCoord.xy * clusterScale.xy, log(max(viewDepth, 1e-4)) * clusterScale.z + clusterScale.w);
+	cluster = clamp(cluster, ivec3(0), grid - 1);
+
+	uvec2 range = texelFetch(clusterLights, (cluster.z * grid.y + cluster.y) * grid.x + cluster.x).rg;
+
+	vec3 result = vec3(0.0);
+	for (uint i = 0u; i < range.y; i++)
+	{
+		int light = int(texelFetch(lightIndices, int(range.x + i)).r) * 3;
+		vec4 positionRange = texelFetch(lightData, light);
+		vec4 colourSpecular = texelFetch(lightData, light + 1);
+		vec3 attenuation = texelFetch(lightData, light + 2).xyz;
+
+		vec3 toLight = positionRange.xyz - fPos;
+		float distance = length(toLight);
+		if (distance >= positionRange.w)
+		{
+			continue;
+		}
+
+		vec3 lightDir = toLight / distance;
+		float diff = max(dot(fNormal, lightDir), 0.0);
+		float spec = pow(max(dot(viewDir, reflect(-lightDir, fNormal)), 0.0), 32);
+		float falloff = attenuation.x + attenuation.y * distance + attenuation.z * distance * distance;
+
+		result += (colourSpecular.rgb * diff + colourSpecular.w * spec) * albedo / falloff;
+	}
+
+	return result;
+}
+#endif
+
+#ifdef TEXTURE_ARRAY
+// Bound to TextureArray::TEXTURE_UNIT, set by Shader
+uniform sampler2DArray theTextureArray;
+#else
 uniform sampler2D theTexture;
-uniform DirectionalLight directionalLight;
-uniform vec3 cameraPos;
+#endif
 
 void main()
 {
-	vec3 lightDir = normalize(-directionalLight.direction);
+#if defined(TEXTURE_ARRAY)
+	vec3 albedo = texture(theTextureArray, vec3(fTexCoord, fLayer)).rgb;
+#elif defined(TEXTURED)
+	vec3 albedo = texture(theTexture, fTexCoord).rgb;
+#else
+	vec3 albedo = vec3(1.0);
+#endif
+
+	vec3 ambient = lightColour.rgb * lightColour.w * albedo;
+
+#ifdef NORMALS
+	vec3 lightDir = normalize(-lightDirection.xyz);
 	float diff = max(dot(fNormal, lightDir), 0.0);
 
+	vec3 viewDir = normalize(cameraPos.xyz - fPos);
 	vec3 reflectDir = reflect(-lightDir, fNormal);
-	float spec = pow(max(dot(cameraPos, reflectDir), 0.0), 32);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
 
-	vec3 ambient = directionalLight.colour * directionalLight.ambientIntensity * texture(theTexture, fTexCoord).rgb;
-	vec3 diffuse = directionalLight.diffuseIntensity * diff * texture(theTexture, fTexCoord).rgb;
-    vec3 specular = directionalLight.specularIntensity * spec * texture(theTexture, fTexCoord).rgb;
+	vec3 diffuse = lightDirection.w * diff * albedo;
+	vec3 specular = lightSpecular.x * spec * albedo;
 
-	colour = vec4(ambient + diffuse + specular, 1.0);
-	
-	// colour = vec4(0.0, 0.0, 1.0, 1.0);
+	colour = vec4(ambient + diffuse + specular + PointLights(albedo, viewDir), 1.0);
+#else
+	// A zero normal never got any diffuse or specular, only the ambient term is left
+	colour = vec4(ambient, 1.0);
+#endif
 }
\ No newline at end of file
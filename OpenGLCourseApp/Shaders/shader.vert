@@ -1,20 +1,75 @@
 #version 330
 
+// Compiled per permutation, ShaderVariants adds a #define for each feature:
+// TEXTURED, NORMALS, INSTANCED, UNIFORM_SCALE, TEXTURE_ARRAY
+
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec2 tex;
 layout(location = 2) in vec3 normal;
 
+#ifdef INSTANCED
+// InstanceTransform, both matrices come from the CPU
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in mat3 instanceNormalMatrix;
+#ifdef TEXTURE_ARRAY
+layout(location = 10) in float instanceLayer;
+#endif
+#else
+uniform mat4 model;
+#if defined(NORMALS) && !defined(UNIFORM_SCALE)
+// inverse transpose of the model matrix, worked out once per draw
+uniform mat3 normalMatrix;
+#endif
+#ifdef TEXTURE_ARRAY
+uniform float textureLayer;
+#endif
+#endif
+
 out vec3 fPos;
 out vec2 fTexCoord;
 out vec3 fNormal;
-uniform mat4 model;
-uniform mat4 projection;
-uniform mat4 view;
+#ifdef TEXTURE_ARRAY
+flat out float fLayer;
+#endif
+
+layout(std140) uniform FrameData
+{
+	mat4 projection;
+	mat4 view;
+	vec4 cameraPos;
+	vec4 lightColour;
+	vec4 lightDirection;
+	vec4 lightSpecular;
+};
 
 void main()
 {
+#ifdef INSTANCED
+	fPos = vec3(instanceModel * vec4(pos,1.0));
+#else
 	fPos = vec3(model * vec4(pos,1.0));
-	fNormal = mat3(transpose(inverse(model))) * normal;
+#endif
+
+#if !defined(NORMALS)
+	fNormal = vec3(0.0);
+#else
+#if defined(INSTANCED)
+	vec3 worldNormal = instanceNormalMatrix * normal;
+#elif defined(UNIFORM_SCALE)
+	// A rotation and one scale only stretch normals, they don't tilt them
+	vec3 worldNormal = mat3(model) * normal;
+#else
+	vec3 worldNormal = normalMatrix * normal;
+#endif
+	// Quantized meshes carry a scale in the model matrix, renormalize after the transform
+	fNormal = dot(worldNormal, worldNormal) > 0.0 ? normalize(worldNormal) : worldNormal;
+#endif
+
 	fTexCoord = tex;
+#if defined(TEXTURE_ARRAY) && defined(INSTANCED)
+	fLayer = instanceLayer;
+#elif defined(TEXTURE_ARRAY)
+	fLayer = textureLayer;
+#endif
 	gl_Position = projection * view * vec4(fPos, 1.0);
-}
\ No newline at end of file
+}
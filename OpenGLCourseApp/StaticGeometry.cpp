@@ -0,0 +1,346 @@
+#include "StaticGeometry.h"
+
+#include <algorithm>
+
+StaticGeometry::StaticGeometry()
+{
+	instanceVBO = 0;
+	indirectBuffer = 0;
+	useMultiDrawIndirect = false;
+	submissionCount = 0;
+	culledCount = 0;
+	triangleCount = 0;
+}
+
+void StaticGeometry::Add(Mesh* mesh, Texture* texture, const glm::mat4& model)
+{
+	StaticDraw draw;
+	draw.mesh = mesh;
+	draw.texture = texture;
+	draw.model = model;
+	draws.push_back(draw);
+}
+
+void StaticGeometry::Add(const std::vector<Mesh*>& meshList, Texture* texture, const glm::mat4& model)
+{
+	for (size_t i = 0; i < meshList.size(); i++)
+	{
+		Add(meshList[i], texture, model);
+	}
+}
+
+size_t StaticGeometry::GetArena(VertexFormat::Type format, GLenum indexType)
+{
+	for (size_t i = 0; i < arenas.size(); i++)
+	{
+		if (arenas[i].format == format && arenas[i].indexType == indexType)
+		{
+			return i;
+		}
+	}
+
+	Arena arena;
+	arena.format = format;
+	arena.indexType = indexType;
+	arena.VAO = 0;
+	arena.VBO = 0;
+	arena.IBO = 0;
+	arena.vertexCount = 0;
+	arena.indexCount = 0;
+	arenas.push_back(arena);
+	return arenas.size() - 1;
+}
+
+void StaticGeometry::Build()
+{
+	if (draws.empty())
+	{
+		return;
+	}
+
+	// Group draws sharing a vertex format, index type, texture and shader variant, each group becomes one multi-draw
+	std::stable_sort(draws.begin(), draws.end(), [](const StaticDraw& a, const StaticDraw& b) {
+		if (a.mesh->GetVertexFormat() != b.mesh->GetVertexFormat())
+		{
+			return a.mesh->GetVertexFormat() < b.mesh->GetVertexFormat();
+		}
+		if (a.mesh->GetIndexType() != b.mesh->GetIndexType())
+		{
+			return a.mesh->GetIndexType() < b.mesh->GetIndexType();
+		}
+		// Layers of one TextureArray sort together and end up in one group
+		if (a.texture->GetBindID() != b.texture->GetBindID())
+		{
+			return a.texture->GetBindID() < b.texture->GetBindID();
+		}
+		return ShaderVariants::GetFeatures(a.mesh, a.texture) < ShaderVariants::GetFeatures(b.mesh, b.texture);
+	});
+
+	// Sub-allocate each distinct mesh once, even if it is drawn several times
+	for (size_t i = 0; i < draws.size(); i++)
+	{
+		Mesh* mesh = draws[i].mesh;
+		if (allocations.find(mesh) != allocations.end())
+		{
+			continue;
+		}
+
+		Arena& arena = arenas[GetArena(mesh->GetVertexFormat(), mesh->GetIndexType())];
+
+		Allocation allocation;
+		allocation.arena = &arena - &arenas[0];
+		allocation.baseVertex = arena.vertexCount;
+		allocation.firstIndex = arena.indexCount;
+		allocation.indexCount = mesh->GetIndexCount();
+		allocations[mesh] = allocation;
+
+		arena.vertexCount += mesh->GetVertexCount();
+		arena.indexCount += mesh->GetIndexCount();
+	}
+
+	// One InstanceTransform per draw, draw i reads instance i through baseInstance
+	std::vector<InstanceTransform> instances(draws.size());
+	for (size_t i = 0; i < draws.size(); i++)
+	{
+		Mesh* mesh = draws[i].mesh;
+		const Allocation& allocation = allocations[mesh];
+
+		// Commands start out at level 0, Render moves them to the level picked each frame
+		DrawElementsIndirectCommand command;
+		command.count = mesh->GetLod(0).indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = allocation.firstIndex + mesh->GetLod(0).firstIndex;
+		command.baseVertex = allocation.baseVertex;
+		command.baseInstance = (GLuint)i;
+		commands.push_back(command);
+
+		instances[i] = InstanceTransform::Make(mesh->IsQuantized() ? draws[i].model * mesh->GetDequantizeTransform() : draws[i].model,
+			draws[i].texture->GetArrayLayer());
+
+		glm::vec3 center, extent;
+		Frustum::TransformBox(draws[i].model, mesh->GetBoundsMin(), mesh->GetBoundsMax(), center, extent);
+		drawBoxes.Add(center, extent);
+
+		unsigned int features = ShaderVariants::GetFeatures(mesh, draws[i].texture) | ShaderVariants::INSTANCED;
+		if (groups.empty() || groups.back().texture->GetBindID() != draws[i].texture->GetBindID() || groups.back().arena != allocation.arena ||
+			groups.back().features != features)
+		{
+			TextureGroup group;
+			group.arena = allocation.arena;
+			group.texture = draws[i].texture;
+			group.features = features;
+			group.firstCommand = i;
+			group.commandCount = 0;
+			groups.push_back(group);
+		}
+		groups.back().commandCount++;
+	}
+	drawLods.assign(draws.size(), 0);
+
+	glGenBuffers(1, &instanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceTransform) * instances.size(), &instances[0], GL_STATIC_DRAW);
+
+	for (size_t a = 0; a < arenas.size(); a++)
+	{
+		Arena& arena = arenas[a];
+		GLsizei stride = VertexFormat::GetStride(arena.format);
+		GLsizei indexSize = arena.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+		glGenVertexArrays(1, &arena.VAO);
+		glBindVertexArray(arena.VAO);
+
+		glGenBuffers(1, &arena.IBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.IBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize * arena.indexCount, NULL, GL_STATIC_DRAW);
+
+		glGenBuffers(1, &arena.VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, arena.VBO);
+		glBufferData(GL_ARRAY_BUFFER, stride * arena.vertexCount, NULL, GL_STATIC_DRAW);
+
+		// The meshes are already on the GPU, copy buffer to buffer instead of going back through the CPU
+		for (std::map<Mesh*, Allocation>::iterator it = allocations.begin(); it != allocations.end(); ++it)
+		{
+			Mesh* mesh = it->first;
+			const Allocation& allocation = it->second;
+			if (allocation.arena != a)
+			{
+				continue;
+			}
+
+			glBindBuffer(GL_COPY_READ_BUFFER, mesh->GetVBO());
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0,
+				stride * allocation.baseVertex, stride * mesh->GetVertexCount());
+
+			glBindBuffer(GL_COPY_READ_BUFFER, mesh->GetIBO());
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ELEMENT_ARRAY_BUFFER, 0,
+				indexSize * allocation.firstIndex, indexSize * allocation.indexCount);
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+		VertexFormat::SetAttributes(arena.format);
+
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		InstanceTransform::SetAttributes(0);
+		InstanceTransform::EnableAttributes();
+
+		glBindVertexArray(0);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	// glMultiDrawElementsIndirect is GL 4.3, on a plain 3.3 context fall back to one
+	// glDrawElementsBaseVertex per draw, still without buffer switches inside an arena.
+	// The commands pick their InstanceTransform with baseInstance, which must be 0 without base_instance
+	useMultiDrawIndirect = (GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect) && (GLEW_VERSION_4_2 || GLEW_ARB_base_instance);
+	if (useMultiDrawIndirect)
+	{
+		glGenBuffers(1, &indirectBuffer);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * commands.size(), &commands[0], GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
+
+void StaticGeometry::CompileShaders(ShaderVariants* shaders)
+{
+	for (size_t i = 0; i < groups.size(); i++)
+	{
+		shaders->Get(groups[i].features);
+	}
+}
+
+void StaticGeometry::Render(GLStateCache& stateCache, ShaderVariants* shaders, const Frustum* frustum, const LodSelector* lodSelector)
+{
+	submissionCount = 0;
+	culledCount = 0;
+	triangleCount = 0;
+	if (arenas.empty())
+	{
+		return;
+	}
+
+	drawVisible.assign(commands.size(), 1);
+	if (frustum != NULL)
+	{
+		culledCount = frustum->CullBoxes(drawBoxes, drawVisible);
+	}
+
+	// Culled draws stay in the buffer with no instances, the GPU skips them for free
+	visibleCommands = commands;
+	for (size_t i = 0; i < visibleCommands.size(); i++)
+	{
+		visibleCommands[i].instanceCount = drawVisible[i];
+		if (!drawVisible[i])
+		{
+			continue;
+		}
+
+		if (lodSelector != NULL)
+		{
+			Mesh* mesh = draws[i].mesh;
+			drawLods[i] = (unsigned char)lodSelector->Select(mesh, draws[i].model, drawLods[i]);
+
+			// Level 0 starts the mesh's allocation, the other levels are offsets into it
+			const MeshLod& lod = mesh->GetLod(drawLods[i]);
+			visibleCommands[i].count = lod.indexCount;
+			visibleCommands[i].firstIndex = commands[i].firstIndex - mesh->GetLod(0).firstIndex + lod.firstIndex;
+		}
+		triangleCount += visibleCommands[i].count / 3;
+	}
+
+	if (useMultiDrawIndirect)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand) * visibleCommands.size(), &visibleCommands[0]);
+	}
+	else
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	}
+
+	for (size_t i = 0; i < groups.size(); i++)
+	{
+		const TextureGroup& group = groups[i];
+		const Arena& arena = arenas[group.arena];
+		GLsizei indexSize = arena.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		stateCache.UseProgram(shaders->Get(group.features)->GetShaderID());
+		stateCache.BindVertexArray(arena.VAO);
+		group.texture->BindTexture(stateCache);
+
+		if (useMultiDrawIndirect)
+		{
+			glMultiDrawElementsIndirect(GL_TRIANGLES, arena.indexType,
+				(void*)(sizeof(DrawElementsIndirectCommand) * group.firstCommand), group.commandCount, 0);
+			stateCache.CountDraw();
+			submissionCount++;
+			continue;
+		}
+
+		for (GLsizei j = 0; j < group.commandCount; j++)
+		{
+			const DrawElementsIndirectCommand& command = visibleCommands[group.firstCommand + j];
+			if (command.instanceCount == 0)
+			{
+				continue;
+			}
+
+			InstanceTransform::SetAttributes(command.baseInstance);
+			glDrawElementsBaseVertex(GL_TRIANGLES, command.count, arena.indexType,
+				(void*)((size_t)indexSize * command.firstIndex), command.baseVertex);
+			stateCache.CountDraw();
+			submissionCount++;
+		}
+
+		// Leave the arena VAO pointing at the start of the instance buffer
+		InstanceTransform::SetAttributes(0);
+	}
+
+	if (useMultiDrawIndirect)
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+	else
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
+
+void StaticGeometry::Clear()
+{
+	for (size_t i = 0; i < arenas.size(); i++)
+	{
+		glDeleteBuffers(1, &arenas[i].VBO);
+		glDeleteBuffers(1, &arenas[i].IBO);
+		glDeleteVertexArrays(1, &arenas[i].VAO);
+	}
+	arenas.clear();
+
+	GLuint buffers[] = { instanceVBO, indirectBuffer };
+	for (size_t i = 0; i < 2; i++)
+	{
+		if (buffers[i] != 0)
+		{
+			glDeleteBuffers(1, &buffers[i]);
+		}
+	}
+	instanceVBO = 0;
+	indirectBuffer = 0;
+
+	draws.clear();
+	allocations.clear();
+	commands.clear();
+	visibleCommands.clear();
+	groups.clear();
+	drawBoxes.Clear();
+	drawVisible.clear();
+	drawLods.clear();
+	submissionCount = 0;
+	triangleCount = 0;
+}
+
+StaticGeometry::~StaticGeometry()
+{
+	Clear();
+}
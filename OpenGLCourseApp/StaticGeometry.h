@@ -0,0 +1,109 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+
+#include "Frustum.h"
+#include "GLStateCache.h"
+#include "LodSelector.h"
+#include "Mesh.h"
+#include "ShaderVariants.h"
+#include "Texture.h"
+
+// Matches the layout glMultiDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+// Copies every immutable mesh into one shared vertex buffer and one shared index buffer per
+// vertex format and index type, then draws the whole static world with one multi-draw per arena,
+// texture (a whole TextureArray counts as one) and shader variant. Each draw's InstanceTransform lives in a per-instance buffer indexed
+// through baseInstance, so the instanced shader variants are used.
+class StaticGeometry
+{
+public:
+	StaticGeometry();
+
+	void Add(Mesh* mesh, Texture* texture, const glm::mat4& model);
+	void Add(const std::vector<Mesh*>& meshList, Texture* texture, const glm::mat4& model);
+	void Build();
+	// Draws outside the frustum get an instance count of 0, pass NULL to draw everything.
+	// The level of detail is picked per draw, pass a NULL lodSelector to draw level 0 only
+	void Render(GLStateCache& stateCache, ShaderVariants* shaders, const Frustum* frustum, const LodSelector* lodSelector);
+	// Builds the variants Render will use, call after Build so the first frame doesn't compile them
+	void CompileShaders(ShaderVariants* shaders);
+	void Clear();
+
+	unsigned int GetDrawCount() { return (unsigned int)commands.size(); }
+	unsigned int GetSubmissionCount() { return submissionCount; }
+	unsigned int GetCulledCount() { return culledCount; }
+	unsigned int GetTriangleCount() { return triangleCount; }
+	bool UsesMultiDrawIndirect() { return useMultiDrawIndirect; }
+
+	~StaticGeometry();
+
+private:
+	struct Arena
+	{
+		VertexFormat::Type format;
+		GLenum indexType;
+		GLuint VAO, VBO, IBO;
+		GLsizei vertexCount, indexCount;
+	};
+
+	struct Allocation
+	{
+		size_t arena;
+		GLint baseVertex;
+		GLuint firstIndex;
+		GLuint indexCount;
+	};
+
+	struct StaticDraw
+	{
+		Mesh* mesh;
+		Texture* texture;
+		glm::mat4 model;
+	};
+
+	struct TextureGroup
+	{
+		size_t arena;
+		Texture* texture;
+		unsigned int features;
+		size_t firstCommand;
+		GLsizei commandCount;
+	};
+
+	std::vector<StaticDraw> draws;
+	std::vector<Arena> arenas;
+	std::map<Mesh*, Allocation> allocations;
+
+	std::vector<DrawElementsIndirectCommand> commands;
+	std::vector<DrawElementsIndirectCommand> visibleCommands;
+	std::vector<TextureGroup> groups;
+
+	// The world never moves, so the boxes are transformed once in Build
+	BoundingBoxList drawBoxes;
+	std::vector<unsigned char> drawVisible;
+	unsigned int culledCount;
+
+	// Level each draw used last frame
+	std::vector<unsigned char> drawLods;
+	unsigned int triangleCount;
+
+	GLuint instanceVBO, indirectBuffer;
+	bool useMultiDrawIndirect;
+	unsigned int submissionCount;
+
+	size_t GetArena(VertexFormat::Type format, GLenum indexType);
+};
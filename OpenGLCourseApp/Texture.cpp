@@ -1,5 +1,10 @@
 #include "Texture.h"
 
+#include "AssetPack.h"
+#include "GLStateCache.h"
+#include "MeshCache.h"
+#include "TextureArray.h"
+
 
 Texture::Texture()
 {
@@ -8,6 +13,8 @@ Texture::Texture()
 	height = 0;
 	bitDepth = 0;
 	fileLocation = "";
+	array = NULL;
+	arrayLayer = 0;
 }
 
 Texture::Texture(std::string fileLoc)
@@ -17,17 +24,37 @@ Texture::Texture(std::string fileLoc)
 	height = 0;
 	bitDepth = 0;
 	fileLocation = fileLoc;
+	array = NULL;
+	arrayLayer = 0;
 }
 
 void Texture::LoadTexture()
 {
-	unsigned char *texData = stbi_load(fileLocation.c_str(), &width, &height, &bitDepth, 0);
+	KTXFile ktx;
+	if (OpenCookedTexture(fileLocation, ktx))
+	{
+		LoadCompressedTexture(ktx);
+		return;
+	}
+
+	unsigned char *texData = AssetPack::DecodeImage(fileLocation, &width, &height, &bitDepth, 0);
 	if (!texData)
 	{
-		printf("Failed to find: %s\n", fileLocation);
+		printf("Failed to find: %s\n", fileLocation.c_str());
 		return;
 	}
 
+	LoadTextureFromData(texData, width, height, bitDepth);
+
+	stbi_image_free(texData);
+}
+
+void Texture::LoadTextureFromData(const unsigned char* texData, int texWidth, int texHeight, int texBitDepth)
+{
+	width = texWidth;
+	height = texHeight;
+	bitDepth = texBitDepth;
+
 	glGenTextures(1, &textureID);
 	glBindTexture(GL_TEXTURE_2D, textureID);
 
@@ -40,8 +67,103 @@ void Texture::LoadTexture()
 	glGenerateMipmap(GL_TEXTURE_2D);
 
 	glBindTexture(GL_TEXTURE_2D, 0);
+}
 
-	stbi_image_free(texData);
+void Texture::LoadCompressedTexture(KTXFile& ktx)
+{
+	width = ktx.GetWidth();
+	height = ktx.GetHeight();
+	bitDepth = ktx.GetInternalFormat() == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 4 : 3;
+
+	// Reloading replaces the texture, don't leak the old one
+	if (textureID != 0)
+	{
+		glDeleteTextures(1, &textureID);
+	}
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, ktx.GetLevelCount() > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)ktx.GetLevelCount() - 1);
+
+	// The mip chain was built by the cooker, no glGenerateMipmap
+	for (size_t i = 0; i < ktx.GetLevelCount(); i++)
+	{
+		const KTXFile::Level& level = ktx.GetLevel(i);
+		glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, ktx.GetInternalFormat(), level.width, level.height, 0, level.imageSize, level.data);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Texture::ReplaceTexture(GLuint newTextureID, int texWidth, int texHeight, int texBitDepth)
+{
+	if (textureID != 0)
+	{
+		glDeleteTextures(1, &textureID);
+	}
+
+	textureID = newTextureID;
+	width = texWidth;
+	height = texHeight;
+	bitDepth = texBitDepth;
+}
+
+bool Texture::OpenCookedTexture(const std::string& sourceLocation, KTXFile& ktx)
+{
+	if (!GLEW_EXT_texture_compression_s3tc)
+	{
+		return false;
+	}
+
+	if (!ktx.Open(KTXFile::GetCookedLocation(sourceLocation)))
+	{
+		return false;
+	}
+
+	// Arrays are loaded by TextureArray
+	if (ktx.GetLayerCount() != 0)
+	{
+		ktx.Close();
+		return false;
+	}
+
+	// Without the source around there is nothing to compare against, use what was shipped
+	uint64_t sourceHash = MeshCache::HashFile(sourceLocation);
+	if (sourceHash != 0 && ktx.GetSourceHash() != sourceHash)
+	{
+		printf("%s is out of date, run with --cook to rebuild it\n", KTXFile::GetCookedLocation(sourceLocation).c_str());
+		ktx.Close();
+		return false;
+	}
+
+	return true;
+}
+
+void Texture::SetArrayLayer(TextureArray* textureArray, GLint layer)
+{
+	array = textureArray;
+	arrayLayer = layer;
+}
+
+GLuint Texture::GetBindID()
+{
+	return array != NULL ? array->GetTextureID() : textureID;
+}
+
+void Texture::BindTexture(GLStateCache& stateCache)
+{
+	if (array != NULL)
+	{
+		stateCache.BindTexture(TextureArray::TEXTURE_UNIT, GL_TEXTURE_2D_ARRAY, array->GetTextureID());
+		return;
+	}
+
+	stateCache.BindTexture(0, textureID);
 }
 
 void Texture::UseTexture()
@@ -58,6 +180,8 @@ void Texture::ClearTexture()
 	height = 0;
 	bitDepth = 0; 
 	fileLocation = "";
+	array = NULL;
+	arrayLayer = 0;
 }
 
 
@@ -5,6 +5,11 @@
 #include "stb_image.h"
 #include <string>
 
+#include "KTXFile.h"
+
+class GLStateCache;
+class TextureArray;
+
 class Texture
 {
 public:
@@ -12,9 +17,29 @@ public:
 	Texture(std::string fileLoc);
 
 	void LoadTexture();
+	void LoadTextureFromData(const unsigned char* texData, int texWidth, int texHeight, int texBitDepth);
+	void LoadCompressedTexture(KTXFile& ktx);
+	// Takes over a finished GL texture, see TextureStreamer. The texture it replaces is deleted
+	void ReplaceTexture(GLuint newTextureID, int texWidth, int texHeight, int texBitDepth);
+
+	// Opens the cooked .ktx next to the source image if the GL can use it and it isn't stale
+	static bool OpenCookedTexture(const std::string& sourceLocation, KTXFile& ktx);
 	void UseTexture();
 	void ClearTexture();
 
+	// Makes this texture a layer of a TextureArray, draws then bind the array and pass the layer
+	// per instance, so textures of one array can share a draw
+	void SetArrayLayer(TextureArray* textureArray, GLint layer);
+	TextureArray* GetArray() { return array; }
+	GLint GetArrayLayer() { return arrayLayer; }
+
+	// The name a draw binds, the array's for an array layer. Draws are sorted and grouped by it
+	GLuint GetBindID();
+	void BindTexture(GLStateCache& stateCache);
+
+	GLuint GetTextureID() { return textureID; }
+	const std::string& GetFileLocation() { return fileLocation; }
+
 	~Texture();
 
 private:
@@ -22,5 +47,8 @@ private:
 	int width, height, bitDepth;
 
 	std::string fileLocation;
+
+	TextureArray* array;
+	GLint arrayLayer;
 };
 
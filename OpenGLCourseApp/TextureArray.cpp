@@ -0,0 +1,135 @@
+#include "TextureArray.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "MeshCache.h"
+#include "TextureCooker.h"
+
+TextureArray::TextureArray()
+{
+	textureID = 0;
+	width = 0;
+	height = 0;
+	cookedLocation = "";
+}
+
+TextureArray::TextureArray(const std::vector<std::string>& fileLocs, const std::string& cookedLoc)
+{
+	textureID = 0;
+	width = 0;
+	height = 0;
+	fileLocations = fileLocs;
+	cookedLocation = cookedLoc;
+}
+
+void TextureArray::CreateTexture(GLint levelCount)
+{
+	// Reloading replaces the texture, don't leak the old one
+	if (textureID != 0)
+	{
+		glDeleteTextures(1, &textureID);
+	}
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+}
+
+void TextureArray::LoadTextureArrayFromData(const std::vector<std::vector<unsigned char> >& layers, int texWidth, int texHeight)
+{
+	width = texWidth;
+	height = texHeight;
+
+	// glGenerateMipmap below builds the full chain
+	GLint levelCount = 1;
+	while ((std::max(width, height) >> levelCount) > 0)
+	{
+		levelCount++;
+	}
+	CreateTexture(levelCount);
+
+	// Layers are RGBA8, already resized to one size by TextureCooker::LoadLayers
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, (GLsizei)layers.size(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	for (size_t i = 0; i < layers.size(); i++)
+	{
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)i, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, &layers[i][0]);
+	}
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void TextureArray::LoadCompressedTextureArray(KTXFile& ktx)
+{
+	width = ktx.GetWidth();
+	height = ktx.GetHeight();
+
+	CreateTexture((GLint)ktx.GetLevelCount());
+
+	// Each level holds every layer, so one call per level uploads the whole array
+	for (size_t i = 0; i < ktx.GetLevelCount(); i++)
+	{
+		const KTXFile::Level& level = ktx.GetLevel(i);
+		glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, (GLint)i, ktx.GetInternalFormat(), level.width, level.height, ktx.GetLayerCount(),
+			0, level.imageSize, level.data);
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+bool TextureArray::OpenCookedTextureArray(KTXFile& ktx)
+{
+	if (!GLEW_EXT_texture_compression_s3tc)
+	{
+		return false;
+	}
+
+	if (!ktx.Open(cookedLocation))
+	{
+		return false;
+	}
+
+	if (ktx.GetLayerCount() != GetLayerCount())
+	{
+		printf("%s has %d layers instead of %d, run with --cook to rebuild it\n", cookedLocation.c_str(), ktx.GetLayerCount(), GetLayerCount());
+		ktx.Close();
+		return false;
+	}
+
+	// Sources missing on disk hash to 0 and change the key, so only check when they are all there
+	bool sourcesPresent = true;
+	for (size_t i = 0; i < fileLocations.size(); i++)
+	{
+		sourcesPresent = sourcesPresent && MeshCache::HashFile(fileLocations[i]) != 0;
+	}
+
+	if (sourcesPresent && ktx.GetSourceHash() != TextureCooker::HashSources(fileLocations))
+	{
+		printf("%s is out of date, run with --cook to rebuild it\n", cookedLocation.c_str());
+		ktx.Close();
+		return false;
+	}
+
+	return true;
+}
+
+void TextureArray::ClearTextureArray()
+{
+	glDeleteTextures(1, &textureID);
+	textureID = 0;
+	width = 0;
+	height = 0;
+	fileLocations.clear();
+	cookedLocation = "";
+}
+
+TextureArray::~TextureArray()
+{
+	ClearTextureArray();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <GL\glew.h>
+
+#include "KTXFile.h"
+
+// Same-sized images packed into one GL_TEXTURE_2D_ARRAY, so objects using different images can
+// share a draw and pick their layer per instance. See Texture::SetArrayLayer.
+class TextureArray
+{
+public:
+	// Arrays get their own unit so a sampler2DArray never shares one with theTexture's sampler2D
+	static const GLuint TEXTURE_UNIT = 1;
+
+	TextureArray();
+	TextureArray(const std::vector<std::string>& fileLocs, const std::string& cookedLoc);
+
+	// GL thread. The cooked array is opened or the layers decoded on an AssetLoader worker, see QueueTextureArray
+	void LoadCompressedTextureArray(KTXFile& ktx);
+	void LoadTextureArrayFromData(const std::vector<std::vector<unsigned char> >& layers, int texWidth, int texHeight);
+
+	// Opens the cooked array if the GL can use it and it was cooked from the current sources
+	bool OpenCookedTextureArray(KTXFile& ktx);
+	void ClearTextureArray();
+
+	GLuint GetTextureID() { return textureID; }
+	GLsizei GetLayerCount() { return (GLsizei)fileLocations.size(); }
+	const std::vector<std::string>& GetFileLocations() { return fileLocations; }
+	const std::string& GetCookedLocation() { return cookedLocation; }
+
+	~TextureArray();
+
+private:
+	GLuint textureID;
+	int width, height;
+
+	std::vector<std::string> fileLocations;
+	std::string cookedLocation;
+
+	// levelCount is the number of mip levels that will be uploaded or generated
+	void CreateTexture(GLint levelCount);
+};
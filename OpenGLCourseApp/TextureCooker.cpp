@@ -0,0 +1,412 @@
+#include "TextureCooker.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+
+#include <GL\glew.h>
+
+#include "stb_image.h"
+
+#include "AssetPack.h"
+#include "KTXFile.h"
+#include "MeshCache.h"
+
+static uint16_t PackRGB565(int r, int g, int b)
+{
+	return (uint16_t)(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+
+static void UnpackRGB565(uint16_t colour, int* rgb)
+{
+	int r = (colour >> 11) & 31, g = (colour >> 5) & 63, b = colour & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+void TextureCooker::CompressColourBlock(const unsigned char* block, unsigned char* output, bool allowTransparentMode)
+{
+	// Endpoints from the bounding box of the block, pulled in by 1/16 of the range to spend
+	// less precision on outliers
+	int minColour[3] = { 255, 255, 255 }, maxColour[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			int value = block[i * 4 + c];
+			minColour[c] = value < minColour[c] ? value : minColour[c];
+			maxColour[c] = value > maxColour[c] ? value : maxColour[c];
+		}
+	}
+
+	for (int c = 0; c < 3; c++)
+	{
+		int inset = (maxColour[c] - minColour[c]) >> 4;
+		minColour[c] += inset;
+		maxColour[c] -= inset;
+	}
+
+	uint16_t colour0 = PackRGB565(maxColour[0], maxColour[1], maxColour[2]);
+	uint16_t colour1 = PackRGB565(minColour[0], minColour[1], minColour[2]);
+
+	// colour0 > colour1 selects the four colour mode, colour0 <= colour1 is the three colour + transparent one
+	if (colour0 < colour1)
+	{
+		uint16_t swap = colour0;
+		colour0 = colour1;
+		colour1 = swap;
+	}
+
+	uint32_t selectors = 0;
+	if (colour0 != colour1 || !allowTransparentMode)
+	{
+		int palette[4][3];
+		UnpackRGB565(colour0, palette[0]);
+		UnpackRGB565(colour1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestError = 0x7FFFFFFF;
+			for (int p = 0; p < 4; p++)
+			{
+				int error = 0;
+				for (int c = 0; c < 3; c++)
+				{
+					int difference = block[i * 4 + c] - palette[p][c];
+					error += difference * difference;
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					best = p;
+				}
+			}
+			selectors |= (uint32_t)best << (i * 2);
+		}
+	}
+
+	output[0] = colour0 & 0xFF;
+	output[1] = colour0 >> 8;
+	output[2] = colour1 & 0xFF;
+	output[3] = colour1 >> 8;
+	output[4] = selectors & 0xFF;
+	output[5] = (selectors >> 8) & 0xFF;
+	output[6] = (selectors >> 16) & 0xFF;
+	output[7] = (selectors >> 24) & 0xFF;
+}
+
+void TextureCooker::CompressAlphaBlock(const unsigned char* block, unsigned char* output)
+{
+	int minAlpha = 255, maxAlpha = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int alpha = block[i * 4 + 3];
+		minAlpha = alpha < minAlpha ? alpha : minAlpha;
+		maxAlpha = alpha > maxAlpha ? alpha : maxAlpha;
+	}
+
+	// alpha0 > alpha1 gives eight interpolated values
+	int palette[8];
+	palette[0] = maxAlpha;
+	palette[1] = minAlpha;
+	for (int p = 1; p < 7; p++)
+	{
+		palette[p + 1] = ((7 - p) * maxAlpha + p * minAlpha) / 7;
+	}
+
+	uint64_t selectors = 0;
+	if (maxAlpha != minAlpha)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			int alpha = block[i * 4 + 3];
+			int best = 0, bestError = 256;
+			for (int p = 0; p < 8; p++)
+			{
+				int error = alpha > palette[p] ? alpha - palette[p] : palette[p] - alpha;
+				if (error < bestError)
+				{
+					bestError = error;
+					best = p;
+				}
+			}
+			selectors |= (uint64_t)best << (i * 3);
+		}
+	}
+
+	output[0] = (unsigned char)maxAlpha;
+	output[1] = (unsigned char)minAlpha;
+	for (int i = 0; i < 6; i++)
+	{
+		output[2 + i] = (unsigned char)((selectors >> (i * 8)) & 0xFF);
+	}
+}
+
+void TextureCooker::CompressBlockBC1(const unsigned char* block, unsigned char* output)
+{
+	CompressColourBlock(block, output, true);
+}
+
+void TextureCooker::CompressBlockBC3(const unsigned char* block, unsigned char* output)
+{
+	CompressAlphaBlock(block, output);
+	// The colour half of BC3 is always decoded in four colour mode
+	CompressColourBlock(block, output + 8, false);
+}
+
+void TextureCooker::CompressImage(const std::vector<unsigned char>& rgba, int width, int height, bool hasAlpha, std::vector<unsigned char>& output)
+{
+	int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+	size_t blockSize = hasAlpha ? 16 : 8;
+	output.resize(blockSize * blocksWide * blocksHigh);
+
+	unsigned char block[64];
+	for (int by = 0; by < blocksHigh; by++)
+	{
+		for (int bx = 0; bx < blocksWide; bx++)
+		{
+			// Blocks hanging over the edge of small mips repeat the last row/column
+			for (int y = 0; y < 4; y++)
+			{
+				int sy = by * 4 + y < height ? by * 4 + y : height - 1;
+				for (int x = 0; x < 4; x++)
+				{
+					int sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+					memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+				}
+			}
+
+			unsigned char* destination = &output[blockSize * ((size_t)by * blocksWide + bx)];
+			if (hasAlpha)
+			{
+				CompressBlockBC3(block, destination);
+			}
+			else
+			{
+				CompressBlockBC1(block, destination);
+			}
+		}
+	}
+}
+
+void TextureCooker::Resize(const std::vector<unsigned char>& rgba, int width, int height, int newWidth, int newHeight, std::vector<unsigned char>& output)
+{
+	// Box filter down to within 2x of the target first, bilinear alone would skip source pixels
+	std::vector<unsigned char> source = rgba, smaller;
+	while (width >= newWidth * 2 && height >= newHeight * 2)
+	{
+		Downsample(source, width, height, smaller);
+		source.swap(smaller);
+		width /= 2;
+		height /= 2;
+	}
+
+	output.resize((size_t)newWidth * newHeight * 4);
+	for (int y = 0; y < newHeight; y++)
+	{
+		// Pixel centres line up, the edges clamp
+		float sy = (y + 0.5f) * height / newHeight - 0.5f;
+		sy = sy > 0.0f ? sy : 0.0f;
+		int y0 = (int)sy, y1 = y0 + 1 < height ? y0 + 1 : height - 1;
+		float fy = sy - y0;
+		for (int x = 0; x < newWidth; x++)
+		{
+			float sx = (x + 0.5f) * width / newWidth - 0.5f;
+			sx = sx > 0.0f ? sx : 0.0f;
+			int x0 = (int)sx, x1 = x0 + 1 < width ? x0 + 1 : width - 1;
+			float fx = sx - x0;
+			for (int c = 0; c < 4; c++)
+			{
+				float top = source[((size_t)y0 * width + x0) * 4 + c] * (1.0f - fx) + source[((size_t)y0 * width + x1) * 4 + c] * fx;
+				float bottom = source[((size_t)y1 * width + x0) * 4 + c] * (1.0f - fx) + source[((size_t)y1 * width + x1) * 4 + c] * fx;
+				output[((size_t)y * newWidth + x) * 4 + c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+			}
+		}
+	}
+}
+
+void TextureCooker::Downsample(const std::vector<unsigned char>& rgba, int width, int height, std::vector<unsigned char>& output)
+{
+	int newWidth = width > 1 ? width / 2 : 1, newHeight = height > 1 ? height / 2 : 1;
+	output.resize((size_t)newWidth * newHeight * 4);
+
+	// 2x2 box filter, an odd last row/column is folded into its neighbour
+	for (int y = 0; y < newHeight; y++)
+	{
+		int y0 = y * 2, y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+		for (int x = 0; x < newWidth; x++)
+		{
+			int x0 = x * 2, x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+			for (int c = 0; c < 4; c++)
+			{
+				int sum = rgba[((size_t)y0 * width + x0) * 4 + c] + rgba[((size_t)y0 * width + x1) * 4 + c] +
+					rgba[((size_t)y1 * width + x0) * 4 + c] + rgba[((size_t)y1 * width + x1) * 4 + c];
+				output[((size_t)y * newWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+bool TextureCooker::Cook(const std::string& sourceLocation)
+{
+	std::vector<std::string> sourceLocations(1, sourceLocation);
+	std::vector<std::vector<unsigned char> > layers;
+	int width = 0, height = 0;
+	bool hasAlpha = false;
+	if (!LoadLayers(sourceLocations, layers, width, height, hasAlpha))
+	{
+		return false;
+	}
+
+	return WriteFile(KTXFile::GetCookedLocation(sourceLocation), layers, false, width, height, hasAlpha, MeshCache::HashFile(sourceLocation));
+}
+
+bool TextureCooker::CookArray(const std::vector<std::string>& sourceLocations, const std::string& cookedLocation)
+{
+	std::vector<std::vector<unsigned char> > layers;
+	int width = 0, height = 0;
+	bool hasAlpha = false;
+	if (!LoadLayers(sourceLocations, layers, width, height, hasAlpha))
+	{
+		return false;
+	}
+
+	return WriteFile(cookedLocation, layers, true, width, height, hasAlpha, HashSources(sourceLocations));
+}
+
+bool TextureCooker::LoadLayers(const std::vector<std::string>& sourceLocations, std::vector<std::vector<unsigned char> >& layers,
+	int& width, int& height, bool& hasAlpha)
+{
+	std::vector<int> widths(sourceLocations.size()), heights(sourceLocations.size());
+	layers.resize(sourceLocations.size());
+	width = 0;
+	height = 0;
+	hasAlpha = false;
+
+	for (size_t i = 0; i < sourceLocations.size(); i++)
+	{
+		int bitDepth = 0;
+		unsigned char* texData = AssetPack::DecodeImage(sourceLocations[i], &widths[i], &heights[i], &bitDepth, 4);
+		if (!texData)
+		{
+			printf("Failed to find: %s\n", sourceLocations[i].c_str());
+			return false;
+		}
+
+		layers[i].assign(texData, texData + (size_t)widths[i] * heights[i] * 4);
+		stbi_image_free(texData);
+
+		hasAlpha = hasAlpha || bitDepth == 2 || bitDepth == 4;
+		width = widths[i] > width ? widths[i] : width;
+		height = heights[i] > height ? heights[i] : height;
+	}
+
+	// Every layer of an array is the same size, smaller images are scaled up to the largest
+	std::vector<unsigned char> resized;
+	for (size_t i = 0; i < layers.size(); i++)
+	{
+		if (widths[i] != width || heights[i] != height)
+		{
+			printf("Resizing %s from %dx%d to %dx%d\n", sourceLocations[i].c_str(), widths[i], heights[i], width, height);
+			Resize(layers[i], widths[i], heights[i], width, height, resized);
+			layers[i].swap(resized);
+		}
+	}
+
+	return !layers.empty();
+}
+
+uint64_t TextureCooker::HashSources(const std::vector<std::string>& sourceLocations)
+{
+	// FNV-1a over the per-file hashes, so changing, adding or reordering any source changes the key
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < sourceLocations.size(); i++)
+	{
+		uint64_t fileHash = MeshCache::HashFile(sourceLocations[i]);
+		for (int byte = 0; byte < 8; byte++)
+		{
+			hash ^= (fileHash >> (byte * 8)) & 0xFF;
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	return hash;
+}
+
+bool TextureCooker::WriteFile(const std::string& cookedLocation, std::vector<std::vector<unsigned char> >& layers, bool isArray,
+	int width, int height, bool hasAlpha, uint64_t sourceHash)
+{
+	int levelCount = 1;
+	for (int size = width > height ? width : height; size > 1; size /= 2)
+	{
+		levelCount++;
+	}
+
+	KTXFile::Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.identifier, KTXFile::IDENTIFIER, sizeof(header.identifier));
+	header.endianness = 0x04030201;
+	header.glTypeSize = 1;
+	header.glInternalFormat = hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	header.glBaseInternalFormat = hasAlpha ? GL_RGBA : GL_RGB;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.numberOfArrayElements = isArray ? (uint32_t)layers.size() : 0;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = levelCount;
+
+	// One key/value pair recording which source image this was cooked from
+	char hashText[17];
+	snprintf(hashText, sizeof(hashText), "%016llx", (unsigned long long)sourceHash);
+	std::string keyAndValue(KTXFile::SOURCE_HASH_KEY, strlen(KTXFile::SOURCE_HASH_KEY) + 1);
+	keyAndValue.append(hashText, sizeof(hashText));
+	uint32_t keyAndValueSize = (uint32_t)keyAndValue.size();
+	uint32_t keyValuePadding = (4 - keyAndValueSize % 4) % 4;
+	header.bytesOfKeyValueData = 4 + keyAndValueSize + keyValuePadding;
+
+	std::ofstream fileStream(cookedLocation.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fileStream.is_open())
+	{
+		printf("Failed to write %s\n", cookedLocation.c_str());
+		return false;
+	}
+
+	const char padding[4] = { 0, 0, 0, 0 };
+	fileStream.write((const char*)&header, sizeof(header));
+	fileStream.write((const char*)&keyAndValueSize, 4);
+	fileStream.write(keyAndValue.c_str(), keyAndValueSize);
+	fileStream.write(padding, keyValuePadding);
+
+	// Each level's image size covers all of its layers, the layers follow it back to back
+	std::vector<unsigned char> compressed, levelData, smaller;
+	for (int level = 0; level < levelCount; level++)
+	{
+		levelData.clear();
+		for (size_t layer = 0; layer < layers.size(); layer++)
+		{
+			CompressImage(layers[layer], width, height, hasAlpha, compressed);
+			levelData.insert(levelData.end(), compressed.begin(), compressed.end());
+
+			if (level + 1 < levelCount)
+			{
+				Downsample(layers[layer], width, height, smaller);
+				layers[layer].swap(smaller);
+			}
+		}
+
+		uint32_t imageSize = (uint32_t)levelData.size();
+		fileStream.write((const char*)&imageSize, 4);
+		fileStream.write((const char*)&levelData[0], imageSize);
+
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	return fileStream.good();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Offline conversion of source images into GPU compressed KTX files with a precomputed mip chain.
+// Opaque images become BC1 (DXT1, 4 bits per pixel), images with alpha become BC3 (DXT5, 8 bits per pixel).
+class TextureCooker
+{
+public:
+	static bool Cook(const std::string& sourceLocation);
+	// One KTX texture array with a layer per source, in order, see TextureArray
+	static bool CookArray(const std::vector<std::string>& sourceLocations, const std::string& cookedLocation);
+
+	// Decodes every source to RGBA8 and scales them all to the largest width and height among them
+	static bool LoadLayers(const std::vector<std::string>& sourceLocations, std::vector<std::vector<unsigned char> >& layers,
+		int& width, int& height, bool& hasAlpha);
+	// Key recorded in a cooked array, changes when any of its sources do
+	static uint64_t HashSources(const std::vector<std::string>& sourceLocations);
+	static void Resize(const std::vector<unsigned char>& rgba, int width, int height, int newWidth, int newHeight, std::vector<unsigned char>& output);
+
+	// Each block is 4x4 RGBA8 pixels, row major
+	static void CompressBlockBC1(const unsigned char* block, unsigned char* output);
+	static void CompressBlockBC3(const unsigned char* block, unsigned char* output);
+
+private:
+	static void CompressColourBlock(const unsigned char* block, unsigned char* output, bool allowTransparentMode);
+	static void CompressAlphaBlock(const unsigned char* block, unsigned char* output);
+	static void CompressImage(const std::vector<unsigned char>& rgba, int width, int height, bool hasAlpha, std::vector<unsigned char>& output);
+	static void Downsample(const std::vector<unsigned char>& rgba, int width, int height, std::vector<unsigned char>& output);
+	// Compresses the layers and their mip chains, the layers are consumed by the downsampling
+	static bool WriteFile(const std::string& cookedLocation, std::vector<std::vector<unsigned char> >& layers, bool isArray,
+		int width, int height, bool hasAlpha, uint64_t sourceHash);
+};
@@ -0,0 +1,245 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <string.h>
+
+// std::min takes these by reference, which needs a definition
+const GLsizeiptr TextureStreamer::SLOT_SIZE;
+const GLsizeiptr TextureStreamer::FRAME_BUDGET;
+
+TextureStreamer::TextureStreamer()
+{
+	PBO = 0;
+	persistentData = NULL;
+	slot = 0;
+
+	for (unsigned int i = 0; i < SLOT_COUNT; i++)
+	{
+		fences[i] = 0;
+	}
+}
+
+void TextureStreamer::Create()
+{
+	glGenBuffers(1, &PBO);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+
+	// Mapped once for good where immutable buffers exist, otherwise each slot is mapped unsynchronized when it is filled
+	if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, SLOT_SIZE * SLOT_COUNT, NULL, flags);
+		persistentData = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, SLOT_SIZE * SLOT_COUNT, flags);
+	}
+	else
+	{
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, SLOT_SIZE * SLOT_COUNT, NULL, GL_STREAM_DRAW);
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+GLenum TextureStreamer::GetFormat(int bitDepth)
+{
+	switch (bitDepth)
+	{
+	case 1: return GL_RED;
+	case 2: return GL_RG;
+	case 4: return GL_RGBA;
+	default: return GL_RGB;
+	}
+}
+
+GLenum TextureStreamer::GetInternalFormat(int bitDepth)
+{
+	switch (bitDepth)
+	{
+	case 1: return GL_R8;
+	case 2: return GL_RG8;
+	case 4: return GL_RGBA8;
+	default: return GL_RGB8;
+	}
+}
+
+void TextureStreamer::Queue(Texture* target, unsigned char* pixels, int width, int height, int bitDepth)
+{
+	if (PBO == 0)
+	{
+		Create();
+	}
+
+	StreamJob job;
+	job.target = target;
+	job.pixels = pixels;
+	job.width = width;
+	job.height = height;
+	job.bitDepth = bitDepth;
+	job.nextRow = 0;
+
+	// Storage is allocated up front and never resized, the rows are filled in as the budget allows
+	GLsizei levels = 1;
+	while ((std::max(width, height) >> levels) > 0)
+	{
+		levels++;
+	}
+
+	glGenTextures(1, &job.textureID);
+	glBindTexture(GL_TEXTURE_2D, job.textureID);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// The mips are generated once the last row is in, see Update
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage)
+	{
+		glTexStorage2D(GL_TEXTURE_2D, levels, GetInternalFormat(bitDepth), width, height);
+	}
+	else
+	{
+		for (GLsizei i = 0; i < levels; i++)
+		{
+			glTexImage2D(GL_TEXTURE_2D, i, GetInternalFormat(bitDepth), std::max(width >> i, 1), std::max(height >> i, 1), 0,
+				GetFormat(bitDepth), GL_UNSIGNED_BYTE, NULL);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	jobs.push_back(job);
+}
+
+unsigned int TextureStreamer::Update()
+{
+	unsigned int finished = 0;
+	GLsizeiptr budget = FRAME_BUDGET;
+
+	// stb_image rows are tightly packed, an RGB row isn't necessarily a multiple of 4 bytes
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+
+	while (!jobs.empty())
+	{
+		StreamJob& job = jobs.front();
+		GLsizeiptr rowSize = (GLsizeiptr)job.width * job.bitDepth;
+		int rows = (int)(std::min(SLOT_SIZE, budget) / rowSize);
+		rows = std::min(rows, job.height - job.nextRow);
+
+		// A row wider than a whole slot can't be staged, upload that image directly
+		if (rowSize > SLOT_SIZE)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glBindTexture(GL_TEXTURE_2D, job.textureID);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, job.width, job.height, GetFormat(job.bitDepth), GL_UNSIGNED_BYTE, job.pixels);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+			rows = job.height - job.nextRow;
+		}
+		else
+		{
+			if (rows <= 0)
+			{
+				break;
+			}
+
+			// The next slot is still being read, the GPU is behind so carry on next frame
+			if (fences[slot] != 0)
+			{
+				if (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+				{
+					break;
+				}
+				glDeleteSync(fences[slot]);
+				fences[slot] = 0;
+			}
+
+			GLintptr offset = SLOT_SIZE * slot;
+			GLsizeiptr size = rowSize * rows;
+			const unsigned char* source = job.pixels + rowSize * job.nextRow;
+
+			if (persistentData != NULL)
+			{
+				memcpy(persistentData + offset, source, size);
+			}
+			else
+			{
+				void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size,
+					GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+				if (mapped)
+				{
+					memcpy(mapped, source, size);
+					glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				}
+				else
+				{
+					glBufferSubData(GL_PIXEL_UNPACK_BUFFER, offset, size, source);
+				}
+			}
+
+			glBindTexture(GL_TEXTURE_2D, job.textureID);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.nextRow, job.width, rows, GetFormat(job.bitDepth), GL_UNSIGNED_BYTE, (void*)offset);
+
+			fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			slot = (slot + 1) % SLOT_COUNT;
+			budget -= size;
+		}
+
+		job.nextRow += rows;
+		if (job.nextRow < job.height)
+		{
+			continue;
+		}
+
+		// Mips are built on the GPU from the finished top level
+		glGenerateMipmap(GL_TEXTURE_2D);
+		job.target->ReplaceTexture(job.textureID, job.width, job.height, job.bitDepth);
+		stbi_image_free(job.pixels);
+		jobs.pop_front();
+		finished++;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	return finished;
+}
+
+void TextureStreamer::Clear()
+{
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		glDeleteTextures(1, &jobs[i].textureID);
+		stbi_image_free(jobs[i].pixels);
+	}
+	jobs.clear();
+
+	for (unsigned int i = 0; i < SLOT_COUNT; i++)
+	{
+		if (fences[i] != 0)
+		{
+			glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+
+	if (PBO != 0)
+	{
+		if (persistentData != NULL)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &PBO);
+		PBO = 0;
+	}
+	persistentData = NULL;
+	slot = 0;
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	Clear();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <deque>
+
+#include <GL\glew.h>
+
+#include "Texture.h"
+
+// Uploads decoded images a slice of rows at a time through a ring of pixel buffer slots, so a
+// texture loaded mid-session costs a bounded memcpy per frame instead of one long glTexImage2D.
+// The ring is persistently mapped when the GL has buffer storage, each slot carries a fence
+// and is only written again once the GPU has finished copying out of it.
+class TextureStreamer
+{
+public:
+	static const unsigned int SLOT_COUNT = 4;
+	static const GLsizeiptr SLOT_SIZE = 2 * 1024 * 1024;
+	// Most bytes copied into the ring per Update
+	static const GLsizeiptr FRAME_BUDGET = 4 * 1024 * 1024;
+
+	TextureStreamer();
+
+	// Takes ownership of stb_image pixels. The target keeps its old texture, or none, until the
+	// last row is in, so it is never drawn half uploaded
+	void Queue(Texture* target, unsigned char* pixels, int width, int height, int bitDepth);
+	// GL thread, once per frame. Returns the number of textures finished
+	unsigned int Update();
+
+	bool IsBusy() { return !jobs.empty(); }
+
+	void Clear();
+
+	~TextureStreamer();
+
+private:
+	struct StreamJob
+	{
+		Texture* target;
+		GLuint textureID;
+		unsigned char* pixels;
+		int width, height, bitDepth;
+		int nextRow;
+	};
+
+	std::deque<StreamJob> jobs;
+
+	GLuint PBO;
+	unsigned char* persistentData;
+	GLsync fences[SLOT_COUNT];
+	unsigned int slot;
+
+	void Create();
+	static GLenum GetFormat(int bitDepth);
+	static GLenum GetInternalFormat(int bitDepth);
+};
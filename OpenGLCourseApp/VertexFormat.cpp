@@ -0,0 +1,116 @@
+#include "VertexFormat.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <glm\gtc\matrix_transform.hpp>
+#include <glm\gtc\packing.hpp>
+
+const float VertexFormat::POSITION_TOLERANCE = 0.005f;
+const float VertexFormat::UV_LIMIT = 2.0f;
+
+struct QuantizedVertex
+{
+	GLshort position[4];
+	GLuint normal;
+	GLuint uv;
+};
+
+GLsizei VertexFormat::GetStride(Type format)
+{
+	return format == QUANTIZED ? sizeof(QuantizedVertex) : sizeof(GLfloat) * FLOATS_PER_VERTEX;
+}
+
+const char* VertexFormat::GetName(Type format)
+{
+	return format == QUANTIZED ? "quantized" : "float";
+}
+
+void VertexFormat::SetAttributes(Type format)
+{
+	GLsizei stride = GetStride(format);
+
+	if (format == QUANTIZED)
+	{
+		glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, 0);
+		glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(QuantizedVertex, uv));
+		glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(QuantizedVertex, normal));
+	}
+	else
+	{
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, 0);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(GLfloat) * 3));
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(GLfloat) * 5));
+	}
+
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+}
+
+VertexFormat::Type VertexFormat::Choose(const GLfloat* vertices, unsigned int vertexCount)
+{
+	if (vertexCount == 0)
+	{
+		return FLOAT32;
+	}
+
+	glm::vec3 boundsMin(vertices[0], vertices[1], vertices[2]);
+	glm::vec3 boundsMax = boundsMin;
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const GLfloat* vertex = vertices + i * FLOATS_PER_VERTEX;
+		boundsMin = glm::min(boundsMin, glm::vec3(vertex[0], vertex[1], vertex[2]));
+		boundsMax = glm::max(boundsMax, glm::vec3(vertex[0], vertex[1], vertex[2]));
+
+		if (glm::abs(vertex[3]) > UV_LIMIT || glm::abs(vertex[4]) > UV_LIMIT)
+		{
+			return FLOAT32;
+		}
+	}
+
+	// One scale for all axes, the error is half a step of the largest extent
+	glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+	float scale = glm::max(extent.x, glm::max(extent.y, extent.z));
+	if (scale / 32767.0f * 0.5f > POSITION_TOLERANCE)
+	{
+		return FLOAT32;
+	}
+
+	return QUANTIZED;
+}
+
+void VertexFormat::Quantize(const GLfloat* vertices, unsigned int vertexCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+	unsigned char* packed, glm::mat4& dequantize)
+{
+	// Uniform scale keeps the dequantize transform a similarity, so normals only need renormalizing
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+	float scale = glm::max(extent.x, glm::max(extent.y, extent.z));
+	if (scale <= 0.0f)
+	{
+		scale = 1.0f;
+	}
+
+	dequantize = glm::translate(glm::mat4(1.0f), center);
+	dequantize = glm::scale(dequantize, glm::vec3(scale));
+
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const GLfloat* vertex = vertices + i * FLOATS_PER_VERTEX;
+		glm::vec3 position = (glm::vec3(vertex[0], vertex[1], vertex[2]) - center) / scale;
+		glm::vec3 normal(vertex[5], vertex[6], vertex[7]);
+		float length = glm::length(normal);
+		normal = length > 0.0f ? normal / length : normal;
+
+		QuantizedVertex quantized;
+		quantized.position[0] = (GLshort)glm::packSnorm1x16(position.x);
+		quantized.position[1] = (GLshort)glm::packSnorm1x16(position.y);
+		quantized.position[2] = (GLshort)glm::packSnorm1x16(position.z);
+		quantized.position[3] = 0;
+		quantized.normal = glm::packSnorm3x10_1x2(glm::vec4(normal, 0.0f));
+		quantized.uv = glm::packHalf2x16(glm::vec2(vertex[3], vertex[4]));
+
+		memcpy(packed + i * sizeof(QuantizedVertex), &quantized, sizeof(QuantizedVertex));
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+
+#include <GL\glew.h>
+
+#include <glm\glm.hpp>
+
+// Vertex layouts a Mesh can be stored in. Every layout feeds the same shader inputs:
+// position at location 0, uv at 1 and normal at 2.
+class VertexFormat
+{
+public:
+	enum Type
+	{
+		// x y z, u v, nx ny nz as floats, 32 bytes
+		FLOAT32 = 0,
+		// snorm16 x y z + padding, 2_10_10_10 normal, half float u v, 16 bytes.
+		// Positions are relative to the mesh bounds, the dequantize transform maps them back.
+		QUANTIZED = 1
+	};
+
+	static const unsigned int FLOATS_PER_VERTEX = 8;
+
+	// Largest position error accepted from 16 bit positions, in model units
+	static const float POSITION_TOLERANCE;
+	// Half floats keep 1/2048 precision only below 2.0, tiled uvs stay in floats
+	static const float UV_LIMIT;
+
+	static GLsizei GetStride(Type format);
+	static const char* GetName(Type format);
+
+	// Attribute pointers 0-2 for the GL_ARRAY_BUFFER currently bound, starting at offset 0
+	static void SetAttributes(Type format);
+
+	// Picks QUANTIZED when the mesh fits it within tolerance, vertices are in the FLOAT32 layout
+	static Type Choose(const GLfloat* vertices, unsigned int vertexCount);
+
+	// Converts FLOAT32 vertices to QUANTIZED, dequantize maps the stored positions back to model space.
+	// packed takes GetStride(QUANTIZED) bytes per vertex and is written front to back, so it can be a mapped buffer
+	static void Quantize(const GLfloat* vertices, unsigned int vertexCount, const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+		unsigned char* packed, glm::mat4& dequantize);
+};
@@ -12,6 +12,7 @@ Window::Window()
 	
 	xChange = 0.0f;
 	yChange = 0.0f;
+	headless = false;
 }
 
 Window::Window(GLint windowWidth, GLint windowHeight)
@@ -26,10 +27,32 @@ Window::Window(GLint windowWidth, GLint windowHeight)
 	
 	xChange = 0.0f;
 	yChange = 0.0f;
+	headless = false;
+}
+
+Window::Window(GLint windowWidth, GLint windowHeight, bool headlessContext)
+{
+	width = windowWidth;
+	height = windowHeight;
+
+	for (size_t i = 0; i < 1024; i++)
+	{
+		keys[i] = 0;
+	}
+
+	xChange = 0.0f;
+	yChange = 0.0f;
+	headless = headlessContext;
 }
 
 int Window::Initialise()
 {
+	if (headless)
+	{
+		// No display server needed, the context comes from OSMesa (Mesa llvmpipe) below
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	}
+
 	if (!glfwInit())
 	{
 		printf("Error Initialising GLFW");
@@ -47,7 +70,14 @@ int Window::Initialise()
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
 	// Create the window
-	mainWindow = glfwCreateWindow(width, height, "Test Window", NULL, NULL);
+	if (headless)
+	{
+		mainWindow = createHeadlessWindow();
+	}
+	else
+	{
+		mainWindow = glfwCreateWindow(width, height, "Test Window", NULL, NULL);
+	}
 	if (!mainWindow)
 	{
 		printf("Error creating GLFW window!");
@@ -83,6 +113,37 @@ int Window::Initialise()
 	glViewport(0, 0, bufferWidth, bufferHeight);
 
 	glfwSetWindowUserPointer(mainWindow, this);
+
+	return 0;
+}
+
+GLFWwindow* Window::createHeadlessWindow()
+{
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+
+	GLFWwindow* window = glfwCreateWindow(width, height, "Test Window", NULL, NULL);
+	if (window)
+	{
+		return window;
+	}
+
+	// GLFW built without OSMesa, fall back to a hidden window on the native platform
+	printf("OSMesa context unavailable, using a hidden window\n");
+	glfwTerminate();
+	glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+	if (!glfwInit())
+	{
+		return NULL;
+	}
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	return glfwCreateWindow(width, height, "Test Window", NULL, NULL);
 }
 
 void Window::createCallbacks()
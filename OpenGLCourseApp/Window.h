@@ -12,6 +12,9 @@ public:
 
 	Window(GLint windowWidth, GLint windowHeight);
 
+	// A headless window never shows up, it only owns a context for rendering offscreen
+	Window(GLint windowWidth, GLint windowHeight, bool headlessContext);
+
 	int Initialise();
 
 	GLint getBufferWidth() { return bufferWidth; }
@@ -19,6 +22,8 @@ public:
 
 	bool getShouldClose() { return glfwWindowShouldClose(mainWindow); }
 
+	bool isHeadless() { return headless; }
+
 	bool* getsKeys() { return keys; }
 	GLfloat getXChange();
 	GLfloat getYChange();
@@ -34,6 +39,7 @@ private:
 
 	GLint width, height;
 	GLint bufferWidth, bufferHeight;
+	bool headless;
 
 	bool keys[1024];
 
@@ -43,6 +49,7 @@ private:
 	GLfloat yChange;
 	bool mouseFirstMoved;
 
+	GLFWwindow* createHeadlessWindow();
 	void createCallbacks();
 	static void handleKeys(GLFWwindow* window, int key, int code, int action, int mode);
 	static void handleMouse(GLFWwindow* window, double xPos, double yPos);
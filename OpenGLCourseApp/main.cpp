@@ -2,7 +2,9 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <cmath>
+#include <fstream>
 #include <vector>
 
 #include <GL/glew.h>
@@ -12,10 +14,6 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-
 #include <irrKlang.h>
 
 #include "imgui.h"
@@ -25,34 +23,103 @@
 #include "Window.h"
 #include "Mesh.h"
 #include "Shader.h"
+#include "ShaderVariants.h"
 #include "Camera.h"
 #include "Texture.h"
 #include "Light.h"
+#include "InstanceBatch.h"
+#include "RenderQueue.h"
+#include "GLStateCache.h"
+#include "StaticGeometry.h"
+#include "MeshData.h"
+#include "MeshCache.h"
+#include "ModelImporter.h"
+#include "ImportProfiler.h"
+#include "AssetLoader.h"
+#include "TextureCooker.h"
+#include "TextureArray.h"
+#include "Frustum.h"
+#include "LodSelector.h"
+#include "FrameUniformBuffer.h"
+#include "LightClusters.h"
+#include "SceneGraph.h"
+#include "Profiler.h"
+#include "Benchmark.h"
+#include "Framebuffer.h"
+#include "FrameGraph.h"
+#include "AssetPack.h"
+#include "PackFileFactory.h"
 
 float trainPosition = -200.0f;
 float wheelRotation = 0.0f;
 const float toRadians = 3.14159265f / 180.0f;
 bool run_animation = false;
 int animation_scene = 0; // 0: The trolley turn, 1: the trolley moves straight  
+int bystanderCount = 0; // Extra copies of the humans standing beside the track
 
 Window mainWindow;
 std::vector<Mesh*> plane_mesh, trolley_mesh, rail_mesh[3], wheel_mesh[6], human_mesh[7], rope_mesh, leaver_mesh;
-std::vector<Shader> shaderList;
+// Every draw picks its variant from the mesh, texture and transform, see ShaderVariants
+ShaderVariants sceneShaders;
 Camera camera;
 
 Texture dirt, trolley, rail, human[7], rope, leaver;
+// The seven human textures are layers of one array, so the humans don't need a draw per texture
+TextureArray humanTextures;
+const char* HUMAN_TEXTURE_ARRAY = "Textures/humans.ktx";
 
 DirectionalLight dLight(1.0f, 1.0f, 1.0f, 0.5f, 0.8f, 1.0f);
 
 GLfloat deltaTime = 0.0f;
 GLfloat lastTime = 0.0f;
 
-// Vertex Shader
+// Vertex Shader, plain and instanced draws are permutations of it
 static const char* vShader = "Shaders/shader.vert";
 
 // Fragment Shader
 static const char* fShader = "Shaders/shader.frag";
 
+static const char* music = "Music/FreeBird.mp3";
+
+// Built by "--pack", mounted at startup when it is there
+static const char* ASSET_PACK = "assets.pak";
+// Written by "--import-report", the presets file is read at startup when it is there
+static const char* IMPORT_REPORT = "import_report.json";
+static const char* IMPORT_PRESETS = "import_presets.txt";
+
+// Wheels, from blender x y z to opengl: x -> 0, -z -> y, y -> z
+static const glm::vec3 wheelCenters[] = {
+    glm::vec3(0.0f, -1.98191f, 3.6229f),
+    glm::vec3(0.0f, -1.78191f, 0.056396f),
+    glm::vec3(0.0f, -1.78191f, -3.2106f),
+    glm::vec3(0.0f, -1.78191f, -3.2106f),
+    glm::vec3(0.0f, -1.78191f, 0.056396f),
+    glm::vec3(0.0f, -1.98191f, 3.6229f),
+};
+
+// Headlights in trolley space, at the front corners of the body
+static const glm::vec3 headlightOffsets[] = {
+    glm::vec3(-1.2f, 0.5f, 5.2f),
+    glm::vec3(1.2f, 0.5f, 5.2f),
+};
+
+// The two headlights come first and are moved every frame, then lanterns along both sides
+// of the track and the signal lamps at the junction. See LightClusters
+std::vector<PointLight> CreatePointLights() {
+    std::vector<PointLight> lights;
+    for (int i = 0; i < 2; i++) {
+        lights.push_back(PointLight(1.0f, 0.95f, 0.8f, 0.0f, 2.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.09f, 0.032f));
+    }
+    for (int i = 0; i < 20; i++) {
+        float z = -190.0f + 20.0f * i;
+        lights.push_back(PointLight(1.0f, 0.7f, 0.35f, 0.0f, 1.5f, 0.5f, -8.0f, 4.0f, z, 1.0f, 0.35f, 0.44f));
+        lights.push_back(PointLight(1.0f, 0.7f, 0.35f, 0.0f, 1.5f, 0.5f, 8.0f, 4.0f, z, 1.0f, 0.35f, 0.44f));
+    }
+    lights.push_back(PointLight(1.0f, 0.1f, 0.1f, 0.0f, 1.0f, 0.5f, -4.0f, 6.0f, 60.0f, 1.0f, 0.7f, 1.8f));
+    lights.push_back(PointLight(0.1f, 1.0f, 0.2f, 0.0f, 1.0f, 0.5f, 4.0f, 6.0f, 60.0f, 1.0f, 0.7f, 1.8f));
+    return lights;
+}
+
 //void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
 //{
 //    if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
@@ -64,58 +131,155 @@ static const char* fShader = "Shaders/shader.frag";
 //}
 
 
-void LoadMesh(aiMesh* mesh, const aiScene* scene, std::vector<Mesh*>& meshList) {
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
+std::vector<std::string> GetModelFiles() {
+    std::vector<std::string> files;
+    files.push_back("OBJ/trolley_body.obj");
+    for (int i = 0; i < 6; i++) {
+        files.push_back("OBJ/wheel" + std::to_string(i + 1) + ".obj");
+    }
+    for (int i = 0; i < 3; i++) {
+        files.push_back("OBJ/rail" + std::to_string(i + 1) + ".obj");
+    }
+    for (int i = 0; i < 7; i++) {
+        files.push_back("OBJ/human" + std::to_string(i + 1) + ".obj");
+    }
+    files.push_back("OBJ/rope1.obj");
+    files.push_back("OBJ/leaver.obj");
+    return files;
+}
+
+std::vector<std::string> GetTextureFiles() {
+    std::vector<std::string> files;
+    files.push_back("Textures/dirt.jpg");
+    files.push_back("Textures/trolley.jpg");
+    files.push_back("Textures/rail.jpg");
+    files.push_back("Textures/rope.jpg");
+    return files;
+}
 
-    for (size_t i = 0; i < mesh->mNumVertices; i++) {
-        vertices.insert(vertices.end(), { mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z });
-        if (mesh->mTextureCoords[0]) {
-            vertices.insert(vertices.end(), { mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y });
+// Layers of HUMAN_TEXTURE_ARRAY, layer i is human[i]
+std::vector<std::string> GetHumanTextureFiles() {
+    std::vector<std::string> files;
+    for (int i = 0; i < 7; i++) {
+        files.push_back("Textures/human" + std::to_string(i + 1) + ".jpg");
+    }
+    return files;
+}
+
+// Offline cooking, "--cook" rebuilds every .tmesh and .ktx without opening a window
+int CookAllAssets() {
+    std::vector<std::string> files = GetModelFiles();
+    ModelImporter importer;
+    int failed = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        std::vector<MeshData> meshDataList;
+        if (importer.Cook(files[i], ModelImporter::HashSource(files[i]), meshDataList)) {
+            printf("Cooked %s (%zu meshes)\n", files[i].c_str(), meshDataList.size());
         }
         else {
-            vertices.insert(vertices.end(), { 0.0f, 0.0f });
+            failed++;
         }
-        // Check if mNormals exists before trying to access it
-        if (mesh->mNormals) {
-            vertices.insert(vertices.end(), { mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z });
+    }
+
+    files = GetTextureFiles();
+    for (size_t i = 0; i < files.size(); i++) {
+        if (TextureCooker::Cook(files[i])) {
+            printf("Cooked %s\n", files[i].c_str());
         }
         else {
-            vertices.insert(vertices.end(), { 0.0f, 0.0f, 0.0f }); // Insert default normal values
+            failed++;
         }
     }
 
-    for (size_t i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
-        for (size_t j = 0; j < face.mNumIndices; j++) {
-            indices.push_back(face.mIndices[j]);
-        }
+    if (TextureCooker::CookArray(GetHumanTextureFiles(), HUMAN_TEXTURE_ARRAY)) {
+        printf("Cooked %s\n", HUMAN_TEXTURE_ARRAY);
     }
+    else {
+        failed++;
+    }
+    return failed == 0 ? 0 : 1;
+}
 
-    Mesh* newMesh = new Mesh();
-    newMesh->CreateMesh(&vertices[0], &indices[0], vertices.size(), indices.size());
-    meshList.push_back(newMesh);
+// .mtl files an OBJ names, beside the OBJ the way Assimp looks for them
+std::vector<std::string> GetMaterialLibraries(const std::string& objLocation) {
+    std::vector<std::string> libraries;
+    std::ifstream objStream(objLocation.c_str());
+    size_t slash = objLocation.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? "" : objLocation.substr(0, slash + 1);
+
+    std::string line;
+    while (std::getline(objStream, line)) {
+        if (line.compare(0, 7, "mtllib ") != 0) {
+            continue;
+        }
+        size_t end = line.find_last_not_of(" \t\r");
+        libraries.push_back(directory + line.substr(7, end - 6));
+    }
+    return libraries;
 }
 
-void LoadNode(aiNode* node, const aiScene* scene, std::vector<Mesh*>& meshList) {
-    for (size_t i = 0; i < node->mNumMeshes; i++) {
-        LoadMesh(scene->mMeshes[node->mMeshes[i]], scene, meshList);
+// Everything the app reads at startup. Cooked files and images are stored so they can be used
+// in place, the sources of the cooked files go in too so their hashes can be checked
+std::vector<AssetPack::Source> GetPackSources() {
+    std::vector<AssetPack::Source> sources;
+    auto add = [&sources](const std::string& fileLocation, bool compress) {
+        AssetPack::Source source = { fileLocation, compress };
+        sources.push_back(source);
+    };
+
+    std::vector<std::string> files = GetModelFiles();
+    for (size_t i = 0; i < files.size(); i++) {
+        add(files[i], true);
+        add(MeshCache::GetCacheLocation(files[i]), false);
+        std::vector<std::string> libraries = GetMaterialLibraries(files[i]);
+        for (size_t j = 0; j < libraries.size(); j++) {
+            add(libraries[j], true);
+        }
     }
 
-    for (size_t i = 0; i < node->mNumChildren; i++) {
-        LoadNode(node->mChildren[i], scene, meshList);
+    files = GetTextureFiles();
+    for (size_t i = 0; i < files.size(); i++) {
+        add(files[i], false);
+        add(KTXFile::GetCookedLocation(files[i]), false);
+    }
+    files = GetHumanTextureFiles();
+    for (size_t i = 0; i < files.size(); i++) {
+        add(files[i], false);
     }
+    add(HUMAN_TEXTURE_ARRAY, false);
+
+    add(vShader, true);
+    add(fShader, true);
+    add(music, false);
+    return sources;
 }
 
-void LoadModel(const std::string& filePath, std::vector<Mesh*>& meshList) {
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(filePath, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_JoinIdenticalVertices);
-    if (!scene) {
-        printf("Model (%s) failed to load: %s", filePath.c_str(), importer.GetErrorString());
-        return;
+// "--import-report [file]" imports every model with each ModelImporter preset and reports where the time goes
+int ReportImports(const char* reportLocation) {
+    std::vector<std::string> files = GetModelFiles();
+    std::vector<ImportProfiler::Record> records;
+    ImportProfiler::Enable();
+    ModelImporter importer;
+    for (size_t i = 0; i < files.size(); i++) {
+        // Reads the file once so every preset starts from the page cache
+        MeshCache::HashFile(files[i]);
+        for (unsigned int j = 0; j < ModelImporter::PRESET_COUNT; j++) {
+            std::vector<MeshData> meshDataList;
+            records.push_back(ImportProfiler::Record());
+            importer.Import(files[i], meshDataList, ModelImporter::PRESETS[j], &records.back());
+        }
     }
+    ImportProfiler::Disable();
+    return ImportProfiler::WriteReport(records, reportLocation) ? 0 : 1;
+}
 
-    LoadNode(scene->mRootNode, scene, meshList);
+// "--pack [file]" cooks everything and writes the asset pack
+int PackAllAssets(const char* packLocation) {
+    if (CookAllAssets() != 0) {
+        printf("Cooking failed, not writing %s\n", packLocation);
+        return 1;
+    }
+    return AssetPack::Write(packLocation, GetPackSources()) ? 0 : 1;
 }
 
 void CreateObjects() {
@@ -138,9 +302,41 @@ void CreateObjects() {
 }
 
 void CreateShaders() {
-    Shader* shader1 = new Shader();
-    shader1->CreateFromFiles(vShader, fShader);
-    shaderList.push_back(*shader1);
+    sceneShaders.CreateFromFiles(vShader, fShader);
+}
+
+// Trolley placement for the selected scenario, the wheels inherit it through the scene graph
+glm::mat4 GetTrolleyTransform() {
+    glm::mat4 model(1.0f);
+    switch (animation_scene) {
+    case 0:
+        // First movement scenario
+        if (trainPosition < 60.0f) {
+            model = glm::translate(model, glm::vec3(0.0f, 0.0f, trainPosition));
+        }
+        else {
+            float diagonalPosition = trainPosition - 60.0f;
+            model = glm::translate(model, glm::vec3(diagonalPosition, 0.0f, 60.0f + diagonalPosition));
+            model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+        break;
+    case 1:
+        // Second movement scenario
+        model = glm::translate(model, glm::vec3(0.0f, 0.0f, trainPosition));
+        break;
+    case 2:
+        // Third movement scenario
+        if (trainPosition < 25.0f) {
+            model = glm::translate(model, glm::vec3(0.0f, 0.0f, trainPosition));
+        }
+        else {
+            float upwardPosition = trainPosition - 25.0f;
+            model = glm::translate(model, glm::vec3(0.0f, upwardPosition * glm::tan(glm::radians(30.0f)), 25.0f + upwardPosition));
+            model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+        }
+        break;
+    }
+    return model;
 }
 
 bool debugEnabled = true;
@@ -151,8 +347,51 @@ void debugPrint(const std::string& message) {
     }
 }
 
-int main() {
-    mainWindow = Window(1600, 900);
+int main(int argc, char* argv[]) {
+    // Without it every model uses the default preset. Read first, cooking depends on it
+    ModelImporter::LoadPresets(IMPORT_PRESETS);
+
+    if (argc > 1 && strcmp(argv[1], "--cook") == 0) {
+        return CookAllAssets();
+    }
+    if (argc > 1 && strcmp(argv[1], "--pack") == 0) {
+        return PackAllAssets(argc > 2 ? argv[2] : ASSET_PACK);
+    }
+    if (argc > 1 && strcmp(argv[1], "--import-report") == 0) {
+        return ReportImports(argc > 2 ? argv[2] : IMPORT_REPORT);
+    }
+
+    // Loose files are used when there is no pack
+    if (AssetPack::Mount(ASSET_PACK)) {
+        printf("Mounted %s (%zu files)\n", ASSET_PACK, AssetPack::GetMounted()->GetFileCount());
+    }
+
+    float velocity = 15.0f;
+
+    // --bench [frames] [--bench-out file] plays every scene offscreen at a fixed timestep.
+    // Each scene starts the trolley at -200 and they only part ways at 60, where the first one
+    // turns, so every scene has to play at least that far. The default runs 40 units past it
+    bool benchMode = false;
+    unsigned int benchMinimumFrames = (unsigned int)ceil((60.0f + 200.0f) / (velocity * Benchmark::TIMESTEP));
+    unsigned int benchFrames = benchMinimumFrames + 160;
+    std::string benchOutput = "bench.json";
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            benchMode = true;
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') {
+                benchFrames = (unsigned int)atoi(argv[++i]);
+            }
+        }
+        else if (strcmp(argv[i], "--bench-out") == 0 && i + 1 < argc) {
+            benchOutput = argv[++i];
+        }
+    }
+    if (benchMode && benchFrames < benchMinimumFrames) {
+        printf("--bench needs at least %u frames per scene for the scenes to differ\n", benchMinimumFrames);
+        return 1;
+    }
+
+    mainWindow = Window(1600, 900, benchMode);
     mainWindow.Initialise();
 
     glfwSetInputMode(mainWindow.getGLFWWindow(), GLFW_CURSOR, GLFW_CURSOR_NORMAL);
@@ -170,44 +409,129 @@ int main() {
     CreateObjects();
     CreateShaders();
 
-    // Load models
-    LoadModel("OBJ/trolley_body.obj", trolley_mesh);
+    // Decode models and textures on worker threads, the GL objects are created here as they arrive
+    unsigned int workerCount = std::thread::hardware_concurrency();
+    workerCount = workerCount > 1 ? (workerCount - 1 < 8 ? workerCount - 1 : 8) : 1;
+    AssetLoader assetLoader(workerCount);
+
+    // Load models, same order as GetModelFiles
+    std::vector<std::string> modelFiles = GetModelFiles();
+    size_t modelIndex = 0;
+    assetLoader.QueueModel(modelFiles[modelIndex++], &trolley_mesh);
     for (int i = 0; i < 6; i++) {
-        std::string filePath = "OBJ/wheel" + std::to_string(i + 1) + ".obj";
-        LoadModel(filePath, wheel_mesh[i]);
+        assetLoader.QueueModel(modelFiles[modelIndex++], &wheel_mesh[i]);
     }
     for (int i = 0; i < 3; i++) {
-        std::string filePath = "OBJ/rail" + std::to_string(i + 1) + ".obj";
-        LoadModel(filePath, rail_mesh[i]);
+        assetLoader.QueueModel(modelFiles[modelIndex++], &rail_mesh[i]);
     }
     for (int i = 0; i < 7; i++) {
-        std::string filePath = "OBJ/human" + std::to_string(i + 1) + ".obj";
-        LoadModel(filePath, human_mesh[i]);
+        assetLoader.QueueModel(modelFiles[modelIndex++], &human_mesh[i]);
     }
-    LoadModel("OBJ/rope1.obj", rope_mesh);
-    LoadModel("OBJ/leaver.obj", leaver_mesh);
+    assetLoader.QueueModel(modelFiles[modelIndex++], &rope_mesh);
+    assetLoader.QueueModel(modelFiles[modelIndex++], &leaver_mesh);
 
     camera = Camera(glm::vec3(-30.0f, 30.0f, 100.0f - 200.0f), glm::vec3(0.0f, 1.0f, 0.0f), -45.0f, -30.0f, 5.0f, 0.2f);
 
-    // Assign textures
-    dirt = Texture("Textures/dirt.jpg");
-    trolley = Texture("Textures/trolley.jpg");
-    rail = Texture("Textures/rail.jpg");
+    // Assign textures, same order as GetTextureFiles
+    std::vector<std::string> textureFiles = GetTextureFiles();
+    size_t textureIndex = 0;
+    dirt = Texture(textureFiles[textureIndex++]);
+    trolley = Texture(textureFiles[textureIndex++]);
+    rail = Texture(textureFiles[textureIndex++]);
+    rope = Texture(textureFiles[textureIndex++]);
+
+    std::vector<std::string> humanTextureFiles = GetHumanTextureFiles();
+    humanTextures = TextureArray(humanTextureFiles, HUMAN_TEXTURE_ARRAY);
     for (int i = 0; i < 7; i++) {
-        std::string filePath = "Textures/human" + std::to_string(i + 1) + ".jpg";
-        human[i] = Texture(filePath);
+        human[i] = Texture(humanTextureFiles[i]);
+        human[i].SetArrayLayer(&humanTextures, i);
     }
-    rope = Texture("Textures/rope.jpg");
-    dirt.LoadTexture();
-    trolley.LoadTexture();
-    rail.LoadTexture();
-    for (int i = 0; i < 7; i++) {
-        human[i].LoadTexture();
+
+    // Also used to reload them mid-session, the streamer swaps each one in once it is complete.
+    // The human array is decoded on a worker too but uploaded in one go, all its layers are needed for the first draw
+    auto queueTextures = [&assetLoader]() {
+        assetLoader.QueueTexture(&dirt);
+        assetLoader.QueueTexture(&trolley);
+        assetLoader.QueueTexture(&rail);
+        assetLoader.QueueTexture(&rope);
+        assetLoader.QueueTextureArray(&humanTextures);
+    };
+    queueTextures();
+
+    assetLoader.Finish();
+
+    // The trolley carries the six wheels, rails and humans are static nodes
+    SceneGraph sceneGraph;
+    int trolleyNode = sceneGraph.AddNode(SceneGraph::NO_PARENT, GetTrolleyTransform());
+    int wheelNodes[6];
+    for (int j = 0; j < 6; j++) {
+        wheelNodes[j] = sceneGraph.AddNode(trolleyNode, glm::mat4(1.0f));
+    }
+    int railNodes[3];
+    for (int j = 0; j < 3; j++) {
+        railNodes[j] = sceneGraph.AddNode(SceneGraph::NO_PARENT, glm::mat4(1.0f));
+    }
+    int humanNodes[7];
+    for (int j = 0; j < 7; j++) {
+        humanNodes[j] = sceneGraph.AddNode(SceneGraph::NO_PARENT, glm::mat4(1.0f));
+    }
+    sceneGraph.UpdateTransforms();
+    int lastScene = animation_scene;
+
+    // Everything that never moves is merged into one arena, the grass plane is drawn twice
+    StaticGeometry staticGeometry;
+    staticGeometry.Add(plane_mesh[0], &dirt, glm::mat4(1.0f));
+    staticGeometry.Add(plane_mesh[0], &dirt, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 200.0f)));
+    for (int j = 0; j < 2; j++) {
+        staticGeometry.Add(rail_mesh[j], &rail, sceneGraph.GetWorldTransform(railNodes[j]));
+    }
+    for (int j = 0; j < 7; j++) {
+        staticGeometry.Add(human_mesh[j], &human[j], sceneGraph.GetWorldTransform(humanNodes[j]));
+    }
+    staticGeometry.Add(rope_mesh, &rope, glm::mat4(1.0f));
+    staticGeometry.Add(leaver_mesh, &rope, glm::mat4(1.0f));
+    staticGeometry.Build();
+
+    // The arena holds its own copy of these, only the humans are still drawn from their own
+    // buffers, as the instanced bystanders
+    plane_mesh[0]->ReleaseBuffers();
+    for (int j = 0; j < 2; j++) {
+        for (size_t i = 0; i < rail_mesh[j].size(); i++) {
+            rail_mesh[j][i]->ReleaseBuffers();
+        }
+    }
+    for (size_t i = 0; i < rope_mesh.size(); i++) {
+        rope_mesh[i]->ReleaseBuffers();
+    }
+    for (size_t i = 0; i < leaver_mesh.size(); i++) {
+        leaver_mesh[i]->ReleaseBuffers();
+    }
+
+    // Variants are compiled on first use, build the ones the scene draws with now rather than
+    // in the middle of its first frame. Plain draws pick UNIFORM_SCALE from each frame's model
+    // matrix, so they get both
+    staticGeometry.CompileShaders(&sceneShaders);
+    auto compileShaders = [](const std::vector<Mesh*>& meshList, Texture* texture, bool instanced) {
+        for (size_t i = 0; i < meshList.size(); i++) {
+            unsigned int features = ShaderVariants::GetFeatures(meshList[i], texture);
+            if (instanced) {
+                sceneShaders.Get(features | ShaderVariants::INSTANCED);
+            }
+            else {
+                sceneShaders.Get(features);
+                sceneShaders.Get(features | ShaderVariants::UNIFORM_SCALE);
+            }
+        }
+    };
+    compileShaders(trolley_mesh, &trolley, false);
+    compileShaders(rail_mesh[2], &rail, false);
+    for (int j = 0; j < 6; j++) {
+        compileShaders(wheel_mesh[j], &trolley, true);
+    }
+    for (int j = 0; j < 7; j++) {
+        compileShaders(human_mesh[j], &human[j], true);
     }
-    rope.LoadTexture();
 
-    GLuint uniformProjection = 0, uniformModel = 0, uniformView = 0, uniformAmbientIntensity = 0,
-        uniformAmbientColour = 0, uniformDiffuseIntensity = 0, uniformSpecularIntensity = 0, uniformLightDirection = 0;
     glm::mat4 projection = glm::perspective(glm::radians(45.0f), (GLfloat)mainWindow.getBufferWidth() / mainWindow.getBufferHeight(), 0.1f, 1000.0f);
 
     float targetYaw = -45.0f;
@@ -215,14 +539,62 @@ int main() {
     float turnrad = 0.0f;
     run_animation = 1; 
     float yr = 0.0f ,zr = 0.0f;
-    irrklang::ISoundEngine* SoundEngine = irrklang::createIrrKlangDevice();
+    irrklang::ISoundEngine* SoundEngine = benchMode ? NULL : irrklang::createIrrKlangDevice();
+    if (SoundEngine && AssetPack::GetMounted()) {
+        PackFileFactory* packFiles = new PackFileFactory();
+        SoundEngine->addFileFactory(packFiles);
+        packFiles->drop();
+    }
     bool sound_played = false;
-    float velocity = 15.0f;
+    InstanceBatch instanceBatch;
+    RenderQueue renderQueue;
+    Frustum frustum;
+    LodSelector lodSelector;
+    FrameUniformBuffer frameUniforms;
+    frameUniforms.Create();
+    LightClusters lightClusters;
+    lightClusters.Create();
+    FrameGraph frameGraph;
+    std::vector<PointLight> pointLights = CreatePointLights();
+    GLStateCache stateCache;
+    Profiler profiler;
+    profiler.Create();
+
+    Framebuffer benchTarget;
+    Benchmark benchmark;
+    int exitCode = 0;
+    if (benchMode) {
+        // Without a target nothing is rendered, fall through to the cleanup below
+        if (benchTarget.Create(mainWindow.getBufferWidth(), mainWindow.getBufferHeight())) {
+            benchmark.Start(benchFrames, benchOutput);
+        }
+        else {
+            exitCode = 1;
+        }
+    }
 
     // Loop until window closed
-    while (!mainWindow.getShouldClose()) {
+    while (!mainWindow.getShouldClose() && exitCode == 0) {
+        profiler.BeginFrame();
+
+        if (benchmark.IsSceneStart()) {
+            // Every benchmarked scene starts from the same state as a fresh run
+            animation_scene = benchmark.GetScene();
+            trainPosition = -200.0f;
+            wheelRotation = 0.0f;
+            camera = Camera(glm::vec3(-30.0f, 30.0f, 100.0f - 200.0f), glm::vec3(0.0f, 1.0f, 0.0f), -45.0f, -30.0f, 5.0f, 0.2f);
+            targetYaw = -45.0f;
+            targetPtich = -30.0f;
+            turnrad = 0.0f, yr = 0.0f, zr = 0.0f;
+            sceneGraph.SetLocalTransform(railNodes[2], glm::mat4(1.0f));
+            lastScene = -1;
+        }
+        if (benchMode) {
+            benchmark.BeginFrame();
+        }
+
         GLfloat now = glfwGetTime();
-        deltaTime = now - lastTime;
+        deltaTime = benchMode ? Benchmark::TIMESTEP : now - lastTime;
         lastTime = now;
 
         if (trainPosition >= 0.0) {
@@ -239,9 +611,8 @@ int main() {
         // Get + Handle User Input
         glfwPollEvents();
 
-        // Clear the window
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Textures loaded mid-session come in a few rows per frame instead of stalling one
+        assetLoader.PumpUploads();
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -258,230 +629,175 @@ int main() {
                 ImGui::Combo("Animation Scene", &animation_scene, "The trolley turn\0The trolley moves straight\0The trolley goes up\0");
 		    }
 
-        if(animation_scene == 2 && trainPosition >= -35.0f && !sound_played) {
-			SoundEngine->play2D("Music/FreeBird.mp3", GL_FALSE);
+        ImGui::SliderInt("Bystanders", &bystanderCount, 0, 1000);
+        ImGui::Text("Instanced: %u objects in %u draws", instanceBatch.GetInstanceCount(), instanceBatch.GetDrawCount());
+
+        ImGui::Text("Static geometry: %u draws in %u submissions (%s)", staticGeometry.GetDrawCount(), staticGeometry.GetSubmissionCount(),
+            staticGeometry.UsesMultiDrawIndirect() ? "multi-draw indirect" : "base vertex");
+        ImGui::Text("Culled: %u objects", staticGeometry.GetCulledCount() + instanceBatch.GetCulledCount() + renderQueue.GetCulledCount());
+        ImGui::Text("LOD triangles: %u static, %u instanced", staticGeometry.GetTriangleCount(), instanceBatch.GetTriangleCount());
+        ImGui::Text("Scene nodes: %u (%u updated)", sceneGraph.GetNodeCount(), sceneGraph.GetUpdatedCount());
+        ImGui::Text("Point lights: %u visible, %u cluster entries (at most %u per cluster)", lightClusters.GetLightCount(),
+            lightClusters.GetIndexCount(), lightClusters.GetMaxClusterLights());
+        ImGui::Text("Frame graph: %u passes, %u culled, %u clears skipped", frameGraph.GetPassCount(),
+            frameGraph.GetCulledPassCount(), frameGraph.GetSkippedClearCount());
+
+        const GLStateStats& stateStats = stateCache.GetStats();
+        ImGui::Text("Draw calls: %u", stateStats.drawCalls);
+        ImGui::Text("Program binds: %u (%u avoided)", stateStats.programBinds, stateStats.programBindsAvoided);
+        ImGui::Text("Texture binds: %u (%u avoided)", stateStats.textureBinds, stateStats.textureBindsAvoided);
+        ImGui::Text("VAO binds: %u (%u avoided)", stateStats.vertexArrayBinds, stateStats.vertexArrayBindsAvoided);
+
+        profiler.DrawOverlay();
+        if (ImGui::Button(profiler.IsCapturing() ? "Capturing..." : "Capture trace")) {
+            profiler.RequestCapture(120, "frame_trace.json");
+        }
+        bool streaming = assetLoader.GetPendingCount() > 0 || assetLoader.IsStreaming();
+        if (ImGui::Button(streaming ? "Streaming textures..." : "Reload textures") && !streaming) {
+            queueTextures();
+        }
+
+        if(SoundEngine && animation_scene == 2 && trainPosition >= -35.0f && !sound_played) {
+			SoundEngine->play2D(music, GL_FALSE);
             sound_played = true;
 		}
 
         ImGui::End();
-
         ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
-        // Clear the window
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        {
+            ProfileZone zone(profiler, "Update");
+            glm::mat4 model(1.0f);
 
-        // Rendering
-        ImGui::Render();
-        glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        shaderList[0].UseShader();
-        uniformModel = shaderList[0].GetModelLocation();
-        uniformProjection = shaderList[0].GetProjectionLocation();
-        uniformView = shaderList[0].GetViewLocation();
-        uniformAmbientColour = shaderList[0].GetAmbientColourLocation();
-        uniformAmbientIntensity = shaderList[0].GetAmbientIntensityLocation();
-        uniformDiffuseIntensity = shaderList[0].GetDiffuseIntensityLocation();
-        uniformSpecularIntensity = shaderList[0].GetSpecularIntensityLocation();
-        uniformLightDirection = shaderList[0].GetLightDirectionLocation();
-
-        dLight.UseDirLight(uniformAmbientIntensity, uniformAmbientColour,
-            uniformDiffuseIntensity, uniformSpecularIntensity, uniformLightDirection);
-
-        glm::mat4 model(1.0f);
-
-        glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-        glUniformMatrix4fv(uniformProjection, 1, GL_FALSE, glm::value_ptr(projection));
-        glUniformMatrix4fv(uniformView, 1, GL_FALSE, glm::value_ptr(camera.calculateViewMatrix()));
-
-
-        // Animation
-        if (run_animation) {
-            wheelRotation += 300.0f * deltaTime; // Rotate the wheel at 100 degrees per second
-            if (wheelRotation > 360.0f) {
-                wheelRotation -= 360.0f; // Reset the angle to prevent overflow
-            }
+            // Animation
+            if (run_animation) {
+                wheelRotation += 300.0f * deltaTime; // Rotate the wheel at 100 degrees per second
+                if (wheelRotation > 360.0f) {
+                    wheelRotation -= 360.0f; // Reset the angle to prevent overflow
+                }
 
-            trainPosition += velocity * deltaTime;
-        }
+                trainPosition += velocity * deltaTime;
+            }
 
-        // Grass Plane
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-        glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-        dirt.UseTexture();
-        plane_mesh[0]->RenderMesh();
-
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 200.0f));
-        glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-        dirt.UseTexture();
-        plane_mesh[0]->RenderMesh();
-
-
-        // Trolley
-        for (size_t i = 0; i < trolley_mesh.size(); i++) {
-            model = glm::mat4(1.0f);
-            model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-            switch (animation_scene) {
-            case 0:
-                // First movement scenario
-                if (trainPosition < 60.0f) {
-                    model = glm::translate(model, glm::vec3(0.0f, 0.0f, trainPosition));
-                }
-                else {
-                    float diagonalPosition = trainPosition - 60.0f;
-                    model = glm::translate(model, glm::vec3(diagonalPosition, 0.0f, 60.0f + diagonalPosition));
-                    model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-                }
-                break;
-            case 1:
-                // Second movement scenario
-                model = glm::translate(model, glm::vec3(0.0f, 0.0f, trainPosition));
-                break;
-            case 2:
-                // Third movement scenario
-                if (trainPosition < 25.0f) {
-                    model = glm::translate(model, glm::vec3(0.0f, 0.0f, trainPosition));
+            // Only the nodes that moved this frame are recomputed, the wheels follow the trolley
+            if (run_animation || animation_scene != lastScene) {
+                sceneGraph.SetLocalTransform(trolleyNode, GetTrolleyTransform());
+                lastScene = animation_scene;
+            }
+            if (run_animation) {
+                for (int j = 0; j < 6; j++) {
+                    model = glm::translate(glm::mat4(1.0f), -wheelCenters[j]);
+                    model = glm::rotate(model, glm::radians(wheelRotation), glm::vec3(1.0f, 0.0f, 0.0f));
+                    model = glm::translate(model, wheelCenters[j]);
+                    sceneGraph.SetLocalTransform(wheelNodes[j], model);
                 }
-                else {
-                    float upwardPosition = trainPosition - 25.0f;
-                    model = glm::translate(model, glm::vec3(0.0f, upwardPosition * glm::tan(glm::radians(30.0f)), 25.0f + upwardPosition));
-                    model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+            }
+            // The third rail tilts up in the third scenario. It steps once per submesh each frame,
+            // the rate it had when every submesh advanced the tilt as it was drawn
+            if (animation_scene == 2 && trainPosition >= -20.f && turnrad <= 30.0f) {
+                for (size_t i = 0; i < rail_mesh[2].size() && turnrad <= 30.0f; i++) {
+                    turnrad += 0.15f, yr += 0.0625f, zr += 0.025f;
                 }
-                break;
+                model = glm::rotate(glm::mat4(1.0f), glm::radians(-turnrad), glm::vec3(1.0f, 0.0f, 0.0f));
+                model = glm::translate(model, glm::vec3(0.0f, -yr, -zr));
+                sceneGraph.SetLocalTransform(railNodes[2], model);
             }
-            glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-            trolley.UseTexture();
-            trolley_mesh[i]->RenderMesh();
-        }
+            sceneGraph.UpdateTransforms();
 
-        // Wheels, from blender x y z to opengl: x -> 0, -z -> y, y -> z
-        glm::vec3 wheelCenters[] = {
-            glm::vec3(0.0f, -1.98191f, 3.6229f),
-            glm::vec3(0.0f, -1.78191f, 0.056396f),
-            glm::vec3(0.0f, -1.78191f, -3.2106f),
-            glm::vec3(0.0f, -1.78191f, -3.2106f),
-            glm::vec3(0.0f, -1.78191f, 0.056396f),
-            glm::vec3(0.0f, -1.98191f, 3.6229f),
-        };
-
-        // Wheels
-        for (int j = 0; j < 6; j++) {
-            for (size_t i = 0; i < wheel_mesh[j].size(); i++) {
-                model = glm::mat4(1.0f);
-                switch (animation_scene) {
-                case 0: // First movement scenario
-                    if (trainPosition < 60.0f) {  // Move straight initially
-                        model = glm::translate(model, glm::vec3(0.0f, 0.0f, trainPosition));
-                    }
-                    else {  // Move diagonally for a distance
-                        float diagonalPosition = trainPosition - 60.0f;
-                        model = glm::translate(model, glm::vec3(diagonalPosition, 0.0f, 60.0f + diagonalPosition));
-                        model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-                    }
-                    break;
-                case 1: // Second movement scenario
-                    model = glm::translate(model, glm::vec3(0.0f, 0.0f, trainPosition));
-                    break;
-                case 2:
-                    if (trainPosition < 25.0f) {  // Move straight initially
-                        model = glm::translate(model, glm::vec3(0.0f, 0.0f, trainPosition));
-                    }
-                    else {  // Move upwards at a 30-degree angle
-                        float upwardPosition = trainPosition - 25.0f;
-                        model = glm::translate(model, glm::vec3(0.0f, upwardPosition * glm::tan(glm::radians(30.0f)), 25.0f + upwardPosition));
-                        model = glm::rotate(model, glm::radians(-30.0f), glm::vec3(1.0f, 0.0f, 0.0f)); // Add this line
-                    }
-                    break;
-                }
-                model = glm::translate(model, -wheelCenters[j]);
-                model = glm::rotate(model, glm::radians(wheelRotation), glm::vec3(1.0f, 0.0f, 0.0f));
-                model = glm::translate(model, wheelCenters[j]);
-                glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-                trolley.UseTexture();
-                wheel_mesh[j][i]->RenderMesh();
+            // Headlights follow the trolley, everything else lights from where it was placed
+            for (int j = 0; j < 2; j++) {
+                pointLights[j].position = glm::vec3(sceneGraph.GetWorldTransform(trolleyNode) * glm::vec4(headlightOffsets[j], 1.0f));
             }
         }
-        // Rail
-        switch (animation_scene) {
-        case 0:
-        case 1:
-            for (int j = 0; j < 3; j++) {
-                for (size_t i = 0; i < rail_mesh[j].size(); i++) {
-                    model = glm::mat4(1.0f);
-                    model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-                    glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-                    rail.UseTexture();
-                    rail_mesh[j][i]->RenderMesh();
-                }
+
+        glm::mat4 view = camera.calculateViewMatrix();
+        GLsizei screenWidth = benchMode ? benchTarget.GetWidth() : (GLsizei)io.DisplaySize.x;
+        GLsizei screenHeight = benchMode ? benchTarget.GetHeight() : (GLsizei)io.DisplaySize.y;
+
+        // The scene clears the screen once and the UI draws over it. Each pass is a profiler zone,
+        // a pass added later that clears or draws for nothing is culled and reported by the graph
+        frameGraph.Reset();
+        int screen = frameGraph.AddTarget("Screen", benchMode ? benchTarget.GetFBO() : 0, screenWidth, screenHeight);
+        frameGraph.SetOutput(screen);
+
+        frameGraph.AddPass("Scene", screen, FrameGraph::CLEAR, [&]() {
+            // ImGui binds its own program, texture and VAO, so start every frame from unknown state
+            stateCache.Invalidate();
+            stateCache.ResetStats();
+
+            // One write per frame, every program reads it through the FrameData block
+            frameUniforms.Update(projection, view, camera.getCameraPosition(), dLight);
+
+            lightClusters.Update(projection, view, screenWidth, screenHeight, pointLights);
+            lightClusters.Bind(stateCache);
+
+            glm::mat4 model(1.0f);
+
+            frustum.Update(projection * view);
+            lodSelector.Update(projection, camera.getCameraPosition(), screenHeight);
+            renderQueue.Begin(view, &frustum);
+            instanceBatch.Begin();
+
+            // Trolley
+            for (size_t i = 0; i < trolley_mesh.size(); i++) {
+                renderQueue.Submit(&sceneShaders, &trolley, trolley_mesh[i], sceneGraph.GetWorldTransform(trolleyNode));
             }
-            break;
-        case 2:
-            for (int j = 0; j < 2; j++) {
-                for (size_t i = 0; i < rail_mesh[j].size(); i++) {
-                    model = glm::mat4(1.0f);
-                    model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-                    glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-                    rail.UseTexture();
-                    rail_mesh[j][i]->RenderMesh();
-                }
+
+            // Wheels
+            for (int j = 0; j < 6; j++) {
+                instanceBatch.Add(wheel_mesh[j], &trolley, sceneGraph.GetWorldTransform(wheelNodes[j]));
             }
+
+            // Rail, the first two are static geometry
             for (size_t i = 0; i < rail_mesh[2].size(); i++) {
-                model = glm::mat4(1.0f);
-                model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-                if (animation_scene == 2 && trainPosition>= -20.f) {
-                    if (turnrad <= 30.0f)
-                         turnrad += 0.15f, yr+= 0.0625f, zr +=0.025f;
-                    model = glm::rotate(model, glm::radians(-turnrad), glm::vec3(1.0f, 0.0f, 0.0f));
-                    model = glm::translate(model, glm::vec3(0.0f, -yr , -zr));
-                }
-                // ... (some code for positioning the model)
-                glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-                rail.UseTexture();
-                rail_mesh[2][i]->RenderMesh();
+                renderQueue.Submit(&sceneShaders, &rail, rail_mesh[2][i], sceneGraph.GetWorldTransform(railNodes[2]));
             }
-            break;
-        }
 
-        // Human
-        for (int j = 0; j < 7; j++) {
-            for (size_t i = 0; i < human_mesh[j].size(); i++) {
-                model = glm::mat4(1.0f);
-                model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-                glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-                human[j].UseTexture();
-                human_mesh[j][i]->RenderMesh();
+            // Bystanders, rows of the same seven humans lined up beside the track. Textures are mixed
+            // across the meshes, they are layers of one array so each mesh is still one batch
+            for (int k = 0; k < bystanderCount; k++) {
+                model = glm::translate(glm::mat4(1.0f), glm::vec3(-25.0f - 4.0f * (k / 50), 0.0f, -150.0f + 6.0f * (k % 50)));
+                instanceBatch.Add(human_mesh[k % 7], &human[(k / 7) % 7], model);
             }
-        }
 
-        //Rope
-        for (size_t i = 0; i < rope_mesh.size(); i++) {
-            model = glm::mat4(1.0f);
-            model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-            glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-            rope.UseTexture();
-            rope_mesh[i]->RenderMesh();
+            // Grass plane, humans, rope and leaver
+            staticGeometry.Render(stateCache, &sceneShaders, &frustum, &lodSelector);
+
+            instanceBatch.Submit(renderQueue, &sceneShaders, &frustum, &lodSelector);
+            renderQueue.Flush(stateCache);
+        });
+
+        FrameGraph::PassDesc uiPass;
+        uiPass.name = "ImGui";
+        uiPass.target = screen;
+        uiPass.colourLoad = FrameGraph::LOAD;
+        uiPass.depthLoad = FrameGraph::LOAD;
+        uiPass.clearColour = glm::vec4(0.0f);
+        uiPass.writesColour = true;
+        uiPass.writesDepth = false;
+        frameGraph.AddPass(uiPass, []() {
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        });
+
+        frameGraph.Execute(profiler);
+
+        {
+            // Offscreen frames have nothing to present, wait for the GPU so the frame time covers its work
+            ProfileZone zone(profiler, "Present");
+            if (benchMode) {
+                glFinish();
+            }
+            else {
+                mainWindow.swapBuffers();
+            }
         }
 
-        //Leaver
-        for (size_t i = 0; i < leaver_mesh.size(); i++) {
-            model = glm::mat4(1.0f);
-            model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));
-            glUniformMatrix4fv(uniformModel, 1, GL_FALSE, glm::value_ptr(model));
-            rope.UseTexture();
-            leaver_mesh[i]->RenderMesh();
+        if (benchMode) {
+            benchmark.EndFrame(profiler);
+            if (!benchmark.IsRunning()) {
+                break;
+            }
         }
-
-        glUseProgram(0);
-
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-        mainWindow.swapBuffers();
     }
 
     // Cleanup ImGui
@@ -489,5 +805,5 @@ int main() {
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
-    return 0;
+    return exitCode;
 }
\ No newline at end of file